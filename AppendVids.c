@@ -14,6 +14,7 @@
 #include <iostream>
 
 #include "ImageUtils.h"		// ImageUtils by Shervin Emami on 20th Feb 2010.
+#include "PresentScheduler.h"	// Timestamp-based frame pacing.
 
 
 int FPS;  // Usually 25 or 30 fps.		// Speed of saved video stream.
@@ -58,9 +59,9 @@ int runAppendVids(int argc, char **argv)
 	CvSize size;
 	int i;
 	int B = 4;	// border size.
-	double timeDiff_wholeFrameInOut;
-	double timeStart_wholeFrameInOut;
-	double currentFrame_ms;
+	double pts_ms;
+	double wait_ms;
+	PresentScheduler scheduler;
 
     // Print a welcome message, and the OpenCV version.
     printf ("Welcome to AppendVids, compiled with OpenCV version %s (%d.%d.%d)\n"
@@ -168,10 +169,7 @@ int runAppendVids(int argc, char **argv)
 	iterations = 0;
 	while (1)
     {
-		int delay_ms;
-		int c;
-
-		timeStart_wholeFrameInOut = (double)cvGetTickCount();
+		int c = 0;
 
 		// Capture the frame, either from the camera or video file
 		if (iterations > 0) {	// Use the first frame that was already obtained during initialization.
@@ -194,19 +192,23 @@ int runAppendVids(int argc, char **argv)
 			// Save to the output video file
 			cvWriteFrame(videoWriter, frame1);      // stabilized image
 		}
-		//else {
+
+		// Make sure the video runs at the correct speed, by showing each frame when its timestamp is due.
+		// Image folders don't have timestamps, so they are shown at the desired frames per second.
+		if (capture1)
+			pts_ms = cvGetCaptureProperty(capture1, CV_CAP_PROP_POS_MSEC);
+		else
+			pts_ms = iterations * 1000.0 / FPS;
+		if (scheduler.schedule(pts_ms, &wait_ms) == PRESENT_FRAME) {
+			if (wait_ms >= 1.0)
+				c = cvWaitKey(cvFloor(wait_ms));	// Wait for a keypress until the frame is due.
 			// Display an image on the GUI
 			cvShowImage( "AppendVids", frame1 );	// stabilized image
-		//}
-
-		// Make sure the video runs at roughly the correct speed.
-		// Add a delay that would result in roughly the desired frames per second.
-		timeDiff_wholeFrameInOut = (double)cvGetTickCount() - timeStart_wholeFrameInOut;
-		currentFrame_ms = (double)(timeDiff_wholeFrameInOut / (cvGetTickFrequency()*1000.0));
-		delay_ms = cvRound((1000 / FPS) - currentFrame_ms);	// Factor in how much time was used to process this frame already.
-		if (delay_ms < 1)
-			delay_ms = 1;	// Make sure there is atleast some delay, to allow OpenCV to do its internal processing.
-		c = cvWaitKey(delay_ms);	// Wait for a keypress, and let OpenCV display its GUI.
+			scheduler.presented();
+		}
+		// Otherwise the frame is too late to be shown, but it was still saved to the output video.
+		if ((char)c != 27)
+			c = cvWaitKey(1);	// Let OpenCV display its GUI.
 
 		if( (char)c == 27 )	// Check if the user hit the 'Escape' key
             break;	// Quit
@@ -221,12 +223,10 @@ int runAppendVids(int argc, char **argv)
 	if (capture2) {
 		printf("Processing the 2nd input stream ... \n");
 		iterations = 0;
+		scheduler.restart();	// The timestamps start again from 0.
 		while (1)
 		{
-			int delay_ms;
-			int c;
-
-			timeStart_wholeFrameInOut = (double)cvGetTickCount();
+			int c = 0;
 
 			// Capture the frame, either from the camera or video file
 			if (iterations > 0) {	// Use the first frame that was already obtained during initialization.
@@ -242,19 +242,18 @@ int runAppendVids(int argc, char **argv)
 				// Save to the output video file
 				cvWriteFrame(videoWriter, frame2);      // stabilized image
 			}
-			//else {
+
+			// Make sure the video runs at the correct speed, by showing each frame when its timestamp is due.
+			pts_ms = cvGetCaptureProperty(capture2, CV_CAP_PROP_POS_MSEC);
+			if (scheduler.schedule(pts_ms, &wait_ms) == PRESENT_FRAME) {
+				if (wait_ms >= 1.0)
+					c = cvWaitKey(cvFloor(wait_ms));	// Wait for a keypress until the frame is due.
 				// Display an image on the GUI
 				cvShowImage( "AppendVids", frame2);	// stabilized image
-			//}
-
-			// Make sure the video runs at roughly the correct speed.
-			// Add a delay that would result in roughly the desired frames per second.
-			timeDiff_wholeFrameInOut = (double)cvGetTickCount() - timeStart_wholeFrameInOut;
-			currentFrame_ms = (double)(timeDiff_wholeFrameInOut / (cvGetTickFrequency()*1000.0));
-			delay_ms = cvRound((1000 / FPS) - currentFrame_ms);	// Factor in how much time was used to process this frame already.
-			if (delay_ms < 1)
-				delay_ms = 1;	// Make sure there is atleast some delay, to allow OpenCV to do its internal processing.
-			c = cvWaitKey(delay_ms);	// Wait for a keypress, and let OpenCV display its GUI.
+				scheduler.presented();
+			}
+			if ((char)c != 27)
+				c = cvWaitKey(1);	// Let OpenCV display its GUI.
 
 			if( (char)c == 27 )	// Check if the user hit the 'Escape' key
 				break;	// Quit
@@ -263,6 +262,8 @@ int runAppendVids(int argc, char **argv)
 		}
 	}
 
+	scheduler.printStats("AppendVids");
+
 	// Free the remaining resources used when this function returns.
 	return 0;
 }
@@ -0,0 +1,687 @@
+/**		BenchImageUtils.cpp:		Correctness & speed benchmark of the ImageUtils color conversions against cv::cvtColor().
+ * Runs every conversion over a sweep of frame sizes (VGA to 8K), thread counts & SIMD levels, checks that each SIMD level
+ * gives exactly the same pixels as the plain C++ kernels, measures the error against the closest OpenCV conversion,
+ * and prints all the results as JSON, to pick which implementation to use and to catch regressions.
+ *
+ * Usage: bench_imageutils [--quick] [--kernel name] [--output results.json]
+ *   --quick    Only VGA & 1080p frames, with 1 thread & all the threads.
+ *   --kernel   Only run the conversions whose name contains this text, eg: "hsv".
+ *   --output   Write the JSON to this file instead of stdout. Progress is always printed to stderr.
+ **/
+
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <tbb/task_arena.h>
+
+#include "ImageUtils.hpp"
+
+
+using namespace std;
+
+
+// A color conversion to benchmark, with the closest OpenCV conversion to compare it to.
+struct BenchKernel {
+	string name;
+	string reference;		// Description of the OpenCV conversion, or empty if there isn't one.
+	bool compareOutput;		// False if the OpenCV conversion is only comparable in speed, not in its output.
+	bool hueFirst;			// True if the first channel of the output is a Hue, whose error wraps around from 255 to 0.
+	function<cv::Mat(const cv::Mat &frameBGR)> makeInput;
+	function<void(const cv::Mat &src, vector<cv::Mat> &dst, int grainRows)> run;
+	function<void(const cv::Mat &src, vector<cv::Mat> &dst)> runReference;
+};
+
+// How different an output is from another one.
+struct BenchAccuracy {
+	int maxError;
+	double meanError;
+	double diffFraction;	// The fraction of the output values that differ at all.
+};
+
+// One row of the JSON results.
+struct BenchResult {
+	string kernel;
+	cv::Size size;
+	int threads;
+	SimdLevel simdLevel;
+	double ms;
+	double referenceMs;		// Negative if there is no reference.
+	string reference;
+	bool hasAccuracy;
+	BenchAccuracy accuracy;
+	bool matchesC;			// True if the output is identical to the plain C++ kernels.
+};
+
+
+static const char* getSimdLevelName(SimdLevel level)
+{
+	switch (level) {
+		case SIMD_LEVEL_SSE41:	return "SSE4.1";
+		case SIMD_LEVEL_AVX2:	return "AVX2";
+		case SIMD_LEVEL_AVX512:	return "AVX-512";
+		default:				return "C";
+	}
+}
+
+// Create a test frame with smooth gradients of every hue, random detail, and rows of pure greys.
+static cv::Mat makeTestFrame(cv::Size size)
+{
+	cv::RNG rng(12345);
+	cv::Mat coarse(max(size.height / 32, 2), max(size.width / 32, 2), CV_8UC3);
+	rng.fill(coarse, cv::RNG::UNIFORM, 0, 256);
+	cv::Mat frame;
+	cv::resize(coarse, frame, size, 0, 0, cv::INTER_CUBIC);
+	cv::Mat noise(size, CV_8UC3);
+	rng.fill(noise, cv::RNG::UNIFORM, 0, 16);
+	frame += noise;
+	for (int y=0; y<frame.rows; y+=16) {
+		uchar *row = frame.ptr(y);
+		for (int x=0; x<frame.cols; x++)
+			row[x*3+0] = row[x*3+1] = row[x*3+2] = (uchar)(x * 255 / max(frame.cols - 1, 1));
+	}
+	return frame;
+}
+
+// Convert a BGR frame to an NV12 frame, the usual output of hardware video decoders.
+static cv::Mat convertBGRtoNV12(const cv::Mat &frameBGR)
+{
+	cv::Mat i420;
+	cv::cvtColor(frameBGR, i420, cv::COLOR_BGR2YUV_I420);
+	int w = frameBGR.cols;
+	int h = frameBGR.rows;
+	cv::Mat nv12(h * 3 / 2, w, CV_8UC1);
+	i420.rowRange(0, h).copyTo(nv12.rowRange(0, h));
+	const uchar *planeU = i420.ptr(h);
+	const uchar *planeV = planeU + (w / 2) * (h / 2);
+	for (int y=0; y<h/2; y++) {
+		uchar *row = nv12.ptr(h + y);
+		for (int x=0; x<w/2; x++) {
+			row[x*2+0] = planeU[y * (w / 2) + x];
+			row[x*2+1] = planeV[y * (w / 2) + x];
+		}
+	}
+	return nv12;
+}
+
+// Get the color matrix of cv::cvtColor(COLOR_BGR2YCrCb), giving Y,Cr,Cb from B,G,R.
+static ColorMatrix getYCrCbMatrix(void)
+{
+	const double KR = 0.299, KG = 0.587, KB = 0.114;
+	const double CR_SCALE = 0.713, CB_SCALE = 0.564;
+	ColorMatrix matrix = {
+		{
+			{ (float)KB, (float)KG, (float)KR },
+			{ (float)(-KB * CR_SCALE), (float)(-KG * CR_SCALE), (float)((1.0 - KR) * CR_SCALE) },
+			{ (float)((1.0 - KB) * CB_SCALE), (float)(-KG * CB_SCALE), (float)(-KR * CB_SCALE) }
+		},
+		{ 0.0f, 128.0f, 128.0f }
+	};
+	return matrix;
+}
+
+// Wrap a conversion with a single output image.
+static function<void(const cv::Mat&, vector<cv::Mat>&, int)> singleOutput(const function<void(const cv::Mat&, cv::Mat&, int)> &convert)
+{
+	return [convert](const cv::Mat &src, vector<cv::Mat> &dst, int grainRows) {
+		dst.resize(1);
+		convert(src, dst[0], grainRows);
+	};
+}
+
+// Wrap an OpenCV conversion with a single output image.
+static function<void(const cv::Mat&, vector<cv::Mat>&)> singleReference(const function<void(const cv::Mat&, cv::Mat&)> &convert)
+{
+	return [convert](const cv::Mat &src, vector<cv::Mat> &dst) {
+		dst.resize(1);
+		convert(src, dst[0]);
+	};
+}
+
+static cv::Mat keepBGR(const cv::Mat &frameBGR)
+{
+	return frameBGR;
+}
+
+// Get every conversion to benchmark.
+static vector<BenchKernel> getBenchKernels(const ColorLUT *lutHSV)
+{
+	using namespace imageutils;
+	vector<BenchKernel> kernels;
+	BenchKernel k;
+
+	k.name = "rgb2hsv";
+	k.reference = "cvtColor(COLOR_BGR2HSV_FULL)";
+	k.compareOutput = true;
+	k.hueFirst = true;
+	k.makeInput = keepBGR;
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) { convertRGBtoHSV(src, dst, grainRows); });
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) { cv::cvtColor(src, dst, cv::COLOR_BGR2HSV_FULL); });
+	kernels.push_back(k);
+
+	k.name = "rgba2hsv";
+	k.reference = "cvtColor(COLOR_BGRA2BGR) + cvtColor(COLOR_BGR2HSV_FULL)";
+	k.makeInput = [](const cv::Mat &frameBGR) { cv::Mat bgra; cv::cvtColor(frameBGR, bgra, cv::COLOR_BGR2BGRA); return bgra; };
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) { convertRGBtoHSV(src, dst, grainRows, ORDER_BGRA); });
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) {
+		cv::Mat bgr;
+		cv::cvtColor(src, bgr, cv::COLOR_BGRA2BGR);
+		cv::cvtColor(bgr, dst, cv::COLOR_BGR2HSV_FULL);
+	});
+	kernels.push_back(k);
+
+	k.name = "rgb2hsv_planes";
+	k.reference = "cvtColor(COLOR_BGR2HSV_FULL) + split()";
+	k.makeInput = keepBGR;
+	k.run = [](const cv::Mat &src, vector<cv::Mat> &dst, int grainRows) {
+		dst.resize(3);
+		convertRGBtoHSVPlanes(src, dst[0], dst[1], dst[2], grainRows);
+	};
+	k.runReference = [](const cv::Mat &src, vector<cv::Mat> &dst) {
+		cv::Mat hsv;
+		cv::cvtColor(src, hsv, cv::COLOR_BGR2HSV_FULL);
+		cv::split(hsv, dst);
+	};
+	kernels.push_back(k);
+
+	k.name = "hsv2rgb";
+	k.reference = "cvtColor(COLOR_HSV2BGR_FULL)";
+	k.hueFirst = false;
+	k.makeInput = [](const cv::Mat &frameBGR) { cv::Mat hsv; cv::cvtColor(frameBGR, hsv, cv::COLOR_BGR2HSV_FULL); return hsv; };
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) { convertHSVtoRGB(src, dst, grainRows); });
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) { cv::cvtColor(src, dst, cv::COLOR_HSV2BGR_FULL); });
+	kernels.push_back(k);
+
+	k.name = "hsv_mask";
+	k.reference = "cvtColor(COLOR_BGR2HSV_FULL) + inRange()";
+	k.makeInput = keepBGR;
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) {
+		RangeHSV range = { 20, 60, 50, 255, 50, 255 };
+		convertRGBtoHSVMask(src, dst, range, 0, grainRows);
+	});
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) {
+		cv::Mat hsv;
+		cv::cvtColor(src, hsv, cv::COLOR_BGR2HSV_FULL);
+		cv::inRange(hsv, cv::Scalar(20, 50, 50), cv::Scalar(60, 255, 255), dst);
+	});
+	kernels.push_back(k);
+
+	// OpenCV has no YIQ, so only compare the speed with its closest luma/chroma conversion.
+	k.name = "rgb2yiq";
+	k.reference = "cvtColor(COLOR_BGR2YCrCb)";
+	k.compareOutput = false;
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) { convertRGBtoYIQ(src, dst, grainRows); });
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) { cv::cvtColor(src, dst, cv::COLOR_BGR2YCrCb); });
+	kernels.push_back(k);
+
+	k.name = "yiq2rgb";
+	k.reference = "cvtColor(COLOR_YCrCb2BGR)";
+	k.makeInput = [](const cv::Mat &frameBGR) { cv::Mat yiq; convertRGBtoYIQ(frameBGR, yiq); return yiq; };
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) { convertYIQtoRGB(src, dst, grainRows); });
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) { cv::cvtColor(src, dst, cv::COLOR_YCrCb2BGR); });
+	kernels.push_back(k);
+
+	k.name = "rgb2yiq_planes";
+	k.reference = "cvtColor(COLOR_BGR2YCrCb) + split()";
+	k.makeInput = keepBGR;
+	k.run = [](const cv::Mat &src, vector<cv::Mat> &dst, int grainRows) {
+		dst.resize(3);
+		convertRGBtoYIQPlanes(src, dst[0], dst[1], dst[2], grainRows);
+	};
+	k.runReference = [](const cv::Mat &src, vector<cv::Mat> &dst) {
+		cv::Mat ycrcb;
+		cv::cvtColor(src, ycrcb, cv::COLOR_BGR2YCrCb);
+		cv::split(ycrcb, dst);
+	};
+	kernels.push_back(k);
+
+	// Just the Y plane is the same as a greyscale image, so it can be compared with OpenCV's.
+	k.name = "rgb2yiq_y_plane";
+	k.reference = "cvtColor(COLOR_BGR2GRAY)";
+	k.compareOutput = true;
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) {
+		convertRGBtoYIQPlanes(src, dst, cv::noArray(), cv::noArray(), grainRows);
+	});
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) { cv::cvtColor(src, dst, cv::COLOR_BGR2GRAY); });
+	kernels.push_back(k);
+	k.compareOutput = false;
+
+	// 16-bit & float images, through the float kernels. OpenCV keeps float Hues in degrees, so only compare the speed.
+	k.name = "rgb2hsv_16u";
+	k.reference = "convertTo(CV_32F) + cvtColor(COLOR_BGR2HSV_FULL)";
+	k.makeInput = [](const cv::Mat &frameBGR) { cv::Mat bgr16; frameBGR.convertTo(bgr16, CV_16U, 257.0); return bgr16; };
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) { convertRGBtoHSV(src, dst, grainRows, ORDER_BGR, -1); });
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) {
+		cv::Mat bgr;
+		src.convertTo(bgr, CV_32F, 1.0 / 65535.0);
+		cv::cvtColor(bgr, dst, cv::COLOR_BGR2HSV_FULL);
+	});
+	kernels.push_back(k);
+
+	k.name = "rgb2hsv_32f";
+	k.reference = "cvtColor(COLOR_BGR2HSV_FULL)";
+	k.makeInput = [](const cv::Mat &frameBGR) { cv::Mat bgr32; frameBGR.convertTo(bgr32, CV_32F, 1.0 / 255.0); return bgr32; };
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) { convertRGBtoHSV(src, dst, grainRows, ORDER_BGR, -1); });
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) { cv::cvtColor(src, dst, cv::COLOR_BGR2HSV_FULL); });
+	kernels.push_back(k);
+
+	k.name = "hsv2rgb_32f";
+	k.reference = "cvtColor(COLOR_HSV2BGR_FULL)";
+	k.makeInput = [](const cv::Mat &frameBGR) {
+		cv::Mat bgr32, hsv32;
+		frameBGR.convertTo(bgr32, CV_32F, 1.0 / 255.0);
+		convertRGBtoHSV(bgr32, hsv32, 0, ORDER_BGR, -1);
+		return hsv32;
+	};
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) { convertHSVtoRGB(src, dst, grainRows, -1); });
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) { cv::cvtColor(src, dst, cv::COLOR_HSV2BGR_FULL); });
+	kernels.push_back(k);
+
+	k.name = "rgb2yiq_32f";
+	k.reference = "cvtColor(COLOR_BGR2YCrCb)";
+	k.makeInput = [](const cv::Mat &frameBGR) { cv::Mat bgr32; frameBGR.convertTo(bgr32, CV_32F, 1.0 / 255.0); return bgr32; };
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) { convertRGBtoYIQ(src, dst, grainRows, ORDER_BGR, -1); });
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) { cv::cvtColor(src, dst, cv::COLOR_BGR2YCrCb); });
+	kernels.push_back(k);
+
+	k.name = "color_matrix_ycrcb";
+	k.reference = "cvtColor(COLOR_BGR2YCrCb)";
+	k.compareOutput = true;
+	k.makeInput = keepBGR;
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) {
+		convertColorMatrix(src, dst, getYCrCbMatrix(), false, grainRows);
+	});
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) { cv::cvtColor(src, dst, cv::COLOR_BGR2YCrCb); });
+	kernels.push_back(k);
+
+	k.name = "color_matrix_ycrcb_float";
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) {
+		convertColorMatrix(src, dst, getYCrCbMatrix(), true, grainRows);
+	});
+	kernels.push_back(k);
+
+	k.name = "nv12_to_hsv";
+	k.reference = "cvtColor(COLOR_YUV2BGR_NV12) + cvtColor(COLOR_BGR2HSV_FULL)";
+	k.hueFirst = true;
+	k.makeInput = convertBGRtoNV12;
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) {
+		convertYUV420toHSV(src, dst, YUV420_NV12, 0, false, grainRows);
+	});
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) {
+		cv::Mat bgr;
+		cv::cvtColor(src, bgr, cv::COLOR_YUV2BGR_NV12);
+		cv::cvtColor(bgr, dst, cv::COLOR_BGR2HSV_FULL);
+	});
+	kernels.push_back(k);
+
+	k.name = "i420_to_hsv";
+	k.reference = "cvtColor(COLOR_YUV2BGR_I420) + cvtColor(COLOR_BGR2HSV_FULL)";
+	k.makeInput = [](const cv::Mat &frameBGR) { cv::Mat i420; cv::cvtColor(frameBGR, i420, cv::COLOR_BGR2YUV_I420); return i420; };
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) {
+		convertYUV420toHSV(src, dst, YUV420_I420, 0, false, grainRows);
+	});
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) {
+		cv::Mat bgr;
+		cv::cvtColor(src, bgr, cv::COLOR_YUV2BGR_I420);
+		cv::cvtColor(bgr, dst, cv::COLOR_BGR2HSV_FULL);
+	});
+	kernels.push_back(k);
+
+	// OpenCV has no YIQ, so only compare the speed with decoding to BGR then converting to YCrCb.
+	k.name = "nv12_to_yiq";
+	k.reference = "cvtColor(COLOR_YUV2BGR_NV12) + cvtColor(COLOR_BGR2YCrCb)";
+	k.compareOutput = false;
+	k.hueFirst = false;
+	k.makeInput = convertBGRtoNV12;
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) {
+		convertYUV420toYIQ(src, dst, YUV420_NV12, 0, false, grainRows);
+	});
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) {
+		cv::Mat bgr;
+		cv::cvtColor(src, bgr, cv::COLOR_YUV2BGR_NV12);
+		cv::cvtColor(bgr, dst, cv::COLOR_BGR2YCrCb);
+	});
+	kernels.push_back(k);
+
+	k.name = "i420_to_yiq";
+	k.reference = "cvtColor(COLOR_YUV2BGR_I420) + cvtColor(COLOR_BGR2YCrCb)";
+	k.makeInput = [](const cv::Mat &frameBGR) { cv::Mat i420; cv::cvtColor(frameBGR, i420, cv::COLOR_BGR2YUV_I420); return i420; };
+	k.run = singleOutput([](const cv::Mat &src, cv::Mat &dst, int grainRows) {
+		convertYUV420toYIQ(src, dst, YUV420_I420, 0, false, grainRows);
+	});
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) {
+		cv::Mat bgr;
+		cv::cvtColor(src, bgr, cv::COLOR_YUV2BGR_I420);
+		cv::cvtColor(bgr, dst, cv::COLOR_BGR2YCrCb);
+	});
+	kernels.push_back(k);
+
+	// A LUT with the HSV conversion baked in, to see how close interpolating the LUT gets to the real conversion.
+	k.name = "color_lut33_hsv_tetrahedral";
+	k.reference = "cvtColor(COLOR_BGR2HSV_FULL)";
+	k.compareOutput = true;
+	k.hueFirst = true;
+	k.makeInput = keepBGR;
+	k.run = singleOutput([lutHSV](const cv::Mat &src, cv::Mat &dst, int grainRows) {
+		convertColorLUT(src, dst, lutHSV, COLOR_LUT_TETRAHEDRAL, grainRows);
+	});
+	k.runReference = singleReference([](const cv::Mat &src, cv::Mat &dst) { cv::cvtColor(src, dst, cv::COLOR_BGR2HSV_FULL); });
+	kernels.push_back(k);
+
+	k.name = "color_lut33_hsv_trilinear";
+	k.run = singleOutput([lutHSV](const cv::Mat &src, cv::Mat &dst, int grainRows) {
+		convertColorLUT(src, dst, lutHSV, COLOR_LUT_TRILINEAR, grainRows);
+	});
+	kernels.push_back(k);
+
+	return kernels;
+}
+
+// Merge the planes of an output into a single image.
+static cv::Mat mergeOutput(const vector<cv::Mat> &planes)
+{
+	if (planes.size() == 1)
+		return planes[0];
+	cv::Mat merged;
+	cv::merge(planes, merged);
+	return merged;
+}
+
+// Compare the outputs a & b, where the first channel can be a Hue that wraps around from 255 to 0.
+static BenchAccuracy compareOutputs(const vector<cv::Mat> &a, const vector<cv::Mat> &b, bool hueFirst)
+{
+	cv::Mat imageA = mergeOutput(a);
+	cv::Mat imageB = mergeOutput(b);
+	BenchAccuracy accuracy = { 0, 0.0, 0.0 };
+	if (imageA.size() != imageB.size() || imageA.type() != imageB.type()) {
+		accuracy.maxError = 255;
+		accuracy.meanError = 255.0;
+		accuracy.diffFraction = 1.0;
+		return accuracy;
+	}
+	int channels = imageA.channels();
+	double sumError = 0.0;
+	int64 diffs = 0;
+	for (int y=0; y<imageA.rows; y++) {
+		const uchar *rowA = imageA.ptr(y);
+		const uchar *rowB = imageB.ptr(y);
+		for (int i=0; i<imageA.cols * channels; i++) {
+			int error = abs(rowA[i] - rowB[i]);
+			if (hueFirst && i % channels == 0)
+				error = min(error, 256 - error);
+			accuracy.maxError = max(accuracy.maxError, error);
+			sumError += error;
+			if (error)
+				diffs++;
+		}
+	}
+	double count = (double)imageA.total() * channels;
+	accuracy.meanError = sumError / count;
+	accuracy.diffFraction = diffs / count;
+	return accuracy;
+}
+
+// Check if the outputs a & b have exactly the same pixels, whatever their depth.
+static bool sameOutputs(const vector<cv::Mat> &a, const vector<cv::Mat> &b)
+{
+	cv::Mat imageA = mergeOutput(a);
+	cv::Mat imageB = mergeOutput(b);
+	if (imageA.size() != imageB.size() || imageA.type() != imageB.type())
+		return false;
+	size_t rowBytes = imageA.cols * imageA.elemSize();
+	for (int y=0; y<imageA.rows; y++) {
+		if (memcmp(imageA.ptr(y), imageB.ptr(y), rowBytes) != 0)
+			return false;
+	}
+	return true;
+}
+
+// Run fn several times, returning the median time in milliseconds. The first run is not timed, so that
+// the outputs are allocated & the code is in the cache.
+static double timeMedian_ms(const function<void()> &fn, double minSeconds)
+{
+	fn();
+	vector<double> samples;
+	double tickToMs = 1000.0 / cv::getTickFrequency();
+	int64 timeStart = cv::getTickCount();
+	while (samples.size() < 3 || (samples.size() < 100 && (cv::getTickCount() - timeStart) * tickToMs < minSeconds * 1000.0)) {
+		int64 t0 = cv::getTickCount();
+		fn();
+		samples.push_back((double)(cv::getTickCount() - t0) * tickToMs);
+	}
+	sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+static void printJSONString(FILE *out, const string &text)
+{
+	fputc('"', out);
+	for (size_t i=0; i<text.size(); i++) {
+		if (text[i] == '"' || text[i] == '\\')
+			fputc('\\', out);
+		fputc(text[i], out);
+	}
+	fputc('"', out);
+}
+
+static void printJSON(FILE *out, const vector<BenchResult> &results, SimdLevel cpuLevel, int cpuThreads)
+{
+	fprintf(out, "{\n");
+	fprintf(out, "  \"opencv_version\": \"%s\",\n", CV_VERSION);
+	fprintf(out, "  \"cpu_simd_level\": \"%s\",\n", getSimdLevelName(cpuLevel));
+	fprintf(out, "  \"cpu_threads\": %d,\n", cpuThreads);
+	fprintf(out, "  \"results\": [\n");
+	for (size_t i=0; i<results.size(); i++) {
+		const BenchResult &r = results[i];
+		double mpix = (double)r.size.area() / 1.0e6;
+		fprintf(out, "    {\"kernel\": ");
+		printJSONString(out, r.kernel);
+		fprintf(out, ", \"width\": %d, \"height\": %d, \"threads\": %d, \"simd\": \"%s\"", r.size.width, r.size.height,
+			r.threads, getSimdLevelName(r.simdLevel));
+		fprintf(out, ", \"ms\": %.4f, \"mpix_per_s\": %.2f", r.ms, mpix / (r.ms / 1000.0));
+		fprintf(out, ", \"matches_c\": %s", r.matchesC ? "true" : "false");
+		if (r.referenceMs >= 0.0) {
+			fprintf(out, ", \"reference\": ");
+			printJSONString(out, r.reference);
+			fprintf(out, ", \"reference_ms\": %.4f, \"speedup\": %.3f", r.referenceMs, r.referenceMs / r.ms);
+		}
+		else {
+			fprintf(out, ", \"reference\": null, \"reference_ms\": null, \"speedup\": null");
+		}
+		if (r.hasAccuracy) {
+			fprintf(out, ", \"max_error\": %d, \"mean_error\": %.5f, \"diff_fraction\": %.6f", r.accuracy.maxError,
+				r.accuracy.meanError, r.accuracy.diffFraction);
+		}
+		else {
+			fprintf(out, ", \"max_error\": null, \"mean_error\": null, \"diff_fraction\": null");
+		}
+		fprintf(out, "}%s\n", (i + 1 < results.size()) ? "," : "");
+	}
+	fprintf(out, "  ]\n}\n");
+}
+
+// Check that setMaxSimdLevel() can lower the SIMD level but never raise it over the limit from IMAGEUTILS_CPU,
+// eg: running with IMAGEUTILS_CPU=sse41 must stay at SSE4.1 or below after setMaxSimdLevel(SIMD_LEVEL_AVX512).
+static bool checkSimdLevelLimits(void)
+{
+	SimdLevel startLevel = getSimdLevel();
+	setMaxSimdLevel(SIMD_LEVEL_NONE);
+	bool ok = (getSimdLevel() == SIMD_LEVEL_NONE);
+	setMaxSimdLevel(SIMD_LEVEL_AVX512);
+	ok = ok && (getSimdLevel() == startLevel);
+	const char *env = getenv("IMAGEUTILS_CPU");
+	if (env && (strcmp(env, "sse41") == 0 || strcmp(env, "SSE4.1") == 0 || strcmp(env, "sse4.1") == 0))
+		ok = ok && (getSimdLevel() <= SIMD_LEVEL_SSE41);
+	if (!ok) {
+		fprintf(stderr, "ERROR: setMaxSimdLevel() changed the SIMD level limit from IMAGEUTILS_CPU='%s'!\n", env ? env : "");
+	}
+	return ok;
+}
+
+// Check that createGraphWriter() only takes PNG paths with a single %d or %0Nd, since the path is the caller's text,
+// and that it returns NULL for bad arguments instead of exiting.
+// The good paths never get an image, so no files are written.
+static bool checkGraphWriterPaths(void)
+{
+	const char *goodPaths[] = { "graph_%d.png", "graph_%05d.png", "100%%_%d.png" };
+	const char *badPaths[] = { "graph.png", "graph_%s.png", "graph_%d_%d.png", "graph_%x.png", "graph_%5d.png",
+		"graph_%n.png", "graph_%d%.png", "graph_%" };
+	bool ok = true;
+	for (size_t i=0; i<sizeof(goodPaths)/sizeof(goodPaths[0]); i++) {
+		GraphWriter *writer = createGraphWriter(goodPaths[i]);
+		if (!writer) {
+			fprintf(stderr, "ERROR: createGraphWriter() rejected the good path '%s'!\n", goodPaths[i]);
+			ok = false;
+		}
+		releaseGraphWriter(&writer);
+	}
+	for (size_t i=0; i<sizeof(badPaths)/sizeof(badPaths[0]); i++) {
+		GraphWriter *writer = createGraphWriter(badPaths[i]);
+		if (writer) {
+			fprintf(stderr, "ERROR: createGraphWriter() took the bad path '%s'!\n", badPaths[i]);
+			ok = false;
+		}
+		releaseGraphWriter(&writer);
+	}
+	// The other bad arguments are rejected the same way.
+	GraphWriter *writer = createGraphWriter(goodPaths[0], GRAPH_WRITER_PNG, 30, 0);
+	if (writer) {
+		fprintf(stderr, "ERROR: createGraphWriter() took a queue size of 0!\n");
+		ok = false;
+	}
+	releaseGraphWriter(&writer);
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	bool quick = false;
+	const char *kernelFilter = 0;
+	const char *outputPath = 0;
+	for (int i=1; i<argc; i++) {
+		if (strcmp(argv[i], "--quick") == 0)
+			quick = true;
+		else if (strcmp(argv[i], "--kernel") == 0 && i+1 < argc)
+			kernelFilter = argv[++i];
+		else if (strcmp(argv[i], "--output") == 0 && i+1 < argc)
+			outputPath = argv[++i];
+		else {
+			fprintf(stderr, "Usage: %s [--quick] [--kernel name] [--output results.json]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	vector<cv::Size> sizes;
+	sizes.push_back(cv::Size(640, 480));
+	if (!quick)
+		sizes.push_back(cv::Size(1280, 720));
+	sizes.push_back(cv::Size(1920, 1080));
+	if (!quick) {
+		sizes.push_back(cv::Size(3840, 2160));
+		sizes.push_back(cv::Size(7680, 4320));
+	}
+
+	int cpuThreads = max(cv::getNumberOfCPUs(), 1);
+	vector<int> threadCounts;
+	for (int n=1; n<cpuThreads; n*=2) {
+		if (!quick || n == 1)
+			threadCounts.push_back(n);
+	}
+	threadCounts.push_back(cpuThreads);
+
+	if (!checkSimdLevelLimits() || !checkGraphWriterPaths())
+		return 2;
+	SimdLevel cpuLevel = getSimdLevel();
+	const double minSeconds = quick ? 0.05 : 0.25;
+	const int GRAIN_ROWS = 16;
+
+	// Bake the HSV conversion into a LUT.
+	imageutils::IplImagePtr lattice(createColorLUTLattice(33));
+	cv::Mat latticeHSV;
+	imageutils::convertRGBtoHSV(imageutils::toMat(lattice.get()), latticeHSV);
+	imageutils::ColorLUTPtr lutHSV = imageutils::createColorLUTFromLattice(latticeHSV);
+
+	vector<BenchKernel> kernels = getBenchKernels(lutHSV.get());
+	vector<BenchResult> results;
+	for (size_t s=0; s<sizes.size(); s++) {
+		cv::Mat frameBGR = makeTestFrame(sizes[s]);
+		for (size_t k=0; k<kernels.size(); k++) {
+			const BenchKernel &kernel = kernels[k];
+			if (kernelFilter && kernel.name.find(kernelFilter) == string::npos)
+				continue;
+			fprintf(stderr, "%s %dx%d\n", kernel.name.c_str(), sizes[s].width, sizes[s].height);
+			cv::Mat src = kernel.makeInput(frameBGR);
+
+			// The plain C++ kernels on a single thread give the output that every other run must match.
+			vector<cv::Mat> outputC;
+			setMaxSimdLevel(SIMD_LEVEL_NONE);
+			kernel.run(src, outputC, 0);
+			vector<cv::Mat> outputRef;
+			if (kernel.runReference)
+				kernel.runReference(src, outputRef);
+
+			for (size_t t=0; t<threadCounts.size(); t++) {
+				int threads = threadCounts[t];
+				int grainRows = (threads > 1) ? GRAIN_ROWS : 0;
+				cv::setNumThreads(threads);
+				tbb::task_arena arena(threads);
+				double referenceMs = -1.0;
+				if (kernel.runReference) {
+					vector<cv::Mat> dst;
+					referenceMs = timeMedian_ms([&]() { kernel.runReference(src, dst); }, minSeconds);
+				}
+				for (int level=SIMD_LEVEL_NONE; level<=cpuLevel; level++) {
+					setMaxSimdLevel((SimdLevel)level);
+					vector<cv::Mat> dst;
+					BenchResult result;
+					result.kernel = kernel.name;
+					result.size = sizes[s];
+					result.threads = threads;
+					result.simdLevel = (SimdLevel)level;
+					arena.execute([&]() {
+						result.ms = timeMedian_ms([&]() { kernel.run(src, dst, grainRows); }, minSeconds);
+					});
+					result.referenceMs = referenceMs;
+					result.reference = kernel.reference;
+					result.matchesC = sameOutputs(dst, outputC);
+					result.hasAccuracy = kernel.compareOutput && !outputRef.empty();
+					if (result.hasAccuracy)
+						result.accuracy = compareOutputs(dst, outputRef, kernel.hueFirst);
+					results.push_back(result);
+					if (!result.matchesC) {
+						fprintf(stderr, "  ERROR: %s with %d threads doesn't match the C kernels!\n", getSimdLevelName(result.simdLevel),
+							threads);
+					}
+				}
+			}
+		}
+	}
+	setMaxSimdLevel(SIMD_LEVEL_AVX512);
+	cv::setNumThreads(-1);
+
+	FILE *out = stdout;
+	if (outputPath) {
+		out = fopen(outputPath, "w");
+		if (!out) {
+			fprintf(stderr, "ERROR: Couldn't write to '%s'.\n", outputPath);
+			return 1;
+		}
+	}
+	printJSON(out, results, cpuLevel, cpuThreads);
+	if (out != stdout)
+		fclose(out);
+
+	// Fail if any SIMD level or thread count gave different pixels, so it can be used to catch regressions.
+	for (size_t i=0; i<results.size(); i++) {
+		if (!results[i].matchesC)
+			return 2;
+	}
+	return 0;
+}
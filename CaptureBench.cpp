@@ -0,0 +1,99 @@
+/**		CaptureBench.cpp:		Headless decode benchmark for VideoCapture, without any highgui windows or delays.
+ **/
+
+#include <algorithm>
+#include <math.h>
+#include <iostream>
+
+#if defined(_WIN32)
+	#include <windows.h>
+	#include <psapi.h>
+#else
+	#include <sys/resource.h>
+#endif
+
+#include "CaptureBench.h"
+#include "ParallelReader.h"
+
+
+using namespace std;
+
+
+// Time every call to readFrame() until it fails or maxFrames have been read.
+static CaptureBenchResult runBenchmark(const function<bool(cv::Mat&)> &readFrame, int64 maxFrames)
+{
+	CaptureBenchResult result;
+	vector<double> latency_ms;
+	double tickToMs = 1000.0 / cv::getTickFrequency();
+	cv::Mat frame;
+
+	int64 timeStart = cv::getTickCount();
+	while (maxFrames <= 0 || (int64)latency_ms.size() < maxFrames) {
+		int64 t0 = cv::getTickCount();
+		if (!readFrame(frame) || frame.empty())
+			break;	// End of the video.
+		latency_ms.push_back((double)(cv::getTickCount() - t0) * tickToMs);
+	}
+	int64 timeEnd = cv::getTickCount();
+
+	sort(latency_ms.begin(), latency_ms.end());
+	result.frames = (int64)latency_ms.size();
+	result.totalSeconds = (double)(timeEnd - timeStart) / cv::getTickFrequency();
+	result.fps = (result.totalSeconds > 0.0) ? result.frames / result.totalSeconds : 0.0;
+	result.p50_ms = getPercentile(latency_ms, 0.50);
+	result.p95_ms = getPercentile(latency_ms, 0.95);
+	result.p99_ms = getPercentile(latency_ms, 0.99);
+	result.max_ms = latency_ms.empty() ? 0.0 : latency_ms.back();
+	result.peakRSS_kB = getPeakRSS_kB();
+	return result;
+}
+
+CaptureBenchResult runCaptureBenchmark(cv::VideoCapture &cap, int64 maxFrames)
+{
+	return runBenchmark([&](cv::Mat &frame) { return cap.read(frame); }, maxFrames);
+}
+
+CaptureBenchResult runCaptureBenchmark(ParallelReader &reader, int64 maxFrames)
+{
+	return runBenchmark([&](cv::Mat &frame) { return reader.read(frame); }, maxFrames);
+}
+
+void printCaptureBenchResult(const CaptureBenchResult &result, const char *label)
+{
+	if (label)
+		cout << label << ": ";
+	cout << "Decoded " << result.frames << " frames in " << result.totalSeconds << " s = " << result.fps << " fps." << endl;
+	cout << "  decode latency: p50=" << result.p50_ms << " ms, p95=" << result.p95_ms << " ms, p99=" << result.p99_ms
+		<< " ms, max=" << result.max_ms << " ms." << endl;
+	cout << "  peak RSS: " << result.peakRSS_kB << " kB." << endl;
+}
+
+double getPercentile(const vector<double> &sortedSamples, double fraction)
+{
+	if (sortedSamples.empty())
+		return 0.0;
+	// Nearest-rank percentile.
+	int n = (int)sortedSamples.size();
+	int i = (int)ceil(fraction * n) - 1;
+	i = max(0, min(i, n - 1));
+	return sortedSamples[i];
+}
+
+long getPeakRSS_kB(void)
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return (long)(counters.PeakWorkingSetSize / 1024);
+	return -1;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return -1;
+	#if defined(__APPLE__)
+		return usage.ru_maxrss / 1024;	// Given in bytes on Mac OS X.
+	#else
+		return usage.ru_maxrss;			// Given in kilobytes on Linux.
+	#endif
+#endif
+}
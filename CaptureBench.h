@@ -0,0 +1,44 @@
+/**		CaptureBench.h:		Headless decode benchmark for VideoCapture, without any highgui windows or delays.
+ **/
+
+#ifndef CAPTURE_BENCH_H
+#define CAPTURE_BENCH_H
+
+#include <functional>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+
+// Results of decoding a whole video as fast as possible.
+struct CaptureBenchResult {
+	int64 frames;			// Number of frames decoded.
+	double totalSeconds;	// Wall-clock time for the whole run.
+	double fps;				// frames / totalSeconds.
+	double p50_ms;			// Per-frame decode latency percentiles, in milliseconds.
+	double p95_ms;
+	double p99_ms;
+	double max_ms;
+	long peakRSS_kB;		// Peak resident memory of the process, or -1 if unknown.
+};
+
+class ParallelReader;
+
+// Decode every frame of 'cap' as fast as possible, timing each read().
+// Set maxFrames to stop early, or leave it as 0 to decode until the end of the video.
+CaptureBenchResult runCaptureBenchmark(cv::VideoCapture &cap, int64 maxFrames = 0);
+
+// Same as runCaptureBenchmark(), but reading the frames from a multi-threaded ParallelReader.
+CaptureBenchResult runCaptureBenchmark(ParallelReader &reader, int64 maxFrames = 0);
+
+// Print the benchmark results to std::cout.
+void printCaptureBenchResult(const CaptureBenchResult &result, const char *label = 0);
+
+// Return the value below which the given fraction (0 to 1) of the sorted samples fall.
+double getPercentile(const std::vector<double> &sortedSamples, double fraction);
+
+// Return the peak resident memory (RSS) of this process in kilobytes, or -1 if it isn't available.
+long getPeakRSS_kB(void);
+
+#endif	// CAPTURE_BENCH_H
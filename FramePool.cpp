@@ -0,0 +1,154 @@
+/**		FramePool.cpp:		Reusable pool of 64-byte aligned frame buffers, so a video loop doesn't allocate a new frame every iteration.
+ **/
+
+#include "FramePool.h"
+
+
+using namespace std;
+
+
+static const int POOL_ALIGNMENT = 64;	// Cache-line alignment, also enough for AVX-512 loads.
+
+
+FramePool::FramePool(int nBuffers, cv::Size frameSize, int type)
+	: capacity(0), generation(0), nAllocations(0), nCheckouts(0)
+{
+	capacity = cv::alignSize((size_t)frameSize.width * frameSize.height * CV_ELEM_SIZE(type), POOL_ALIGNMENT);
+	for (int i=0; i<nBuffers && capacity > 0; i++)
+		freeList.push_back(newBuffer(capacity));
+}
+
+FramePool::~FramePool()
+{
+	for (size_t i=0; i<freeList.size(); i++)
+		freeBuffer(freeList[i]);
+	freeList.clear();
+}
+
+cv::Mat FramePool::checkout(cv::Size size, int type)
+{
+	cv::Mat frame;
+	frame.allocator = this;
+	frame.create(size, type);
+	return frame;
+}
+
+void FramePool::attach(cv::Mat &frame)
+{
+	frame.allocator = this;
+}
+
+int64 FramePool::allocations() const
+{
+	lock_guard<mutex> guard(lock);
+	return nAllocations;
+}
+
+int64 FramePool::checkouts() const
+{
+	lock_guard<mutex> guard(lock);
+	return nCheckouts;
+}
+
+int FramePool::available() const
+{
+	lock_guard<mutex> guard(lock);
+	return (int)freeList.size();
+}
+
+size_t FramePool::bufferSize() const
+{
+	lock_guard<mutex> guard(lock);
+	return capacity;
+}
+
+// Allocate a new aligned block from the system. Must be called with the lock held.
+cv::UMatData* FramePool::newBuffer(size_t size) const
+{
+	uchar *raw = (uchar*)cv::fastMalloc(size + POOL_ALIGNMENT);
+	cv::UMatData *u = new cv::UMatData(this);
+	u->origdata = raw;
+	u->data = cv::alignPtr(raw, POOL_ALIGNMENT);
+	u->allocatorFlags_ = generation;	// Remember which capacity this block was made for.
+	nAllocations++;
+	return u;
+}
+
+void FramePool::freeBuffer(cv::UMatData* u) const
+{
+	cv::fastFree(u->origdata);
+	u->origdata = 0;
+	delete u;
+}
+
+cv::UMatData* FramePool::allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+	cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const
+{
+	// Get the (contiguous) size of the data, the same way as cv::Mat's default allocator.
+	size_t total = CV_ELEM_SIZE(type);
+	for (int i=dims-1; i>=0; i--) {
+		if (step) {
+			if (data0 && step[i] != cv::Mat::AUTO_STEP)
+				total = step[i];
+			else
+				step[i] = total;
+		}
+		total *= sizes[i];
+	}
+
+	// Data given by the user is just wrapped, never pooled.
+	if (data0) {
+		cv::UMatData *u = new cv::UMatData(this);
+		u->data = u->origdata = (uchar*)data0;
+		u->size = total;
+		u->flags |= cv::UMatData::USER_ALLOCATED;
+		u->allocatorFlags_ = -1;
+		return u;
+	}
+
+	lock_guard<mutex> guard(lock);
+	if (total > capacity) {
+		// Frames got bigger, so the pooled buffers are now useless.
+		capacity = cv::alignSize(total, POOL_ALIGNMENT);
+		generation++;
+		for (size_t i=0; i<freeList.size(); i++)
+			freeBuffer(freeList[i]);
+		freeList.clear();
+	}
+
+	cv::UMatData *u;
+	if (!freeList.empty()) {
+		u = freeList.back();
+		freeList.pop_back();
+	}
+	else {
+		u = newBuffer(capacity);	// The pool ran dry, so it grows by one buffer.
+	}
+	u->size = total;
+	u->refcount = 0;
+	u->urefcount = 0;
+	nCheckouts++;
+	return u;
+}
+
+bool FramePool::allocate(cv::UMatData* u, cv::AccessFlag /*accessflags*/, cv::UMatUsageFlags /*usageFlags*/) const
+{
+	return u != 0;
+}
+
+void FramePool::deallocate(cv::UMatData* u) const
+{
+	if (!u)
+		return;
+	CV_Assert(u->urefcount == 0 && u->refcount == 0);
+	if (u->allocatorFlags_ < 0) {
+		delete u;	// Wrapped user data.
+		return;
+	}
+
+	lock_guard<mutex> guard(lock);
+	if (u->allocatorFlags_ == generation)
+		freeList.push_back(u);		// Return the buffer to the pool for the next frame.
+	else
+		freeBuffer(u);				// Too small for the current frames.
+}
@@ -0,0 +1,58 @@
+/**		FramePool.h:		Reusable pool of 64-byte aligned frame buffers, so a video loop doesn't allocate a new frame every iteration.
+ **/
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <mutex>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+
+// A cv::MatAllocator that hands out buffers from a pool of pre-sized, 64-byte aligned blocks.
+// The usual cv::Mat reference counting decides when a buffer is returned: once the last Mat that shares
+// a buffer is released, the buffer goes back to the pool instead of being freed.
+// Sample usage:
+//	FramePool pool(4, Size(1920,1080));
+//	Mat frame;
+//	pool.attach(frame);		// frame.create() and cap.read(frame) now draw from the pool.
+//	Mat hsv = pool.checkout(frame.size(), CV_8UC3);
+// Note that the pool must outlive every Mat that uses it.
+class FramePool : public cv::MatAllocator
+{
+public:
+	// Allocate nBuffers blocks that are each big enough for a frame of the given size and type.
+	// If more buffers are needed at once, the pool grows (and counts the extra allocation).
+	FramePool(int nBuffers, cv::Size frameSize, int type = CV_8UC3);
+	~FramePool();
+
+	// Get a frame of the given size and type, whose buffer comes from the pool.
+	cv::Mat checkout(cv::Size size, int type);
+	// Make 'frame' draw any future buffers from this pool (eg: before passing it to VideoCapture::read()).
+	void attach(cv::Mat &frame);
+
+	int64 allocations() const;	// Number of buffers allocated from the system, including the initial ones.
+	int64 checkouts() const;	// Number of buffers handed out from the pool.
+	int available() const;		// Number of buffers currently sitting in the pool.
+	size_t bufferSize() const;	// Size in bytes of each pooled buffer.
+
+	// cv::MatAllocator interface, used by cv::Mat.
+	cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+		cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const;
+	bool allocate(cv::UMatData* data, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const;
+	void deallocate(cv::UMatData* data) const;
+
+private:
+	cv::UMatData* newBuffer(size_t size) const;
+	void freeBuffer(cv::UMatData* u) const;
+
+	mutable std::mutex lock;
+	mutable std::vector<cv::UMatData*> freeList;	// Unused buffers, each of capacity 'capacity'.
+	mutable size_t capacity;		// Size of each pooled buffer in bytes.
+	mutable int generation;			// Increased whenever the capacity grows, so older buffers are freed on return.
+	mutable int64 nAllocations;
+	mutable int64 nCheckouts;
+};
+
+#endif	// FRAME_POOL_H
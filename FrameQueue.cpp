@@ -0,0 +1,144 @@
+/**		FrameQueue.cpp:		Bounded ring of preallocated frames, so video can be decoded on a separate thread from where it is displayed.
+ **/
+
+#include <iostream>
+
+#include "FrameQueue.h"
+
+
+using namespace std;
+
+
+FrameRingBuffer::FrameRingBuffer(int depth, FrameQueuePolicy policy, cv::Size frameSize, int type, cv::MatAllocator *allocator)
+	: queuePolicy(policy), head(0), count(0), writeSlot(-1), closed(false), pushed(0), dropped(0)
+{
+	if (depth < 1) {
+		cerr << "ERROR in FrameRingBuffer(): Bad queue depth of " << depth << ", using 1 instead." << endl;
+		depth = 1;
+	}
+	slots.resize(depth);
+	slotIndex.resize(depth, -1);
+	slotPts.resize(depth, 0.0);
+	for (int i=0; i<depth; i++)
+		slots[i].allocator = allocator;
+
+	// Allocate the frames now, instead of on the first pass through the ring.
+	if (frameSize.width > 0 && frameSize.height > 0) {
+		for (int i=0; i<depth; i++)
+			slots[i].create(frameSize, type);
+	}
+}
+
+cv::Mat* FrameRingBuffer::beginWrite()
+{
+	unique_lock<mutex> guard(lock);
+	int n = (int)slots.size();
+	if (queuePolicy == FRAME_QUEUE_BLOCK)
+		notFull.wait(guard, [&]{ return closed || count < n; });
+	if (closed)
+		return NULL;
+
+	if (count == n) {
+		// The consumer is behind, so reuse the oldest frame's slot for the new frame.
+		head = (head + 1) % n;
+		count--;
+		dropped++;
+	}
+
+	writeSlot = (head + count) % n;
+	return &slots[writeSlot];
+}
+
+void FrameRingBuffer::endWrite(int64 frameIndex, double pts_ms)
+{
+	{
+		lock_guard<mutex> guard(lock);
+		if (writeSlot < 0)
+			return;
+		slotIndex[writeSlot] = frameIndex;
+		slotPts[writeSlot] = pts_ms;
+		writeSlot = -1;
+		count++;
+		pushed++;
+	}
+	notEmpty.notify_one();
+}
+
+bool FrameRingBuffer::pop(cv::Mat &frame, int64 *frameIndex, double *pts_ms)
+{
+	{
+		unique_lock<mutex> guard(lock);
+		notEmpty.wait(guard, [&]{ return closed || count > 0; });
+		if (count == 0)
+			return false;	// Closed and drained.
+		takeHead(frame, frameIndex, pts_ms);
+	}
+	notFull.notify_one();
+	return true;
+}
+
+bool FrameRingBuffer::tryPop(cv::Mat &frame, int64 *frameIndex, double *pts_ms)
+{
+	{
+		lock_guard<mutex> guard(lock);
+		if (count == 0)
+			return false;
+		takeHead(frame, frameIndex, pts_ms);
+	}
+	notFull.notify_one();
+	return true;
+}
+
+// Hand over the oldest ready frame, and give the consumer's old buffer back to the ring. Must be called with the lock held.
+void FrameRingBuffer::takeHead(cv::Mat &frame, int64 *frameIndex, double *pts_ms)
+{
+	cv::swap(frame, slots[head]);
+	if (frameIndex)
+		*frameIndex = slotIndex[head];
+	if (pts_ms)
+		*pts_ms = slotPts[head];
+	head = (head + 1) % (int)slots.size();
+	count--;
+}
+
+void FrameRingBuffer::close()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		closed = true;
+		writeSlot = -1;
+	}
+	notEmpty.notify_all();
+	notFull.notify_all();
+}
+
+int64 FrameRingBuffer::framesPushed() const
+{
+	lock_guard<mutex> guard(lock);
+	return pushed;
+}
+
+int64 FrameRingBuffer::framesDropped() const
+{
+	lock_guard<mutex> guard(lock);
+	return dropped;
+}
+
+
+// Body of the decode thread: keep filling free slots until the stream ends or the consumer closes the queue.
+static void decodeFrames(cv::VideoCapture *cap, FrameRingBuffer *queue)
+{
+	int64 frameIndex = 0;
+	cv::Mat *slot;
+	while ((slot = queue->beginWrite()) != NULL) {
+		if (!cap->read(*slot) || slot->empty())
+			break;	// End of the video.
+		queue->endWrite(frameIndex++, cap->get(cv::CAP_PROP_POS_MSEC));
+	}
+	queue->close();
+}
+
+std::thread startDecodeThread(cv::VideoCapture &cap, FrameRingBuffer &queue)
+{
+	return std::thread(decodeFrames, &cap, &queue);
+}
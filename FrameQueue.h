@@ -0,0 +1,76 @@
+/**		FrameQueue.h:		Bounded ring of preallocated frames, so video can be decoded on a separate thread from where it is displayed.
+ **/
+
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+
+// What the decode thread should do when the consumer has fallen behind and every slot is full.
+enum FrameQueuePolicy {
+	FRAME_QUEUE_BLOCK,			// Wait for the consumer to free a slot, so no frame is ever lost.
+	FRAME_QUEUE_DROP_OLDEST		// Throw away the oldest undisplayed frame, so the consumer always gets recent video.
+};
+
+// A fixed number of cv::Mat slots shared by one producer (the decoder) and one consumer.
+// Frames are never copied: the producer decodes straight into a free slot, and the consumer swaps the
+// ready slot with its own Mat, so the buffers just rotate between the decoder and the consumer.
+class FrameRingBuffer
+{
+public:
+	// If frameSize is given, every slot is allocated up front so the decoder never has to allocate.
+	// If allocator is given (eg: a FramePool), the slots get their buffers from it.
+	FrameRingBuffer(int depth, FrameQueuePolicy policy, cv::Size frameSize = cv::Size(), int type = CV_8UC3,
+		cv::MatAllocator *allocator = 0);
+
+	// Producer: get the next free slot to decode into, waiting or dropping the oldest frame if the ring is full.
+	// Returns NULL once the queue has been closed.
+	cv::Mat* beginWrite();
+	// Producer: publish the slot returned by beginWrite() as the given frame number, with its timestamp in milliseconds.
+	void endWrite(int64 frameIndex, double pts_ms = 0.0);
+
+	// Consumer: wait for the oldest ready frame and swap it into 'frame' (the old contents of 'frame' are recycled).
+	// Returns false once the queue is closed and every remaining frame has been popped.
+	bool pop(cv::Mat &frame, int64 *frameIndex = 0, double *pts_ms = 0);
+	// Consumer: same as pop(), but return false straight away if no frame is ready yet.
+	bool tryPop(cv::Mat &frame, int64 *frameIndex = 0, double *pts_ms = 0);
+
+	// Stop both sides. Frames already in the ring can still be popped.
+	void close();
+
+	int depth() const { return (int)slots.size(); }
+	FrameQueuePolicy policy() const { return queuePolicy; }
+	int64 framesPushed() const;
+	int64 framesDropped() const;
+
+private:
+	void takeHead(cv::Mat &frame, int64 *frameIndex, double *pts_ms);
+
+	std::vector<cv::Mat> slots;
+	std::vector<int64> slotIndex;	// Frame number stored in each slot.
+	std::vector<double> slotPts;	// Timestamp of each slot's frame, in milliseconds.
+	FrameQueuePolicy queuePolicy;
+	int head;			// Slot of the oldest ready frame.
+	int count;			// Number of ready frames, starting at head.
+	int writeSlot;		// Slot given out by beginWrite(), or -1.
+	bool closed;
+	int64 pushed;
+	int64 dropped;
+
+	mutable std::mutex lock;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+};
+
+// Decode every frame of 'cap' into 'queue' on a new thread, and close the queue at the end of the stream.
+// The caller must keep 'cap' and 'queue' alive until the returned thread is joined.
+std::thread startDecodeThread(cv::VideoCapture &cap, FrameRingBuffer &queue);
+
+#endif	// FRAME_QUEUE_H
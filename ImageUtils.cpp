@@ -3,22 +3,118 @@
  **/
 
 #include <stdio.h>
+#include <stdlib.h>		// for getenv()
+#include <ctype.h>		// for tolower()
 //#include <tchar.h>
 #include <string>
 #include <vector>
 #include <iostream>		// for printing streams in C++
 #include <sstream>		// for printing floats in C++
 #include <fstream>		// for opening files in C++
+#include <thread>		// for the GraphWriter thread
+#include <atomic>		// for the SIMD level set by setMaxSimdLevel()
 
 // OpenCV
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/core_c.h>			// for the C API (IplImage, cvCreateImage, etc), no longer in opencv.hpp
+#include <opencv2/imgproc/imgproc_c.h>
+#include <opencv2/highgui/highgui_c.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 
 #include "ImageUtils.h"
+#include "ImageUtils.hpp"
+#include "ImageUtilsSimd.h"
+#include "ImageUtilsTemplates.h"
+#include "FrameQueue.h"		// for the queue of the GraphWriter
+
+// The SIMD row kernels are only built for x86 CPUs.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define IMAGE_UTILS_X86_SIMD
+#endif
 
 
 using namespace std;
 
 
+//------------------------------------------------------------------------------
+// Picking the SIMD kernels for this CPU
+//------------------------------------------------------------------------------
+
+// Find the fastest level of SIMD kernels that this CPU (and OS) supports.
+static SimdLevel detectSimdLevel(void)
+{
+#ifdef IMAGE_UTILS_X86_SIMD
+	if (cv::checkHardwareSupport(CV_CPU_AVX_512F) && cv::checkHardwareSupport(CV_CPU_AVX_512BW)
+			&& cv::checkHardwareSupport(CV_CPU_AVX_512VL) && cv::checkHardwareSupport(CV_CPU_AVX_512DQ))
+		return SIMD_LEVEL_AVX512;
+	if (cv::checkHardwareSupport(CV_CPU_AVX2))
+		return SIMD_LEVEL_AVX2;
+	if (cv::checkHardwareSupport(CV_CPU_SSE4_1))
+		return SIMD_LEVEL_SSE41;
+#endif
+	return SIMD_LEVEL_NONE;
+}
+
+// Get the highest level of SIMD kernels allowed by the IMAGEUTILS_CPU environment variable, that can be set to
+// "C" (or "SSE2"), "SSE4.1", "AVX2" or "AVX512" to force a level, eg: to rule out a kernel on some machine.
+static SimdLevel getSimdLevelFromEnv(void)
+{
+	const char *env = getenv("IMAGEUTILS_CPU");
+	if (!env || !env[0])
+		return SIMD_LEVEL_AVX512;
+	string name;
+	for (const char *c=env; *c; c++) {
+		if (*c != '.' && *c != '-' && *c != '_')
+			name += (char)tolower(*c);
+	}
+	if (name == "c" || name == "none" || name == "sse2" || name == "baseline")
+		return SIMD_LEVEL_NONE;
+	if (name == "sse41")
+		return SIMD_LEVEL_SSE41;
+	if (name == "avx2")
+		return SIMD_LEVEL_AVX2;
+	if (name == "avx512")
+		return SIMD_LEVEL_AVX512;
+	printf("WARNING in ImageUtils! Unknown IMAGEUTILS_CPU value '%s', so it is ignored. Use C, SSE2, SSE4.1, AVX2 or AVX512.\n", env);
+	return SIMD_LEVEL_AVX512;
+}
+
+// Both are found once when the program or library is loaded, instead of for every conversion.
+static const SimdLevel cpuSimdLevel = detectSimdLevel();
+static const SimdLevel envSimdLevel = getSimdLevelFromEnv();
+// The limit from setMaxSimdLevel(), kept apart from the environment's limit so that it can't undo it.
+// It is atomic since the conversions read it from the TBB threads while another thread might be setting it.
+static std::atomic<int> userSimdLevel(SIMD_LEVEL_AVX512);
+
+// Limit the color conversions to SIMD kernels up to maxLevel, eg: to compare the speed & accuracy of each level.
+void setMaxSimdLevel(SimdLevel maxLevel)
+{
+	userSimdLevel.store((int)maxLevel);
+}
+
+// Get the level of SIMD kernels that the color conversions use, that is the fastest this CPU supports up to both
+// IMAGEUTILS_CPU and setMaxSimdLevel().
+SimdLevel getSimdLevel(void)
+{
+	return (SimdLevel)min(min((int)cpuSimdLevel, (int)envSimdLevel), userSimdLevel.load());
+}
+
+// Get the fastest version of a row kernel that this CPU supports.
+template<typename ROW_FUNC>
+static ROW_FUNC getRowFunc(ROW_FUNC funcC, ROW_FUNC funcSSE41, ROW_FUNC funcAVX2, ROW_FUNC funcAVX512)
+{
+	switch (getSimdLevel()) {
+		case SIMD_LEVEL_AVX512:	return funcAVX512;
+		case SIMD_LEVEL_AVX2:	return funcAVX2;
+		case SIMD_LEVEL_SSE41:	return funcSSE41;
+		default:				return funcC;
+	}
+}
+
+
 //------------------------------------------------------------------------------
 // Graphing functions
 //------------------------------------------------------------------------------
@@ -26,13 +122,11 @@ const CvScalar BLACK = CV_RGB(0,0,0);
 const CvScalar WHITE = CV_RGB(255,255,255);
 const CvScalar GREY = CV_RGB(150,150,150);
 
-// Get a new color to draw graphs. Will change between blue, green, red, dark-blue, dark-green and dark-red until a new image is created.
-CvScalar getGraphColor(void)
+// Step through the colors to draw graphs with, where *countGraph is the number of colors used so far.
+static CvScalar getNextGraphColor(int *countGraph)
 {
-	static int countGraph = 0;
-
-	countGraph++;
-	switch (countGraph) {
+	(*countGraph)++;
+	switch (*countGraph) {
 	case 1:	return CV_RGB(60,60,255);	// light-blue
 	case 2:	return CV_RGB(60,255,60);	// light-green
 	case 3:	return CV_RGB(255,60,40);	// light-red
@@ -43,18 +137,40 @@ CvScalar getGraphColor(void)
 	case 8:	return CV_RGB(0,185,0);		// dark-green
 	case 9:	return CV_RGB(185,0,0);		// dark-red
 	default:
-		countGraph = 0;	// start rotating through colors again.
+		*countGraph = 0;	// start rotating through colors again.
 		return CV_RGB(200,200,200);	// grey
 	}
 }
 
-// Draw the graph of an array of floats into imageDst or a new image.
-// Remember to free the newly drawn image, even if imageDst isnt given.
-IplImage* drawFloatGraph(const float *arraySrc, int nArrayLength, IplImage *imageDst)
+// Get a new color to draw graphs. Will change between blue, green, red, dark-blue, dark-green and dark-red until a new image is created.
+// Each thread steps through the colors by itself, so graphs can be drawn on several threads at once.
+CvScalar getGraphColor(void)
+{
+	static thread_local int countGraph = 0;
+	return getNextGraphColor(&countGraph);
+}
+
+// The size of the plot of each graph, and of the border around the plot within the graph image.
+static const int GRAPH_HEIGHT = 200;
+static const int GRAPH_BORDER = 10;
+
+// Draw the horizontal & vertical axis of a graph of nColumns values.
+static void drawGraphAxes(IplImage *imageGraph, int nColumns)
+{
+	int s = GRAPH_HEIGHT;	// size of graph height
+	int b = GRAPH_BORDER;	// border around graph within the image
+	int h = s + b*2;		// height of the image
+	cvLine(imageGraph, cvPoint(b,h-b), cvPoint(b+nColumns, h-b), BLACK);
+	cvLine(imageGraph, cvPoint(b,h-b), cvPoint(b, h-(b+s)), BLACK);
+}
+
+// Get the image to draw a graph of nColumns values into, with its horizontal & vertical axis drawn.
+// It is a new white image, or a copy of imageDst, so we know we have to free an image later.
+static IplImage* createGraphImage(int nColumns, const IplImage *imageDst, const char *funcName)
 {
-	int s = 200;	// size of graph height
-	int b = 10;		// border around graph within the image
-	int w = nArrayLength + b*2;	// width of the image
+	int s = GRAPH_HEIGHT;	// size of graph height
+	int b = GRAPH_BORDER;	// border around graph within the image
+	int w = nColumns + b*2;	// width of the image
 	int h = s + b*2;		// height of the image
 	IplImage *imageGraph;	// output image
 
@@ -62,631 +178,2489 @@ IplImage* drawFloatGraph(const float *arraySrc, int nArrayLength, IplImage *imag
 	if (!imageDst) {
 		// Create an RGB image for graphing the data
 		imageGraph = cvCreateImage(cvSize(w,h), 8, 3);
-
-		// Clear the image
-		cvSet(imageGraph, WHITE);
+		if (imageGraph)
+			cvSet(imageGraph, WHITE);	// Clear the image
 	}
 	else {
-		// Create a new copy of the image, so we know we have to free an image later
 		imageGraph = cvCloneImage(imageDst);
 	}
 	if (!imageGraph) {
-		cerr << "ERROR in drawFloatGraph(): Couldn't create image of " << w << " x " << h << endl;
+		printf("ERROR in %s()! Couldn't create image of %d x %d.\n", funcName, w, h);
 		exit(1);
 	}
-	CvScalar colorGraph = getGraphColor();	// use a different color each time.
+	drawGraphAxes(imageGraph, nColumns);
+	return imageGraph;
+}
 
-	// Draw the horizontal & vertical axis
-	cvLine(imageGraph, cvPoint(b,h-b), cvPoint(b+nArrayLength, h-b), BLACK);
-	cvLine(imageGraph, cvPoint(b,h-b), cvPoint(b, h-(b+s)), BLACK);
+// Scalar version of findMinMaxFloat, also used for the last few floats by the SIMD versions.
+void findMinMaxFloat_C(const float *src, int n, float *minValue, float *maxValue)
+{
+	float minV = *minValue;
+	float maxV = *maxValue;
+	for (int i=0; i<n; i++) {
+		float v = src[i];
+		minV = (v < minV) ? v : minV;
+		maxV = (v > maxV) ? v : maxV;
+	}
+	*minValue = minV;
+	*maxValue = maxV;
+}
 
-	// Find the max value of the data, so we can draw it at full scale
-	float maxV = 0.0;
-	for (int i=0; i<nArrayLength; i++) {
-		float v = (float)arraySrc[i];
-		if (v > maxV)
-			maxV = v;
+// Widen the range from *minValue to *maxValue to include all the values of an array of floats, using the SIMD kernels.
+static void findGraphRange(const float *arraySrc, int nArrayLength, float *minValue, float *maxValue)
+{
+	MinMaxFunc findMinMax = getRowFunc(findMinMaxFloat_C, findMinMaxFloat_SSE41, findMinMaxFloat_AVX2, findMinMaxFloat_AVX512);
+	findMinMax(arraySrc, nArrayLength, minValue, maxValue);
+}
+
+// Widen the range from *minValue to *maxValue to include all the values of an array of ints or uchars, using OpenCV's SIMD code.
+template<typename T>
+static void findGraphRange(const T *arraySrc, int nArrayLength, float *minValue, float *maxValue)
+{
+	double minV, maxV;
+	cv::minMaxIdx(cv::Mat(1, nArrayLength, cv::DataType<T>::type, (void*)arraySrc), &minV, &maxV);
+	*minValue = min(*minValue, (float)minV);
+	*maxValue = max(*maxValue, (float)maxV);
+}
+
+// Get the scale to draw values from minValue to maxValue over the height of a graph.
+static float getGraphScale(float minValue, float maxValue)
+{
+	float range = maxValue - minValue;
+	if (range <= 0.0f)
+		range = 0.00000001f;	// Stop a divide-by-zero error
+	return (float)GRAPH_HEIGHT / range;
+}
+
+// Get the height of a value above the horizontal axis of a graph, clipped to the graph (where NaN gives 0).
+// The clipping is done before the cast to int, since casting NaN or a huge float to int is undefined.
+static inline int getGraphY(float value, float minValue, float fscale)
+{
+	float fy = (value - minValue) * fscale;	// Get the values at a bigger scale
+	if (cvIsNaN(fy) || fy <= 0.0f)
+		return 0;
+	if (fy >= (float)GRAPH_HEIGHT)
+		return GRAPH_HEIGHT;
+	return (int)fy;
+}
+
+// Draw the line of a graph of an array of floats, ints or uchars into imageGraph. The values are scaled to fit the graph
+// (including 0) unless maxValue is bigger than minValue, and then drawn as a single polyline.
+template<typename T>
+static void drawGraphLine(IplImage *imageGraph, const T *arraySrc, int nArrayLength, float minValue, float maxValue,
+	CvScalar colorGraph)
+{
+	int b = GRAPH_BORDER;	// border around graph within the image
+	int h = GRAPH_HEIGHT + b*2;	// height of the image
+
+	// Find the range of the data, so we can draw it at full scale
+	if (maxValue <= minValue) {
+		minValue = 0.0f;
+		maxValue = 0.0f;
+		if (nArrayLength > 0)
+			findGraphRange(arraySrc, nArrayLength, &minValue, &maxValue);
 	}
+	float fscale = getGraphScale(minValue, maxValue);
 
-	// Draw the values
-	CvPoint ptPrev = cvPoint(b,h-b);	// Start the lines at the 1st point.
-	if (maxV == 0)
-		maxV = 0.00000001f;	// Stop a divide-by-zero error
-	float fscale = (float)s / maxV;
+	// Convert all the values to points in a single pass, then draw the lines between them with a single call.
+	vector<cv::Point> points(nArrayLength + 1);
+	points[0] = cv::Point(b, h-b);	// Start the lines at the origin.
 	for (int i=0; i<nArrayLength; i++) {
-		int y = (int)(arraySrc[i] * fscale);	// Get the values at a bigger scale
-		CvPoint ptNew = cvPoint(b+i,h-(b+y));
-		cvLine(imageGraph, ptPrev, ptNew, colorGraph);	// Draw a line from the previous point to the new point
-		ptPrev = ptNew;
+		int y = getGraphY((float)arraySrc[i], minValue, fscale);
+		points[i+1] = cv::Point(b+i, h-(b+y));
 	}
+	cv::Mat image = cv::cvarrToMat(imageGraph);
+	const cv::Point *pPoints = &points[0];
+	int nPoints = (int)points.size();
+	cv::polylines(image, &pPoints, &nPoints, 1, false, cv::Scalar(colorGraph));
+}
 
+// Draw the graph of an array of floats, ints or uchars into imageDst or a new image.
+template<typename T>
+static IplImage* drawGraph(const T *arraySrc, int nArrayLength, const IplImage *imageDst, float minValue, float maxValue,
+	const char *funcName)
+{
+	if (!arraySrc || nArrayLength < 0) {
+		printf("ERROR in %s()! Bad array of %d values.\n", funcName, nArrayLength);
+		exit(1);
+	}
+	IplImage *imageGraph = createGraphImage(nArrayLength, imageDst, funcName);
+	CvScalar colorGraph = getGraphColor();	// use a different color each time.
+	drawGraphLine(imageGraph, arraySrc, nArrayLength, minValue, maxValue, colorGraph);
 	return imageGraph;
 }
 
+// Draw the graph of an array of floats into imageDst or a new image.
+// Remember to free the newly drawn image, even if imageDst isnt given.
+IplImage* drawFloatGraph(const float *arraySrc, int nArrayLength, IplImage *imageDst, float minValue, float maxValue)
+{
+	return drawGraph(arraySrc, nArrayLength, imageDst, minValue, maxValue, "drawFloatGraph");
+}
+
 // Draw the graph of an array of ints into imageDst or a new image.
 // Remember to free the newly drawn image, even if imageDst isnt given.
-IplImage* drawIntGraph(const int *arraySrc, int nArrayLength, IplImage *imageDst)
+IplImage* drawIntGraph(const int *arraySrc, int nArrayLength, IplImage *imageDst, float minValue, float maxValue)
 {
-	int s = 200;	// size of graph height
-	int b = 10;		// border around graph within the image
-	int w = nArrayLength + b*2;	// width of the image
-	int h = s + b*2;		// height of the image
-	IplImage *imageGraph;	// output image
+	return drawGraph(arraySrc, nArrayLength, imageDst, minValue, maxValue, "drawIntGraph");
+}
 
-	// Get the desired image to draw into.
-	if (!imageDst) {
-		// Create an RGB image for graphing the data
-		imageGraph = cvCreateImage(cvSize(w,h), 8, 3);
+// Draw the graph of an array of uchars into imageDst or a new image.
+// Remember to free the newly drawn image, even if imageDst isnt given.
+IplImage* drawUCharGraph(const uchar *arraySrc, int nArrayLength, IplImage *imageDst, float minValue, float maxValue)
+{
+	return drawGraph(arraySrc, nArrayLength, imageDst, minValue, maxValue, "drawUCharGraph");
+}
+
+// Display a graph image into a window, then free it.
+static void showGraphImage(const char *name, IplImage *imageGraph, int delay_ms)
+{
+	// Display the graph into a window
+	cvNamedWindow( name );
+	cvShowImage( name, imageGraph );
+
+	cvWaitKey( 10 );		// Note that cvWaitKey() is required for the OpenCV window to show!
+	cvWaitKey( delay_ms );	// Wait longer to make sure the user has seen the graph
+
+	cvReleaseImage(&imageGraph);
+}
+
+// Display a graph of the given float array.
+// If background is provided, it will be drawn into, for combining multiple graphs using drawFloatGraph().
+// Set delay_ms to 0 if you want to wait forever until a keypress, or set it to 1 if you want it to delay just 1 millisecond.
+void showFloatGraph(const char *name, const float *arraySrc, int nArrayLength, int delay_ms, IplImage *background,
+	float minValue, float maxValue)
+{
+	showGraphImage(name, drawFloatGraph(arraySrc, nArrayLength, background, minValue, maxValue), delay_ms);
+}
+
+// Display a graph of the given int array.
+// If background is provided, it will be drawn into, for combining multiple graphs using drawIntGraph().
+// Set delay_ms to 0 if you want to wait forever until a keypress, or set it to 1 if you want it to delay just 1 millisecond.
+void showIntGraph(const char *name, const int *arraySrc, int nArrayLength, int delay_ms, IplImage *background,
+	float minValue, float maxValue)
+{
+	showGraphImage(name, drawIntGraph(arraySrc, nArrayLength, background, minValue, maxValue), delay_ms);
+}
+
+// Display a graph of the given unsigned char array.
+// If background is provided, it will be drawn into, for combining multiple graphs using drawUCharGraph().
+// Set delay_ms to 0 if you want to wait forever until a keypress, or set it to 1 if you want it to delay just 1 millisecond.
+void showUCharGraph(const char *name, const uchar *arraySrc, int nArrayLength, int delay_ms, IplImage *background,
+	float minValue, float maxValue)
+{
+	showGraphImage(name, drawUCharGraph(arraySrc, nArrayLength, background, minValue, maxValue), delay_ms);
+}
+
+// The state of drawing graphs for one thread or plot, so that graphs can be drawn in parallel without sharing anything.
+struct GraphContext {
+	IplImage *imageGraph;	// The canvas, that is reused while the graphs are the same width.
+	int countGraph;			// The number of colors used since the canvas was cleared.
+	float minValue;			// The range of the values shown, or scaled to fit the values if maxValue <= minValue.
+	float maxValue;
+};
+
+// Create a GraphContext, that draws graphs into its own canvas, with its own colors & range. Give each thread or plot its
+// own context, eg: to draw dozens of graphs in parallel with TBB. Remember to free it with releaseGraphContext().
+GraphContext* createGraphContext(float minValue, float maxValue)
+{
+	GraphContext *context = new GraphContext;
+	context->imageGraph = 0;
+	context->countGraph = 0;
+	context->minValue = minValue;
+	context->maxValue = maxValue;
+	return context;
+}
+
+// Set the range of values that the graphs of a GraphContext show, or scale them to fit the values if maxValue <= minValue.
+void setGraphContextRange(GraphContext *context, float minValue, float maxValue)
+{
+	context->minValue = minValue;
+	context->maxValue = maxValue;
+}
+
+// Draw the graph of an array into the canvas of a GraphContext, that is only reallocated when the width changes.
+// If combine is true and the canvas is the same width, the graph is drawn over the last graph in the next color,
+// otherwise the canvas is cleared and the colors start again, so each graph always looks the same.
+template<typename T>
+static const IplImage* drawGraphInto(const T *arraySrc, int nArrayLength, GraphContext *context, bool combine,
+	const char *funcName)
+{
+	if (!context || !arraySrc || nArrayLength < 0) {
+		printf("ERROR in %s()! Bad GraphContext or array of %d values.\n", funcName, nArrayLength);
+		exit(1);
+	}
+	int w = nArrayLength + GRAPH_BORDER*2;	// width of the image
+	if (!context->imageGraph || context->imageGraph->width != w) {
+		cvReleaseImage(&context->imageGraph);
+		context->imageGraph = createGraphImage(nArrayLength, 0, funcName);
+		context->countGraph = 0;
+	}
+	else if (!combine) {
+		cvSet(context->imageGraph, WHITE);
+		drawGraphAxes(context->imageGraph, nArrayLength);
+		context->countGraph = 0;
+	}
+	CvScalar colorGraph = getNextGraphColor(&context->countGraph);
+	drawGraphLine(context->imageGraph, arraySrc, nArrayLength, context->minValue, context->maxValue, colorGraph);
+	return context->imageGraph;
+}
+
+// Draw the graph of an array of floats into the canvas of a GraphContext. The image belongs to the context, so don't free it.
+const IplImage* drawFloatGraphInto(const float *arraySrc, int nArrayLength, GraphContext *context, bool combine)
+{
+	return drawGraphInto(arraySrc, nArrayLength, context, combine, "drawFloatGraphInto");
+}
+
+// Draw the graph of an array of ints into the canvas of a GraphContext. The image belongs to the context, so don't free it.
+const IplImage* drawIntGraphInto(const int *arraySrc, int nArrayLength, GraphContext *context, bool combine)
+{
+	return drawGraphInto(arraySrc, nArrayLength, context, combine, "drawIntGraphInto");
+}
+
+// Draw the graph of an array of uchars into the canvas of a GraphContext. The image belongs to the context, so don't free it.
+const IplImage* drawUCharGraphInto(const uchar *arraySrc, int nArrayLength, GraphContext *context, bool combine)
+{
+	return drawGraphInto(arraySrc, nArrayLength, context, combine, "drawUCharGraphInto");
+}
+
+// Free a GraphContext and its canvas, and set *context to NULL.
+void releaseGraphContext(GraphContext **context)
+{
+	if (context && *context) {
+		cvReleaseImage(&(*context)->imageGraph);
+		delete *context;
+		*context = 0;
+	}
+}
 
-		// Clear the image
-		cvSet(imageGraph, WHITE);
+// Get the first sample of a column of a decimated graph, where the samples are spread evenly between the columns.
+static inline int getColumnStart(int column, int nArrayLength, int nColumns)
+{
+	return (int)((int64)column * nArrayLength / nColumns);
+}
+
+// Find the min & max of the samples in each column of a decimated graph, using the SIMD kernels.
+// Long arrays are split between threads by TBB, since each column is found by itself.
+static void findColumnRanges(const float *arraySrc, int nArrayLength, int nColumns, float *columnMin, float *columnMax)
+{
+	const int PARALLEL_SAMPLES = 1 << 20;	// Fewer samples than this are quicker to do in one thread.
+	MinMaxFunc findMinMax = getRowFunc(findMinMaxFloat_C, findMinMaxFloat_SSE41, findMinMaxFloat_AVX2, findMinMaxFloat_AVX512);
+	auto findRange = [=](int c0, int c1) {
+		for (int c=c0; c<c1; c++) {
+			int i0 = getColumnStart(c, nArrayLength, nColumns);
+			int i1 = getColumnStart(c+1, nArrayLength, nColumns);
+			columnMin[c] = arraySrc[i0];
+			columnMax[c] = arraySrc[i0];
+			findMinMax(arraySrc + i0 + 1, i1 - i0 - 1, &columnMin[c], &columnMax[c]);
+		}
+	};
+	if (nArrayLength >= PARALLEL_SAMPLES) {
+		tbb::parallel_for(tbb::blocked_range<int>(0, nColumns, 16), [&](const tbb::blocked_range<int> &columns) {
+			findRange(columns.begin(), columns.end());
+		});
 	}
 	else {
-		// Create a new copy of the image, so we know we have to free an image later
-		imageGraph = cvCloneImage(imageDst);
+		findRange(0, nColumns);
 	}
-	if (!imageGraph) {
-		cerr << "ERROR in drawIntGraph(): Couldn't create image of " << w << " x " << h << endl;
+}
+
+// Pick nColumns of the samples with the Largest-Triangle-Three-Buckets algorithm (ref: "Downsampling Time Series for
+// Visual Representation" by Sveinn Steinarsson), which keeps the first & last samples, and from each column in between,
+// the sample making the biggest triangle with the sample picked before it and the average of the next column.
+static void pickSamplesLTTB(const float *arraySrc, int nArrayLength, int nColumns, int *picked)
+{
+	// The first & last columns just hold the first & last samples, and the other samples are spread between the rest.
+	const int nMiddle = nColumns - 2;
+	const int nSamples = nArrayLength - 2;
+	picked[0] = 0;
+	int a = 0;
+	for (int c=0; c<nMiddle; c++) {
+		int i0 = 1 + getColumnStart(c, nSamples, nMiddle);
+		int i1 = 1 + getColumnStart(c+1, nSamples, nMiddle);
+		int next1 = (c+1 < nMiddle) ? 1 + getColumnStart(c+2, nSamples, nMiddle) : nArrayLength;
+		double avgX = 0.0, avgY = 0.0;
+		for (int i=i1; i<next1; i++) {
+			avgX += i;
+			avgY += arraySrc[i];
+		}
+		avgX /= (next1 - i1);
+		avgY /= (next1 - i1);
+
+		double maxArea = -1.0;
+		int best = i0;
+		for (int i=i0; i<i1; i++) {
+			double area = fabs((a - avgX) * ((double)arraySrc[i] - arraySrc[a]) - (a - i) * (avgY - arraySrc[a]));
+			if (area > maxArea) {
+				maxArea = area;
+				best = i;
+			}
+		}
+		picked[c+1] = best;
+		a = best;
+	}
+	picked[nColumns-1] = nArrayLength - 1;
+}
+
+// Draw the graph of a long array of floats into imageDst or a new image that is only 'width' pixels wide (plus the border),
+// by decimating the samples within each column, so that it is quick to draw millions of samples.
+// Remember to free the newly drawn image, even if imageDst isnt given.
+IplImage* drawFloatGraphDecimated(const float *arraySrc, int nArrayLength, int width, GraphDecimation decimation,
+	IplImage *imageDst, float minValue, float maxValue)
+{
+	if (!arraySrc || nArrayLength < 1 || width < 1) {
+		printf("ERROR in drawFloatGraphDecimated()! Bad array of %d values for a width of %d.\n", nArrayLength, width);
+		exit(1);
+	}
+	// Short arrays get a column for each sample, just like drawFloatGraph().
+	int nColumns = min(width, nArrayLength);
+	if (decimation == GRAPH_DECIMATE_LTTB && nColumns < 3)
+		nColumns = min(nArrayLength, 3);	// LTTB needs a column for the first & last samples and at least 1 between.
+	int b = GRAPH_BORDER;	// border around graph within the image
+	int h = GRAPH_HEIGHT + b*2;	// height of the image
+	IplImage *imageGraph = createGraphImage(nColumns, imageDst, "drawFloatGraphDecimated");
+	CvScalar colorGraph = getGraphColor();	// use a different color each time.
+
+	// Find the range of each column, then the range of the whole graph (including 0 like the other graphs) unless it was given.
+	vector<float> columnMin(nColumns);
+	vector<float> columnMax(nColumns);
+	findColumnRanges(arraySrc, nArrayLength, nColumns, &columnMin[0], &columnMax[0]);
+	if (maxValue <= minValue) {
+		minValue = 0.0f;
+		maxValue = 0.0f;
+		findMinMaxFloat_C(&columnMin[0], nColumns, &minValue, &maxValue);
+		findMinMaxFloat_C(&columnMax[0], nColumns, &minValue, &maxValue);
+	}
+	float fscale = getGraphScale(minValue, maxValue);
+
+	if (decimation == GRAPH_DECIMATE_LTTB && nColumns < nArrayLength) {
+		// Draw a line through the picked samples, at the column of each sample.
+		vector<int> picked(nColumns);
+		pickSamplesLTTB(arraySrc, nArrayLength, nColumns, &picked[0]);
+		vector<cv::Point> points(nColumns);
+		for (int c=0; c<nColumns; c++) {
+			int i = picked[c];
+			int x = (int)((int64)i * (nColumns - 1) / (nArrayLength - 1));
+			int y = getGraphY(arraySrc[i], minValue, fscale);
+			points[c] = cv::Point(b+x, h-(b+y));
+		}
+		cv::Mat image = cv::cvarrToMat(imageGraph);
+		const cv::Point *pPoints = &points[0];
+		cv::polylines(image, &pPoints, &nColumns, 1, false, cv::Scalar(colorGraph));
+	}
+	else {
+		// Draw a vertical line over the range of each column, that also reaches the range of the previous column so
+		// that the envelope has no gaps.
+		int prevMin = 0, prevMax = 0;
+		for (int c=0; c<nColumns; c++) {
+			int yMin = getGraphY(columnMin[c], minValue, fscale);
+			int yMax = getGraphY(columnMax[c], minValue, fscale);
+			int y0 = (c > 0) ? min(yMin, prevMax) : yMin;
+			int y1 = (c > 0) ? max(yMax, prevMin) : yMax;
+			cvLine(imageGraph, cvPoint(b+c, h-(b+y0)), cvPoint(b+c, h-(b+y1)), colorGraph);
+			prevMin = yMin;
+			prevMax = yMax;
+		}
+	}
+
+	return imageGraph;
+}
+
+// Display a decimated graph of the given long float array, 'width' pixels wide.
+// If background is provided, it will be drawn into, for combining multiple graphs using drawFloatGraphDecimated().
+// Set delay_ms to 0 if you want to wait forever until a keypress, or set it to 1 if you want it to delay just 1 millisecond.
+void showFloatGraphDecimated(const char *name, const float *arraySrc, int nArrayLength, int width, GraphDecimation decimation,
+	int delay_ms, IplImage *background, float minValue, float maxValue)
+{
+	showGraphImage(name, drawFloatGraphDecimated(arraySrc, nArrayLength, width, decimation, background, minValue, maxValue),
+		delay_ms);
+}
+
+// A live graph of a stream of values. The values and the columns of the plot are both ring buffers, where value k is
+// stored (and drawn) at k % nSamples, so adding a value only redraws its own column instead of scrolling every pixel.
+struct ScrollingGraph {
+	int nSamples;			// The number of values shown, one per pixel column.
+	int height;				// The height of the plot, not counting its border.
+	float fixedMax;			// The value at the top of the plot if it has a fixed scale, otherwise 0.
+	float scaleMax;			// The value at the top of the plot.
+	CvScalar color;
+	int64 count;			// The number of values added so far.
+	int prevY;				// The height of the last value, so the next one can be joined to it.
+	vector<float> values;
+	// The values that could still become the max of the shown values, from the oldest (the current max) to the newest.
+	// Their sample numbers are stored in a ring buffer, so each value is added & removed just once.
+	vector<int64> maxQueue;
+	int maxFirst;
+	int maxSize;
+	IplImage *imagePlot;	// The plot, with the column of value k at k % nSamples.
+	IplImage *imageGraph;	// The whole graph with its axes, with the columns of the plot in order.
+	int64 countImage;		// The number of values that imageGraph shows, or -1 if it hasn't been drawn yet.
+};
+
+// Get the height in pixels of a value on the plot, clipped to the plot.
+static int getScrollingGraphY(const ScrollingGraph *graph, float value)
+{
+	if (graph->scaleMax <= 0.0f)
+		return 0;
+	float fy = value * ((float)graph->height / graph->scaleMax);
+	if (cvIsNaN(fy) || fy <= 0.0f)
+		return 0;
+	if (fy >= (float)graph->height)
+		return graph->height;
+	return (int)fy;
+}
+
+// Draw value k into its column of the plot, as a vertical line from the height of the previous value.
+static void drawScrollingGraphColumn(ScrollingGraph *graph, int64 k, int prevY, int y)
+{
+	IplImage *plot = graph->imagePlot;
+	int x = (int)(k % graph->nSamples);
+	uchar color[3] = { (uchar)graph->color.val[0], (uchar)graph->color.val[1], (uchar)graph->color.val[2] };
+	int rowTop = graph->height - max(prevY, y);
+	int rowBottom = graph->height - min(prevY, y);
+	for (int row=0; row<plot->height; row++) {
+		uchar *p = (uchar*)plot->imageData + row * plot->widthStep + x*3;
+		bool isLine = (row >= rowTop && row <= rowBottom);
+		p[0] = isLine ? color[0] : 255;
+		p[1] = isLine ? color[1] : 255;
+		p[2] = isLine ? color[2] : 255;
+	}
+}
+
+// Redraw every value shown on the plot, after its scale changed.
+static void redrawScrollingGraph(ScrollingGraph *graph)
+{
+	int64 first = max(graph->count - graph->nSamples, (int64)0);
+	int prevY = -1;
+	for (int64 k=first; k<graph->count; k++) {
+		int y = getScrollingGraphY(graph, graph->values[k % graph->nSamples]);
+		drawScrollingGraphColumn(graph, k, (prevY < 0) ? y : prevY, y);
+		prevY = y;
+	}
+	graph->prevY = prevY;
+}
+
+// Create a scrolling graph that shows the last nSamples values, one pixel apart, in a plot 'height' pixels high.
+// If maxValue is positive the plot always shows 0 to maxValue, otherwise it scales itself to fit the values shown.
+// Remember to free it with releaseScrollingGraph().
+ScrollingGraph* createScrollingGraph(int nSamples, int height, float maxValue)
+{
+	if (nSamples < 1 || height < 1) {
+		printf("ERROR in createScrollingGraph()! Bad size of %d x %d.\n", nSamples, height);
+		exit(1);
+	}
+	const int b = GRAPH_BORDER;
+	ScrollingGraph *graph = new ScrollingGraph;
+	graph->nSamples = nSamples;
+	graph->height = height;
+	graph->fixedMax = max(maxValue, 0.0f);
+	graph->scaleMax = graph->fixedMax;
+	graph->color = getGraphColor();	// use a different color for each graph.
+	graph->count = 0;
+	graph->prevY = 0;
+	graph->countImage = -1;
+	graph->values.assign(nSamples, 0.0f);
+	graph->maxQueue.assign(nSamples, 0);
+	graph->maxFirst = 0;
+	graph->maxSize = 0;
+	// The plot is 1 pixel above & right of the axes, so the axes are only drawn once.
+	graph->imagePlot = cvCreateImage(cvSize(nSamples, height + 1), 8, 3);
+	graph->imageGraph = cvCreateImage(cvSize(nSamples + 1 + b*2, height + 1 + b*2), 8, 3);
+	if (!graph->imagePlot || !graph->imageGraph) {
+		printf("ERROR in createScrollingGraph()! Couldn't allocate the graph images.\n");
+		exit(1);
+	}
+	cvSet(graph->imagePlot, WHITE);
+	cvSet(graph->imageGraph, WHITE);
+	int h = graph->imageGraph->height;
+	cvLine(graph->imageGraph, cvPoint(b,h-b), cvPoint(b+1+nSamples, h-b), BLACK);
+	cvLine(graph->imageGraph, cvPoint(b,h-b), cvPoint(b, h-(b+1+height)), BLACK);
+	return graph;
+}
+
+// Add a value to the right end of the graph, scrolling the oldest value off the left end once the graph is full.
+// Only the column of the new value is drawn, unless the plot needs a new scale to fit the values.
+void addScrollingGraphValue(ScrollingGraph *graph, float value)
+{
+	const int n = graph->nSamples;
+	int64 k = graph->count++;
+	graph->values[k % n] = value;
+
+	// Keep track of the max of the shown values. Older values that are not bigger than the new value can never be the max.
+	while (graph->maxSize > 0 && graph->values[graph->maxQueue[(graph->maxFirst + graph->maxSize - 1) % n] % n] <= value)
+		graph->maxSize--;
+	if (graph->maxSize > 0 && graph->maxQueue[graph->maxFirst] <= k - n) {
+		graph->maxFirst = (graph->maxFirst + 1) % n;
+		graph->maxSize--;
+	}
+	graph->maxQueue[(graph->maxFirst + graph->maxSize) % n] = k;
+	graph->maxSize++;
+
+	// Rescale when a value goes over the top of the plot, or the values shrink to under a quarter of it, with some
+	// headroom so that it doesn't rescale on every new peak.
+	if (graph->fixedMax <= 0.0f) {
+		float maxV = graph->values[graph->maxQueue[graph->maxFirst] % n];
+		if (maxV > graph->scaleMax || (maxV > 0.0f && maxV < graph->scaleMax * 0.25f)) {
+			graph->scaleMax = maxV * 1.25f;
+			redrawScrollingGraph(graph);
+			return;
+		}
+	}
+	int y = getScrollingGraphY(graph, value);
+	drawScrollingGraphColumn(graph, k, (k == 0) ? y : graph->prevY, y);
+	graph->prevY = y;
+	// The oldest value shown is no longer joined to the value before it, that just scrolled off.
+	if (k >= n) {
+		int yOldest = getScrollingGraphY(graph, graph->values[(k + 1) % n]);
+		drawScrollingGraphColumn(graph, k + 1 - n, yOldest, yOldest);
+	}
+}
+
+// Get the image of the graph, with its values in order from the oldest on the left to the newest on the right.
+// Each new value moves every column of the image, so this copies the whole plot, which is O(nSamples x height) per call
+// rather than O(1) like addScrollingGraphValue(). It is skipped if no values were added since the last call.
+// The image belongs to the graph and is overwritten by the next call, so don't free it.
+const IplImage* getScrollingGraphImage(ScrollingGraph *graph)
+{
+	const int b = GRAPH_BORDER;
+	IplImage *plot = graph->imagePlot;
+	IplImage *image = graph->imageGraph;
+	if (graph->countImage == graph->count)
+		return image;
+	graph->countImage = graph->count;
+	// Until the graph is full, the values start at the left, otherwise the oldest value's column comes first.
+	int first = (graph->count < graph->nSamples) ? 0 : (int)(graph->count % graph->nSamples);
+	size_t bytesFirst = (graph->nSamples - first) * 3;
+	size_t bytesSecond = first * 3;
+	for (int row=0; row<plot->height; row++) {
+		const uchar *src = (const uchar*)plot->imageData + row * plot->widthStep;
+		uchar *dst = (uchar*)image->imageData + (b + row) * image->widthStep + (b + 1) * 3;
+		memcpy(dst, src + bytesSecond, bytesFirst);
+		memcpy(dst + bytesFirst, src, bytesSecond);
+	}
+	return image;
+}
+
+// Display the graph in a window, then wait delay_ms for a keypress (0 waits forever).
+// It only waits once, so call it with a delay of 1 from a video loop.
+void showScrollingGraph(const char *name, ScrollingGraph *graph, int delay_ms)
+{
+	cvNamedWindow(name);
+	cvShowImage(name, getScrollingGraphImage(graph));
+	cvWaitKey(delay_ms);
+}
+
+// Free a ScrollingGraph, and set *graph to NULL.
+void releaseScrollingGraph(ScrollingGraph **graph)
+{
+	if (graph && *graph) {
+		cvReleaseImage(&(*graph)->imagePlot);
+		cvReleaseImage(&(*graph)->imageGraph);
+		delete *graph;
+		*graph = 0;
+	}
+}
+
+// Saves graph images on its own thread. The images wait in a FrameRingBuffer of preallocated canvases, that rotate between
+// writeGraphImage() and the writer thread, so no memory is allocated once the canvases are the size of the graphs.
+struct GraphWriter {
+	string path;
+	string pathPrefix;			// For PNG files, the filename before & after the image number, that has numberDigits digits.
+	string pathSuffix;
+	int numberDigits;
+	GraphWriterFormat format;
+	double fps;
+	FrameRingBuffer *queue;
+	int64 nQueued;				// The number of images given to writeGraphImage(), used to number the PNG files.
+	std::thread thread;
+};
+
+// Body of the writer thread: save each queued image until the GraphWriter is released and the queue is empty.
+static void writeGraphImages(GraphWriter *writer)
+{
+	// Graphs are mostly a few flat colors that compress well anyway, so the fastest PNG compression keeps up best.
+	const vector<int> PNG_PARAMS = { cv::IMWRITE_PNG_COMPRESSION, 1 };
+	cv::VideoWriter video;
+	cv::Size videoSize;
+	cv::Mat image;
+	int64 index;
+	string filename;
+	while (writer->queue->pop(image, &index)) {
+		if (writer->format == GRAPH_WRITER_PNG) {
+			// The number is put in the filename here instead of by snprintf(), so the caller's path is never a format string.
+			string number = to_string(index);
+			filename.assign(writer->pathPrefix);
+			if ((int)number.size() < writer->numberDigits)
+				filename.append(writer->numberDigits - number.size(), '0');
+			filename.append(number);
+			filename.append(writer->pathSuffix);
+			if (!cv::imwrite(filename, image, PNG_PARAMS)) {
+				printf("ERROR in GraphWriter! Couldn't write the image file '%s'.\n", filename.c_str());
+				exit(1);
+			}
+		}
+		else {
+			// The video is opened at the size of the first image, and any later images of another size are resized to it.
+			if (!video.isOpened()) {
+				videoSize = image.size();
+				if (!video.open(writer->path, cv::VideoWriter::fourcc('M','J','P','G'), writer->fps, videoSize)) {
+					printf("ERROR in GraphWriter! Couldn't create the MJPEG video '%s'.\n", writer->path.c_str());
+					exit(1);
+				}
+			}
+			if (image.size() != videoSize)
+				cv::resize(image, image, videoSize);
+			video.write(image);
+		}
+	}
+}
+
+// Split a PNG path pattern into the text before & after the image number, that must be a single %d, or %0Nd to pad it
+// with zeros to N digits. Any other % must be written as %%, that gives a single % in the filename.
+// Returns false if the pattern is bad.
+static bool splitGraphWriterPath(const char *path, string &prefix, string &suffix, int &digits)
+{
+	bool foundNumber = false;
+	prefix.clear();
+	suffix.clear();
+	digits = 0;
+	for (const char *c=path; *c; c++) {
+		string &text = foundNumber ? suffix : prefix;
+		if (*c != '%') {
+			text += *c;
+			continue;
+		}
+		c++;
+		if (*c == '%') {
+			text += '%';
+			continue;
+		}
+		if (foundNumber)
+			return false;	// A second number, or a % that isn't a number.
+		if (*c == '0') {
+			c++;
+			if (*c < '1' || *c > '9')
+				return false;
+			while (*c >= '0' && *c <= '9') {
+				digits = digits * 10 + (*c - '0');
+				if (digits > 32)
+					return false;
+				c++;
+			}
+		}
+		if (*c != 'd')
+			return false;
+		foundNumber = true;
+	}
+	return foundNumber;
+}
+
+// Create a GraphWriter that saves graph images on its own thread, so that batch jobs & worker threads can save graphs
+// without a window or waiting in cvWaitKey(). Prints an error & returns NULL if any of its arguments are bad.
+// Remember to free it with releaseGraphWriter().
+GraphWriter* createGraphWriter(const char *path, GraphWriterFormat format, double fps, int queueSize, bool dropWhenFull)
+{
+	if (!path || !path[0] || queueSize < 1 || (format != GRAPH_WRITER_PNG && format != GRAPH_WRITER_MJPEG)) {
+		fprintf(stderr, "ERROR in createGraphWriter()! Bad path, format or queue size.\n");
+		return 0;
+	}
+	string prefix, suffix;
+	int digits = 0;
+	if (format == GRAPH_WRITER_PNG && !splitGraphWriterPath(path, prefix, suffix, digits)) {
+		fprintf(stderr, "ERROR in createGraphWriter()! The PNG path '%s' needs a single %%d or %%0Nd for the image number, "
+			"with any other %% written as %%%%.\n", path);
+		return 0;
+	}
+	GraphWriter *writer = new GraphWriter;
+	writer->path = path;
+	writer->pathPrefix = prefix;
+	writer->pathSuffix = suffix;
+	writer->numberDigits = digits;
+	writer->format = format;
+	writer->fps = (fps > 0.0) ? fps : 30.0;
+	writer->queue = new FrameRingBuffer(queueSize, dropWhenFull ? FRAME_QUEUE_DROP_OLDEST : FRAME_QUEUE_BLOCK);
+	writer->nQueued = 0;
+	writer->thread = std::thread(writeGraphImages, writer);
+	return writer;
+}
+
+// Queue a copy of a graph image to be saved by the GraphWriter. It is copied into a canvas of the queue, so imageGraph can
+// be freed or drawn over straight away. If every canvas is waiting to be saved, this waits for the oldest one to be saved,
+// unless the GraphWriter drops images when it is full.
+void writeGraphImage(GraphWriter *writer, const IplImage *imageGraph)
+{
+	if (!writer || !imageGraph) {
+		printf("ERROR in writeGraphImage()! Bad GraphWriter or image.\n");
 		exit(1);
 	}
-	CvScalar colorGraph = getGraphColor();	// use a different color each time.
+	cv::Mat *canvas = writer->queue->beginWrite();
+	if (!canvas)
+		return;
+	cv::cvarrToMat(imageGraph).copyTo(*canvas);	// Only reallocates the canvas if the image has a new size.
+	writer->queue->endWrite(writer->nQueued++);
+}
+
+// Get the number of images that were dropped because the GraphWriter was full, when it was created with dropWhenFull.
+int getGraphWriterDropped(const GraphWriter *writer)
+{
+	return writer ? (int)writer->queue->framesDropped() : 0;
+}
+
+// Save the images still waiting in the queue, then free the GraphWriter and set *writer to NULL.
+void releaseGraphWriter(GraphWriter **writer)
+{
+	if (writer && *writer) {
+		(*writer)->queue->close();	// The writer thread still saves the queued images before it stops.
+		(*writer)->thread.join();
+		delete (*writer)->queue;
+		delete *writer;
+		*writer = 0;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Color conversion functions
+//------------------------------------------------------------------------------
+
+// Create a HSV image from the RGB image using the full 8-bits, since OpenCV only allows Hues up to 180 instead of 255.
+// ref: "http://cs.haifa.ac.il/hagit/courses/ist/Lectures/Demos/ColorApplet2/t_convert.html"
+// This is the scalar row kernel, also used for the last few pixels of each row by the SIMD kernels.
+void convertRowRGBtoHSV_C(const uchar *src, uchar *dst, int width)
+{
+	float fR, fG, fB;
+	float fH, fS, fV;
+	const float FLOAT_TO_BYTE = 255.0f;
+	const float BYTE_TO_FLOAT = 1.0f / FLOAT_TO_BYTE;
+
+	for (int x=0; x<width; x++) {
+		// Get the RGB pixel components. NOTE that OpenCV stores RGB pixels in B,G,R order.
+		const uchar *pRGB = src + x*3;
+		int bB = *(pRGB+0);	// Blue component
+		int bG = *(pRGB+1);	// Green component
+		int bR = *(pRGB+2);	// Red component
+
+		// Convert from 8-bit integers to floats
+		fR = bR * BYTE_TO_FLOAT;
+		fG = bG * BYTE_TO_FLOAT;
+		fB = bB * BYTE_TO_FLOAT;
+
+		// Convert from RGB to HSV, using float ranges 0.0 to 1.0
+		float fDelta;
+		float fMin, fMax;
+		int iMax;
+		// Get the min & max, but use integer comparisons for slight speedup
+		if (bB < bG) {
+			if (bB < bR) {
+				fMin = fB;
+				if (bR > bG) {
+					iMax = bR;
+					fMax = fR;
+				}
+				else {
+					iMax = bG;
+					fMax = fG;
+				}
+			}
+			else {
+				fMin = fR;
+				fMax = fG;
+				iMax = bG;
+			}
+		}
+		else {
+			if (bG < bR) {
+				fMin = fG;
+				if (bB > bR) {
+					fMax = fB;
+					iMax = bB;
+				}
+				else {
+					fMax = fR;
+					iMax = bR;
+				}
+			}
+			else {
+				fMin = fR;
+				fMax = fB;
+				iMax = bB;
+			}
+		}
+		fDelta = fMax - fMin;
+		fV = fMax;					// Value (Brightness).
+		if (iMax != 0) {			// Make sure its not pure black.
+			fS = fDelta / fMax;		// Saturation.
+			float ANGLE_TO_UNIT = 1.0f / (6.0f * fDelta);	// Make the Hues between 0.0 to 1.0 instead of 6.0
+			if (iMax == bR) {		// between yellow & magenta.
+				fH = (fG - fB) * ANGLE_TO_UNIT;
+			}
+			else if (iMax == bG) {	// between cyan & yellow.
+				fH = (2.0f/6.0f) + ( fB - fR ) * ANGLE_TO_UNIT;
+			}
+			else {					// between magenta & cyan.
+				fH = (4.0f/6.0f) + ( fR - fG ) * ANGLE_TO_UNIT;
+			}
+			// Wrap outlier Hues around the circle.
+			if (fH < 0.0f)
+				fH += 1.0f;
+			if (fH >= 1.0f)
+				fH -= 1.0f;
+		}
+		else {
+			// color is pure Black.
+			fS = 0;
+			fH = 0;	// undefined hue
+		}
+
+		// Convert from floats to 8-bit integers
+		int bH = (int)(0.5f + fH * 255.0f);
+		int bS = (int)(0.5f + fS * 255.0f);
+		int bV = (int)(0.5f + fV * 255.0f);
+
+		// Clip the values to make sure it fits within the 8bits
+		//if (bH > 255 || bH < 0 || bS > 255 || bS < 0 || bV > 255 || bV < 0) {
+		//	cout << "Warning: HSV pixel(" << x << "," << y << ") is being clipped. " << bH << "," << bS << "," << bV << endl;
+		//}
+		if (bH > 255)
+			bH = 255;
+		if (bH < 0)
+			bH = 0;
+		if (bS > 255)
+			bS = 255;
+		if (bS < 0)
+			bS = 0;
+		if (bV > 255)
+			bV = 255;
+		if (bV < 0)
+			bV = 0;
+
+		// Set the HSV pixel components
+		uchar *pHSV = dst + x*3;
+		*(pHSV+0) = bH;		// H component
+		*(pHSV+1) = bS;		// S component
+		*(pHSV+2) = bV;		// V component
+	}
+}
+
+// Convert each row of an 8-bit 3-channel image into another one, by calling convertRow on each row.
+// If grainRows is positive, the rows are split into blocks of at least grainRows rows that TBB converts in parallel.
+// Each row is converted by itself, so the result is identical to converting the rows one after another.
+// convertRow is a ColorRowFunc, or anything else that can be called like one.
+template<typename ROW_FUNC>
+static void convertRows(const uchar *imSrc, size_t rowSizeSrc, uchar *imDst, size_t rowSizeDst, int w, int h,
+	ROW_FUNC convertRow, int grainRows)
+{
+	if (grainRows > 0) {
+		tbb::parallel_for(tbb::blocked_range<int>(0, h, grainRows), [=](const tbb::blocked_range<int> &rows) {
+			for (int y=rows.begin(); y<rows.end(); y++) {
+				convertRow(imSrc + y*rowSizeSrc, imDst + y*rowSizeDst, w);
+			}
+		});
+	}
+	else {
+		for (int y=0; y<h; y++) {
+			convertRow(imSrc + y*rowSizeSrc, imDst + y*rowSizeDst, w);
+		}
+	}
+}
+
+// Create a new 8-bit 3-channel image with the same size as imageSrc, and fill it by calling convertRow on each row.
+template<typename ROW_FUNC>
+static IplImage* convertImageRows(const IplImage *imageSrc, ROW_FUNC convertRow, int grainRows, const char *funcName)
+{
+	// Create a blank image
+	IplImage *imageDst = cvCreateImage(cvGetSize(imageSrc), 8, 3);
+	if (!imageDst || imageSrc->depth != 8 || imageSrc->nChannels != 3) {
+		printf("ERROR in %s()! Bad input image.\n", funcName);
+		exit(1);
+	}
+	convertRows((const uchar*)imageSrc->imageData, imageSrc->widthStep, (uchar*)imageDst->imageData, imageDst->widthStep,
+		imageSrc->width, imageSrc->height, convertRow, grainRows);
+	return imageDst;
+}
+
+// Make sure *image is an image of the given size, depth & channels, reusing it if it already is, otherwise (re)allocating it.
+static IplImage* reuseImage(IplImage **image, CvSize size, int depth, int nChannels, const char *funcName)
+{
+	IplImage *img = *image;
+	if (!img || img->width != size.width || img->height != size.height || img->depth != depth || img->nChannels != nChannels) {
+		if (img)
+			cvReleaseImage(image);
+		img = *image = cvCreateImage(size, depth, nChannels);
+		if (!img) {
+			printf("ERROR in %s()! Couldn't allocate the output image.\n", funcName);
+			exit(1);
+		}
+	}
+	return img;
+}
+
+// Fill *imageDst by calling convertRow on each row of imageSrc. *imageDst is only (re)allocated if it is NULL or
+// doesn't have the same size as imageSrc, so calling this on every frame of a video doesn't allocate anything.
+template<typename ROW_FUNC>
+static void convertImageRowsInto(const IplImage *imageSrc, IplImage **imageDst, ROW_FUNC convertRow, int grainRows,
+	const char *funcName)
+{
+	if (!imageDst || imageSrc->depth != 8 || imageSrc->nChannels != 3) {
+		printf("ERROR in %s()! Bad input image.\n", funcName);
+		exit(1);
+	}
+	IplImage *dst = reuseImage(imageDst, cvGetSize(imageSrc), 8, 3, funcName);
+	convertRows((const uchar*)imageSrc->imageData, imageSrc->widthStep, (uchar*)dst->imageData, dst->widthStep,
+		imageSrc->width, imageSrc->height, convertRow, grainRows);
+}
+
+// Same as convertImageRowsInto() but for cv::Mat, where Mat::create() only reallocates if the size or type changed.
+template<typename ROW_FUNC>
+static void convertMatRowsInto(const cv::Mat &imageSrc, cv::Mat &imageDst, ROW_FUNC convertRow, int grainRows,
+	const char *funcName)
+{
+	if (imageSrc.type() != CV_8UC3) {
+		printf("ERROR in %s()! Bad input image.\n", funcName);
+		exit(1);
+	}
+	imageDst.create(imageSrc.size(), CV_8UC3);
+	convertRows(imageSrc.data, imageSrc.step, imageDst.data, imageDst.step, imageSrc.cols, imageSrc.rows, convertRow, grainRows);
+}
+
+// Convert each row of an image into up to 3 separate planes, where any of imDst can be NULL.
+// If grainRows is positive, blocks of at least grainRows rows are converted in parallel using TBB.
+// convertRow is a PlanarRowFunc, or anything else that can be called like one.
+template<typename ROW_FUNC>
+static void convertPlanarRows(const uchar *imSrc, size_t rowSizeSrc, uchar *const imDst[3], const size_t rowSizeDst[3],
+	int w, int h, ROW_FUNC convertRow, int grainRows)
+{
+	uchar *im0 = imDst[0], *im1 = imDst[1], *im2 = imDst[2];
+	size_t rowSize0 = rowSizeDst[0], rowSize1 = rowSizeDst[1], rowSize2 = rowSizeDst[2];
+	auto convertRange = [=](int y0, int y1) {
+		for (int y=y0; y<y1; y++) {
+			convertRow(imSrc + y*rowSizeSrc, im0 ? im0 + y*rowSize0 : 0, im1 ? im1 + y*rowSize1 : 0,
+				im2 ? im2 + y*rowSize2 : 0, w);
+		}
+	};
+	if (grainRows > 0) {
+		tbb::parallel_for(tbb::blocked_range<int>(0, h, grainRows), [&](const tbb::blocked_range<int> &rows) {
+			convertRange(rows.begin(), rows.end());
+		});
+	}
+	else {
+		convertRange(0, h);
+	}
+}
+
+// Convert the 3-channel imageSrc into the planes that aren't NULL, that have the same depth as imageSrc and are only
+// (re)allocated when they are NULL or the wrong size.
+template<typename ROW_FUNC>
+static void convertImagePlanarRows(const IplImage *imageSrc, IplImage **plane0, IplImage **plane1, IplImage **plane2,
+	ROW_FUNC convertRow, int grainRows, const char *funcName)
+{
+	if (imageSrc->nChannels != 3) {
+		printf("ERROR in %s()! Bad input image.\n", funcName);
+		exit(1);
+	}
+	IplImage **planes[3] = {plane0, plane1, plane2};
+	uchar *imDst[3];
+	size_t rowSizeDst[3];
+	for (int c=0; c<3; c++) {
+		imDst[c] = 0;
+		rowSizeDst[c] = 0;
+		if (planes[c]) {
+			IplImage *plane = reuseImage(planes[c], cvGetSize(imageSrc), imageSrc->depth, 1, funcName);
+			imDst[c] = (uchar*)plane->imageData;
+			rowSizeDst[c] = plane->widthStep;
+		}
+	}
+	convertPlanarRows((const uchar*)imageSrc->imageData, imageSrc->widthStep, imDst, rowSizeDst, imageSrc->width,
+		imageSrc->height, convertRow, grainRows);
+}
+
+// Same math as convertRowRGBtoHSV_C(), but for float pixels, keeping H, S & V as floats from 0.0 to 1.0.
+// This is the scalar row kernel of 16-bit & float images, also used for the last few pixels of each row by the SIMD kernels.
+// Like all the float kernels, it reads each pixel before writing it, so src & dst can be the same buffer.
+void convertRowRGBtoHSVFloat_C(const float *src, float *dst, int width)
+{
+	for (int x=0; x<width; x++) {
+		float fB = src[x*3+0];
+		float fG = src[x*3+1];
+		float fR = src[x*3+2];
+
+		float fMax = max(max(fR, fG), fB);
+		float fMin = min(min(fR, fG), fB);
+		float fH = 0;	// undefined hue for black & grey
+		float fS = 0;
+		if (fMax > 0) {			// Make sure its not pure black.
+			float fDelta = fMax - fMin;
+			fS = fDelta / fMax;		// Saturation.
+			if (fDelta > 0) {
+				float ANGLE_TO_UNIT = 1.0f / (6.0f * fDelta);	// Make the Hues between 0.0 to 1.0 instead of 6.0
+				if (fMax == fR)			// between yellow & magenta.
+					fH = (fG - fB) * ANGLE_TO_UNIT;
+				else if (fMax == fG)	// between cyan & yellow.
+					fH = (2.0f/6.0f) + ( fB - fR ) * ANGLE_TO_UNIT;
+				else					// between magenta & cyan.
+					fH = (4.0f/6.0f) + ( fR - fG ) * ANGLE_TO_UNIT;
+				// Wrap outlier Hues around the circle.
+				if (fH < 0.0f)
+					fH += 1.0f;
+				if (fH >= 1.0f)
+					fH -= 1.0f;
+			}
+		}
+		dst[x*3+0] = fH;
+		dst[x*3+1] = fS;
+		dst[x*3+2] = fMax;
+	}
+}
+
+// Convert float H, S & V from 0.0 to 1.0 to float B,G,R, where Hues outside 0 to 1 wrap around the color circle.
+// This is the scalar row kernel of 16-bit & float images, also used for the last few pixels of each row by the SIMD kernels.
+void convertRowHSVtoRGBFloat_C(const float *src, float *dst, int width)
+{
+	for (int x=0; x<width; x++) {
+		float fH = src[x*3+0];
+		float fS = src[x*3+1];
+		float fV = src[x*3+2];
+
+		// Split the Hue into its sector of the color wheel (0 to 5) and the fraction within that sector.
+		float fH6 = (fH - floorf(fH)) * 6.0f;
+		float fI = floorf(fH6);
+		float fF = fH6 - fI;
+		float p = fV * (1.0f - fS);
+		float q = fV * (1.0f - fS * fF);
+		float t = fV * (1.0f - fS * (1.0f - fF));
+
+		float fR, fG, fB;
+		switch( (int)fI ) {
+			case 1:
+				fR = q;
+				fG = fV;
+				fB = p;
+				break;
+			case 2:
+				fR = p;
+				fG = fV;
+				fB = t;
+				break;
+			case 3:
+				fR = p;
+				fG = q;
+				fB = fV;
+				break;
+			case 4:
+				fR = t;
+				fG = p;
+				fB = fV;
+				break;
+			case 5:
+				fR = fV;
+				fG = p;
+				fB = q;
+				break;
+			default:		// case 0, or 6 when rounding pushes the Hue up to 1.0:
+				fR = fV;
+				fG = t;
+				fB = p;
+				break;
+		}
+		dst[x*3+0] = fB;
+		dst[x*3+1] = fG;
+		dst[x*3+2] = fR;
+	}
+}
+
+// Multiply each float pixel by the 3x3 matrix m, adding the terms in a fixed order so that the SIMD kernels give the same results.
+static void convertRowFloatMatrix_C(const float *src, float *dst, int width, const float m[3][3])
+{
+	for (int x=0; x<width; x++) {
+		float c0 = src[x*3+0];
+		float c1 = src[x*3+1];
+		float c2 = src[x*3+2];
+		for (int k=0; k<3; k++)
+			dst[x*3+k] = (m[k][0] * c0 + m[k][1] * c1) + m[k][2] * c2;
+	}
+}
+
+// Convert float B,G,R to float Y, I & Q, where Y is 0 to 1, I is -0.5957 to +0.5957 and Q is -0.5226 to +0.5226.
+// This is the scalar row kernel of 16-bit & float images, also used for the last few pixels of each row by the SIMD kernels.
+void convertRowRGBtoYIQFloat_C(const float *src, float *dst, int width)
+{
+	convertRowFloatMatrix_C(src, dst, width, RGB_TO_YIQ_FLOAT);
+}
+
+// Convert float Y, I & Q to float B,G,R. The scalar row kernel of 16-bit & float images.
+void convertRowYIQtoRGBFloat_C(const float *src, float *dst, int width)
+{
+	convertRowFloatMatrix_C(src, dst, width, YIQ_TO_RGB_FLOAT);
+}
+
+// Get a float conversion, using the fastest float kernels for this CPU.
+static imageutils::FloatConversion getRGBtoHSVFloat(void)
+{
+	imageutils::FloatConversion conversion = { getRowFunc(convertRowRGBtoHSVFloat_C, convertRowRGBtoHSVFloat_SSE41,
+		convertRowRGBtoHSVFloat_AVX2, convertRowRGBtoHSVFloat_AVX512), imageutils::RANGES_RGB, imageutils::RANGES_HSV };
+	return conversion;
+}
+
+static imageutils::FloatConversion getHSVtoRGBFloat(void)
+{
+	imageutils::FloatConversion conversion = { getRowFunc(convertRowHSVtoRGBFloat_C, convertRowHSVtoRGBFloat_SSE41,
+		convertRowHSVtoRGBFloat_AVX2, convertRowHSVtoRGBFloat_AVX512), imageutils::RANGES_HSV, imageutils::RANGES_RGB };
+	return conversion;
+}
+
+static imageutils::FloatConversion getRGBtoYIQFloat(void)
+{
+	imageutils::FloatConversion conversion = { getRowFunc(convertRowRGBtoYIQFloat_C, convertRowRGBtoYIQFloat_SSE41,
+		convertRowRGBtoYIQFloat_AVX2, convertRowRGBtoYIQFloat_AVX512), imageutils::RANGES_RGB, imageutils::RANGES_YIQ };
+	return conversion;
+}
+
+static imageutils::FloatConversion getYIQtoRGBFloat(void)
+{
+	imageutils::FloatConversion conversion = { getRowFunc(convertRowYIQtoRGBFloat_C, convertRowYIQtoRGBFloat_SSE41,
+		convertRowYIQtoRGBFloat_AVX2, convertRowYIQtoRGBFloat_AVX512), imageutils::RANGES_YIQ, imageutils::RANGES_RGB };
+	return conversion;
+}
+
+// A templated any-depth row kernel together with its float conversion, that can be called just like a PlanarRowFunc.
+struct AnyDepthRow {
+	imageutils::AnyDepthRowFunc convertRow;
+	imageutils::FloatConversion conversion;
+	void operator()(const uchar *src, uchar *dst0, uchar *dst1, uchar *dst2, int width) const
+	{
+		convertRow(src, dst0, dst1, dst2, width, &conversion);
+	}
+};
+
+// Get the row kernel converting imageSrc in the given channel order into the OpenCV depth dstDepth with the float
+// conversion, or exit if either depth isn't 8-bit, 16-bit or float, or imageSrc has the wrong number of channels.
+template<int LAYOUT>
+static AnyDepthRow getAnyDepthRow(const imageutils::FloatConversion &conversion, const cv::Mat &imageSrc,
+	imageutils::ChannelOrder order, int dstDepth, const char *funcName)
+{
+	int channels = (order == imageutils::ORDER_BGRA || order == imageutils::ORDER_RGBA) ? 4 : 3;
+	AnyDepthRow row;
+	row.convertRow = imageutils::getAnyDepthRowFunc<LAYOUT>(imageSrc.depth(), order, dstDepth);
+	row.conversion = conversion;
+	if (!row.convertRow || imageSrc.channels() != channels) {
+		printf("ERROR in %s()! Bad input image. Only 8-bit, 16-bit & float images are supported.\n", funcName);
+		exit(1);
+	}
+	return row;
+}
+
+// Convert the 3-channel imageSrc into imageDst, that must already have the same size & 3 channels, with the float conversion.
+static void convertMatAnyDepthRows(const cv::Mat &imageSrc, cv::Mat &imageDst, const imageutils::FloatConversion &conversion,
+	int grainRows, const char *funcName)
+{
+	AnyDepthRow convertRow = getAnyDepthRow<imageutils::LAYOUT_INTERLEAVED>(conversion, imageSrc, imageutils::ORDER_BGR,
+		imageDst.depth(), funcName);
+	uchar *imDst[3] = {imageDst.data, 0, 0};
+	size_t rowSizeDst[3] = {imageDst.step, 0, 0};
+	convertPlanarRows(imageSrc.data, imageSrc.step, imDst, rowSizeDst, imageSrc.cols, imageSrc.rows, convertRow, grainRows);
+}
+
+// Same as convertImageRowsInto(), but 16-bit & float images are converted with the float conversion into *imageDst
+// of the same depth, while 8-bit images still use the 8-bit kernel convertRow.
+template<typename ROW_FUNC>
+static void convertImageRowsAnyDepthInto(const IplImage *imageSrc, IplImage **imageDst, ROW_FUNC convertRow,
+	const imageutils::FloatConversion &conversion, int grainRows, const char *funcName)
+{
+	if (imageSrc && imageDst && imageSrc->depth != 8) {
+		cv::Mat dst = cv::cvarrToMat(reuseImage(imageDst, cvGetSize(imageSrc), imageSrc->depth, 3, funcName));
+		convertMatAnyDepthRows(cv::cvarrToMat(imageSrc), dst, conversion, grainRows, funcName);
+		return;
+	}
+	convertImageRowsInto(imageSrc, imageDst, convertRow, grainRows, funcName);
+}
+
+// Same as convertImageRows(), but 16-bit & float images give a new image of the same depth, using the float conversion.
+template<typename ROW_FUNC>
+static IplImage* convertImageRowsAnyDepth(const IplImage *imageSrc, ROW_FUNC convertRow,
+	const imageutils::FloatConversion &conversion, int grainRows, const char *funcName)
+{
+	if (imageSrc && imageSrc->depth != 8) {
+		IplImage *imageDst = 0;
+		convertImageRowsAnyDepthInto(imageSrc, &imageDst, convertRow, conversion, grainRows, funcName);
+		return imageDst;
+	}
+	return convertImageRows(imageSrc, convertRow, grainRows, funcName);
+}
+
+// Same as convertMatRowsInto(), but 16-bit & float images are converted with the float conversion into imageDst
+// of the same depth, while 8-bit images still use the 8-bit kernel convertRow.
+template<typename ROW_FUNC>
+static void convertMatRowsAnyDepthInto(const cv::Mat &imageSrc, cv::Mat &imageDst, ROW_FUNC convertRow,
+	const imageutils::FloatConversion &conversion, int grainRows, const char *funcName)
+{
+	if (imageSrc.depth() != CV_8U) {
+		imageDst.create(imageSrc.size(), CV_MAKETYPE(imageSrc.depth(), 3));
+		convertMatAnyDepthRows(imageSrc, imageDst, conversion, grainRows, funcName);
+		return;
+	}
+	convertMatRowsInto(imageSrc, imageDst, convertRow, grainRows, funcName);
+}
+
+// Convert the 3-channel imageSrc into the planes that aren't NULL, using the 8-bit kernel convertRow for 8-bit images,
+// or the float conversion for 16-bit & float images, giving planes of the same depth.
+static void convertImagePlanarRowsAnyDepth(const IplImage *imageSrc, IplImage **plane0, IplImage **plane1, IplImage **plane2,
+	PlanarRowFunc convertRow, const imageutils::FloatConversion &conversion, int grainRows, const char *funcName)
+{
+	if (imageSrc->depth != 8) {
+		cv::Mat src = cv::cvarrToMat(imageSrc);
+		AnyDepthRow convertRowAnyDepth = getAnyDepthRow<imageutils::LAYOUT_PLANAR>(conversion, src, imageutils::ORDER_BGR,
+			src.depth(), funcName);
+		convertImagePlanarRows(imageSrc, plane0, plane1, plane2, convertRowAnyDepth, grainRows, funcName);
+		return;
+	}
+	convertImagePlanarRows(imageSrc, plane0, plane1, plane2, convertRow, grainRows, funcName);
+}
+
+// Create a HSV image from the RGB image using the full 8-bits, since OpenCV only allows Hues up to 180 instead of 255.
+// ref: "http://cs.haifa.ac.il/hagit/courses/ist/Lectures/Demos/ColorApplet2/t_convert.html"
+// Remember to free the generated HSV image.
+IplImage* convertImageRGBtoHSV(const IplImage *imageRGB)
+{
+	ColorRowFunc convertRow = getRowFunc(convertRowRGBtoHSV_C, convertRowRGBtoHSV_SSE41, convertRowRGBtoHSV_AVX2, convertRowRGBtoHSV_AVX512);
+	return convertImageRowsAnyDepth(imageRGB, convertRow, getRGBtoHSVFloat(), 0, "convertImageRGBtoHSV");
+}
+
+// Same as convertImageRGBtoHSV(), but converts blocks of at least grainRows rows in parallel using TBB.
+// Remember to free the generated HSV image.
+IplImage* convertImageRGBtoHSVParallel(const IplImage *imageRGB, int grainRows)
+{
+	ColorRowFunc convertRow = getRowFunc(convertRowRGBtoHSV_C, convertRowRGBtoHSV_SSE41, convertRowRGBtoHSV_AVX2, convertRowRGBtoHSV_AVX512);
+	return convertImageRowsAnyDepth(imageRGB, convertRow, getRGBtoHSVFloat(), grainRows, "convertImageRGBtoHSVParallel");
+}
+
+// Same as convertImageRGBtoHSV(), but writes into *imageHSV, that is only (re)allocated when it is NULL or the wrong size.
+// If grainRows is positive, blocks of at least grainRows rows are converted in parallel using TBB.
+void convertImageRGBtoHSVInto(const IplImage *imageRGB, IplImage **imageHSV, int grainRows)
+{
+	ColorRowFunc convertRow = getRowFunc(convertRowRGBtoHSV_C, convertRowRGBtoHSV_SSE41, convertRowRGBtoHSV_AVX2, convertRowRGBtoHSV_AVX512);
+	convertImageRowsAnyDepthInto(imageRGB, imageHSV, convertRow, getRGBtoHSVFloat(), grainRows, "convertImageRGBtoHSVInto");
+}
+
+// Same as convertImageRGBtoHSVInto(), but for a cv::Mat, that is only reallocated when it has the wrong size or type.
+void convertImageRGBtoHSVInto(const cv::Mat &imageRGB, cv::Mat &imageHSV, int grainRows)
+{
+	ColorRowFunc convertRow = getRowFunc(convertRowRGBtoHSV_C, convertRowRGBtoHSV_SSE41, convertRowRGBtoHSV_AVX2, convertRowRGBtoHSV_AVX512);
+	convertMatRowsAnyDepthInto(imageRGB, imageHSV, convertRow, getRGBtoHSVFloat(), grainRows, "convertImageRGBtoHSVInto");
+}
+
+// Convert rows y0 to y1 of a BGR image to HSV, then threshold them into mask and count them into histogram (if not NULL).
+// Each row is converted a block at a time into a small HSV buffer that stays in the cache, so the image is only read once.
+static void convertRowsRGBtoHSVMask(const uchar *imSrc, size_t rowSizeSrc, uchar *imMask, size_t rowSizeMask, int w,
+	int y0, int y1, const RangeHSV &range, HistogramHSV *histogram)
+{
+	const int BLOCK = 256;		// Pixels per block. Keep it a multiple of 16 for the SIMD kernels.
+	uchar hsv[BLOCK*3];
+
+	// Use lookup tables for the ranges, so that a Hue range that wraps around through red is just as fast.
+	uchar inH[256], inS[256], inV[256];
+	for (int i=0; i<256; i++) {
+		if (range.minHue <= range.maxHue)
+			inH[i] = (i >= range.minHue && i <= range.maxHue) ? 255 : 0;
+		else
+			inH[i] = (i >= range.minHue || i <= range.maxHue) ? 255 : 0;
+		inS[i] = (i >= range.minSat && i <= range.maxSat) ? 255 : 0;
+		inV[i] = (i >= range.minVal && i <= range.maxVal) ? 255 : 0;
+	}
+
+	ColorRowFunc convertRow = getRowFunc(convertRowRGBtoHSV_C, convertRowRGBtoHSV_SSE41, convertRowRGBtoHSV_AVX2, convertRowRGBtoHSV_AVX512);
+	for (int y=y0; y<y1; y++) {
+		const uchar *pRGB = imSrc + y*rowSizeSrc;
+		uchar *pMask = imMask + y*rowSizeMask;
+		for (int x0=0; x0<w; x0+=BLOCK) {
+			int n = min(BLOCK, w - x0);
+			convertRow(pRGB + x0*3, hsv, n);
+			for (int i=0; i<n; i++) {
+				int bH = hsv[i*3+0];
+				int bS = hsv[i*3+1];
+				int bV = hsv[i*3+2];
+				pMask[x0+i] = inH[bH] & inS[bS] & inV[bV];
+			}
+			if (histogram) {
+				for (int i=0; i<n; i++) {
+					histogram->hue[hsv[i*3+0]]++;
+					histogram->sat[hsv[i*3+1]]++;
+					histogram->val[hsv[i*3+2]]++;
+				}
+			}
+		}
+	}
+}
+
+// Threshold a BGR image by a range of HSV values, and count its H, S & V histograms, in a single pass over the image.
+// If grainRows is positive, blocks of rows are done in parallel using TBB, each with its own histogram that are added up at the end.
+static void convertImageRowsRGBtoHSVMask(const uchar *imSrc, size_t rowSizeSrc, uchar *imMask, size_t rowSizeMask,
+	int w, int h, const RangeHSV &range, HistogramHSV *histogram, int grainRows)
+{
+	if (histogram)
+		memset(histogram, 0, sizeof(*histogram));
+
+	if (grainRows <= 0) {
+		convertRowsRGBtoHSVMask(imSrc, rowSizeSrc, imMask, rowSizeMask, w, 0, h, range, histogram);
+	}
+	else if (!histogram) {
+		tbb::parallel_for(tbb::blocked_range<int>(0, h, grainRows), [&](const tbb::blocked_range<int> &rows) {
+			convertRowsRGBtoHSVMask(imSrc, rowSizeSrc, imMask, rowSizeMask, w, rows.begin(), rows.end(), range, 0);
+		});
+	}
+	else {
+		HistogramHSV empty;
+		memset(&empty, 0, sizeof(empty));
+		*histogram = tbb::parallel_reduce(tbb::blocked_range<int>(0, h, grainRows), empty,
+			[&](const tbb::blocked_range<int> &rows, HistogramHSV partial) {
+				convertRowsRGBtoHSVMask(imSrc, rowSizeSrc, imMask, rowSizeMask, w, rows.begin(), rows.end(), range, &partial);
+				return partial;
+			},
+			[](HistogramHSV a, const HistogramHSV &b) {
+				for (int i=0; i<256; i++) {
+					a.hue[i] += b.hue[i];
+					a.sat[i] += b.sat[i];
+					a.val[i] += b.val[i];
+				}
+				return a;
+			});
+	}
+}
+
+// Convert the BGR image to HSV (like convertImageRGBtoHSV()) and threshold it by the given range in a single pass,
+// without creating the HSV image. *imageMask is only (re)allocated when it is NULL or the wrong size.
+void convertImageRGBtoHSVMask(const IplImage *imageRGB, const RangeHSV *range, IplImage **imageMask,
+	HistogramHSV *histogram, int grainRows)
+{
+	if (!imageMask || !range || imageRGB->depth != 8 || imageRGB->nChannels != 3) {
+		printf("ERROR in convertImageRGBtoHSVMask()! Bad input image.\n");
+		exit(1);
+	}
+	IplImage *mask = reuseImage(imageMask, cvGetSize(imageRGB), 8, 1, "convertImageRGBtoHSVMask");
+	convertImageRowsRGBtoHSVMask((const uchar*)imageRGB->imageData, imageRGB->widthStep, (uchar*)mask->imageData,
+		mask->widthStep, imageRGB->width, imageRGB->height, *range, histogram, grainRows);
+}
+
+// Convert a row of BGR pixels to separate H, S & V planes, where any of the planes can be NULL to skip it.
+// Converts a block of pixels at a time with the normal row kernel into a buffer that stays in the cache, then splits it.
+void convertRowRGBtoHSVPlanar(const uchar *src, uchar *dstH, uchar *dstS, uchar *dstV, int width)
+{
+	// The Value is just the max of B,G,R (the float code gives exactly the same), so skip the rest if it's all we need.
+	if (!dstH && !dstS) {
+		if (dstV) {
+			for (int x=0; x<width; x++)
+				dstV[x] = max(max(src[x*3+0], src[x*3+1]), src[x*3+2]);
+		}
+		return;
+	}
+
+	ColorRowFunc convertRow = getRowFunc(convertRowRGBtoHSV_C, convertRowRGBtoHSV_SSE41, convertRowRGBtoHSV_AVX2, convertRowRGBtoHSV_AVX512);
+	const int BLOCK = 256;		// Pixels per block. Keep it a multiple of 16 for the SIMD kernels.
+	uchar hsv[BLOCK*3];
+	for (int x0=0; x0<width; x0+=BLOCK) {
+		int n = min(BLOCK, width - x0);
+		convertRow(src + x0*3, hsv, n);
+		if (dstH) {
+			for (int i=0; i<n; i++)
+				dstH[x0+i] = hsv[i*3+0];
+		}
+		if (dstS) {
+			for (int i=0; i<n; i++)
+				dstS[x0+i] = hsv[i*3+1];
+		}
+		if (dstV) {
+			for (int i=0; i<n; i++)
+				dstV[x0+i] = hsv[i*3+2];
+		}
+	}
+}
+
+// Same as convertImageRGBtoHSV(), but writes separate 8-bit H, S & V planes instead of an interleaved image.
+// Pass NULL for the planes you don't need. The planes are only (re)allocated when they are NULL or the wrong size.
+void convertImageRGBtoHSVPlanes(const IplImage *imageRGB, IplImage **imageH, IplImage **imageS, IplImage **imageV,
+	int grainRows)
+{
+	convertImagePlanarRowsAnyDepth(imageRGB, imageH, imageS, imageV, convertRowRGBtoHSVPlanar, getRGBtoHSVFloat(), grainRows,
+		"convertImageRGBtoHSVPlanes");
+}
+
+// Lookup tables to split an 8-bit Hue into its sector of the color wheel (0 to 5) and the
+// fraction within that sector (0 to 254, in 255ths of a sector). A Hue of 255 wraps around to 0.
+struct HueTables {
+	uchar sector[256];
+	uchar fraction[256];
+	HueTables()
+	{
+		for (int h=0; h<256; h++) {
+			int h6 = (h % 255) * 6;
+			sector[h] = h6 / 255;
+			fraction[h] = h6 % 255;
+		}
+	}
+};
+static const HueTables hueTables;
+
+// Create an RGB image from the HSV image using the full 8-bits, since OpenCV only allows Hues up to 180 instead of 255.
+// ref: "http://cs.haifa.ac.il/hagit/courses/ist/Lectures/Demos/ColorApplet2/t_convert.html"
+// This is the scalar row kernel, using fixed-point integer math instead of floats. Each component is rounded
+// down exactly, so the SIMD kernels (that compute the Hue tables on the fly) give exactly the same results.
+void convertRowHSVtoRGB_C(const uchar *src, uchar *dst, int width)
+{
+	for (int x=0; x<width; x++) {
+		// Get the HSV pixel components
+		const uchar *pHSV = src + x*3;
+		int bH = *(pHSV+0);	// H component
+		int bS = *(pHSV+1);	// S component
+		int bV = *(pHSV+2);	// V component
+
+		// Convert from HSV to RGB, where p, q & t are scaled by 255 like V. Pure grey (S == 0) gives p = q = t = V.
+		int iI = hueTables.sector[bH];		// sector 0 to 5
+		int iF = hueTables.fraction[bH];	// fraction of the sector, in 255ths
+		int p = bV * (255 - bS) / 255;
+		int q = bV * (255*255 - bS * iF) / (255*255);
+		int t = bV * (255*255 - bS * (255 - iF)) / (255*255);
+
+		int bR, bG, bB;
+		switch( iI ) {
+			case 0:
+				bR = bV;
+				bG = t;
+				bB = p;
+				break;
+			case 1:
+				bR = q;
+				bG = bV;
+				bB = p;
+				break;
+			case 2:
+				bR = p;
+				bG = bV;
+				bB = t;
+				break;
+			case 3:
+				bR = p;
+				bG = q;
+				bB = bV;
+				break;
+			case 4:
+				bR = t;
+				bG = p;
+				bB = bV;
+				break;
+			default:		// case 5:
+				bR = bV;
+				bG = p;
+				bB = q;
+				break;
+		}
+
+		// Set the RGB pixel components. NOTE that OpenCV stores RGB pixels in B,G,R order.
+		uchar *pRGB = dst + x*3;
+		*(pRGB+0) = bB;		// B component
+		*(pRGB+1) = bG;		// G component
+		*(pRGB+2) = bR;		// R component
+	}
+}
+
+// Create an RGB image from the HSV image using the full 8-bits, since OpenCV only allows Hues up to 180 instead of 255.
+// ref: "http://cs.haifa.ac.il/hagit/courses/ist/Lectures/Demos/ColorApplet2/t_convert.html"
+// Remember to free the generated RGB image.
+IplImage* convertImageHSVtoRGB(const IplImage *imageHSV)
+{
+	ColorRowFunc convertRow = getRowFunc(convertRowHSVtoRGB_C, convertRowHSVtoRGB_SSE41, convertRowHSVtoRGB_AVX2, convertRowHSVtoRGB_AVX512);
+	return convertImageRowsAnyDepth(imageHSV, convertRow, getHSVtoRGBFloat(), 0, "convertImageHSVtoRGB");
+}
+
+// Same as convertImageHSVtoRGB(), but converts blocks of at least grainRows rows in parallel using TBB.
+// Remember to free the generated RGB image.
+IplImage* convertImageHSVtoRGBParallel(const IplImage *imageHSV, int grainRows)
+{
+	ColorRowFunc convertRow = getRowFunc(convertRowHSVtoRGB_C, convertRowHSVtoRGB_SSE41, convertRowHSVtoRGB_AVX2, convertRowHSVtoRGB_AVX512);
+	return convertImageRowsAnyDepth(imageHSV, convertRow, getHSVtoRGBFloat(), grainRows, "convertImageHSVtoRGBParallel");
+}
+
+// Same as convertImageHSVtoRGB(), but writes into *imageRGB, that is only (re)allocated when it is NULL or the wrong size.
+// If grainRows is positive, blocks of at least grainRows rows are converted in parallel using TBB.
+void convertImageHSVtoRGBInto(const IplImage *imageHSV, IplImage **imageRGB, int grainRows)
+{
+	ColorRowFunc convertRow = getRowFunc(convertRowHSVtoRGB_C, convertRowHSVtoRGB_SSE41, convertRowHSVtoRGB_AVX2, convertRowHSVtoRGB_AVX512);
+	convertImageRowsAnyDepthInto(imageHSV, imageRGB, convertRow, getHSVtoRGBFloat(), grainRows, "convertImageHSVtoRGBInto");
+}
+
+// Same as convertImageHSVtoRGBInto(), but for a cv::Mat, that is only reallocated when it has the wrong size or type.
+void convertImageHSVtoRGBInto(const cv::Mat &imageHSV, cv::Mat &imageRGB, int grainRows)
+{
+	ColorRowFunc convertRow = getRowFunc(convertRowHSVtoRGB_C, convertRowHSVtoRGB_SSE41, convertRowHSVtoRGB_AVX2, convertRowHSVtoRGB_AVX512);
+	convertMatRowsAnyDepthInto(imageHSV, imageRGB, convertRow, getHSVtoRGBFloat(), grainRows, "convertImageHSVtoRGBInto");
+}
+
+// Scalar row kernel of the color matrix, using 16-bit fixed point just like the SIMD kernels.
+void convertRowColorMatrix_C(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs)
+{
+	for (int x=0; x<width; x++) {
+		const uchar *pSrc = src + x*3;
+		int b0 = pSrc[0];
+		int b1 = pSrc[1];
+		int b2 = pSrc[2];
+		uchar *pDst = dst + x*3;
+		for (int c=0; c<3; c++) {
+			const short *m = coeffs->fixedM[c];
+			int v = (m[0] * b0 + m[1] * b1 + m[2] * b2 + coeffs->fixedOffset[c]) >> coeffs->shift;
+			pDst[c] = min(max(v, 0), 255);
+		}
+	}
+}
+
+// Scalar row kernel of the color matrix, using floats. Adds the terms in the same order as the SIMD kernels.
+void convertRowColorMatrixFloat_C(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs)
+{
+	for (int x=0; x<width; x++) {
+		const uchar *pSrc = src + x*3;
+		float f0 = pSrc[0];
+		float f1 = pSrc[1];
+		float f2 = pSrc[2];
+		uchar *pDst = dst + x*3;
+		for (int c=0; c<3; c++)
+			pDst[c] = applyColorMatrixFloat(coeffs, c, f0, f1, f2);
+	}
+}
+
+// Prepare a color matrix for the row kernels.
+// Returns false if its coefficients are too big to be accurate in the fixed-point kernels.
+static bool prepareColorMatrix(const ColorMatrix *matrix, ColorMatrixCoeffs *coeffs)
+{
+	float maxM = 0.0f;
+	float maxOffset = 0.0f;
+	for (int i=0; i<3; i++) {
+		for (int j=0; j<3; j++) {
+			coeffs->floatM[i][j] = matrix->m[i][j];
+			maxM = max(maxM, fabsf(matrix->m[i][j]));
+		}
+		coeffs->floatOffset[i] = matrix->offset[i] + 0.5f;
+		maxOffset = max(maxOffset, fabsf(matrix->offset[i]));
+	}
+
+	// Use as many fraction bits as fit in 16-bit coefficients, up to 14. With less than 12,
+	// the rounding errors of the 3 coefficients could add up to more than 1.
+	int shift = 14;
+	while (shift > 0 && maxM * (1 << shift) > 32767.0f)
+		shift--;
+	if (shift < 12 || maxOffset > 32767.0f)
+		return false;
+	coeffs->shift = shift;
+	for (int i=0; i<3; i++) {
+		for (int j=0; j<3; j++) {
+			coeffs->fixedM[i][j] = (short)cvRound(matrix->m[i][j] * (1 << shift));
+		}
+		coeffs->fixedOffset[i] = cvRound(matrix->offset[i] * (1 << shift)) + (1 << (shift - 1));
+	}
+	return true;
+}
+
+// A color matrix row kernel together with its prepared matrix, that can be called just like a ColorRowFunc.
+struct ColorMatrixRow {
+	MatrixRowFunc convertRow;
+	ColorMatrixCoeffs coeffs;
+	void operator()(const uchar *src, uchar *dst, int width) const
+	{
+		convertRow(src, dst, width, &coeffs);
+	}
+};
+
+// Get the fastest row kernel for the color matrix, using the float kernels if useFloat is set or the matrix is too big for fixed point.
+static ColorMatrixRow getColorMatrixRow(const ColorMatrix *matrix, bool useFloat)
+{
+	ColorMatrixRow row;
+	bool fixedPoint = prepareColorMatrix(matrix, &row.coeffs);
+	if (fixedPoint && !useFloat)
+		row.convertRow = getRowFunc(convertRowColorMatrix_C, convertRowColorMatrix_SSE41, convertRowColorMatrix_AVX2, convertRowColorMatrix_AVX512);
+	else
+		row.convertRow = getRowFunc(convertRowColorMatrixFloat_C, convertRowColorMatrixFloat_SSE41, convertRowColorMatrixFloat_AVX2, convertRowColorMatrixFloat_AVX512);
+	return row;
+}
+
+// Make a color matrix that takes B,G,R pixels, given each output component as a mix of R,G,B (between 0 and 1),
+// and the scale & offset that turn each component into a byte.
+static ColorMatrix makeMatrixFromRGB(const double mixRGB[3][3], const double scale[3], const double offset[3])
+{
+	ColorMatrix matrix;
+	for (int i=0; i<3; i++) {
+		// NOTE that OpenCV stores RGB pixels in B,G,R order.
+		matrix.m[i][0] = (float)(mixRGB[i][2] * scale[i] / 255.0);
+		matrix.m[i][1] = (float)(mixRGB[i][1] * scale[i] / 255.0);
+		matrix.m[i][2] = (float)(mixRGB[i][0] * scale[i] / 255.0);
+		matrix.offset[i] = (float)offset[i];
+	}
+	return matrix;
+}
+
+// Make a color matrix from RGB to a luma & 2 color differences, given the weights of red & blue in the luma.
+// The color differences are (B - Y) * diffScaleB and (R - Y) * diffScaleR.
+static ColorMatrix makeLumaChromaMatrix(double kr, double kb, double diffScaleB, double diffScaleR, const double scale[3],
+	const double offset[3])
+{
+	double kg = 1.0 - kr - kb;
+	const double mixRGB[3][3] = {
+		{ kr, kg, kb },
+		{ -kr * diffScaleB, -kg * diffScaleB, (1.0 - kb) * diffScaleB },
+		{ (1.0 - kr) * diffScaleR, -kg * diffScaleR, -kb * diffScaleR }
+	};
+	return makeMatrixFromRGB(mixRGB, scale, offset);
+}
+
+// Make a studio range YCbCr color matrix, given the weights of red & blue in the luma.
+static ColorMatrix makeYCbCrMatrix(double kr, double kb)
+{
+	const double scale[3] = { 219.0, 224.0, 224.0 };
+	const double offset[3] = { 16.0, 128.0, 128.0 };
+	return makeLumaChromaMatrix(kr, kb, 0.5 / (1.0 - kb), 0.5 / (1.0 - kr), scale, offset);
+}
+
+// Make the PAL YUV color matrix, where U & V are scaled so that their whole range fits in a byte.
+static ColorMatrix makeYUVMatrix()
+{
+	const double KR = 0.299, KB = 0.114;
+	const double U_SCALE = 0.492111, V_SCALE = 0.877283;
+	const double MAX_U = U_SCALE * (1.0 - KB);	// about 0.436
+	const double MAX_V = V_SCALE * (1.0 - KR);	// about 0.615
+	const double scale[3] = { 255.0, 127.5 / MAX_U, 127.5 / MAX_V };
+	const double offset[3] = { 0.0, 127.5, 127.5 };
+	return makeLumaChromaMatrix(KR, KB, U_SCALE, V_SCALE, scale, offset);
+}
+
+// Make the YIQ color matrix, with the same coefficients that convertImageRGBtoYIQ() always had.
+// Y is 0-1, I is -0.5957 to +0.5957, Q is -0.5226 to +0.5226, before they are scaled into bytes.
+static ColorMatrix makeRGBtoYIQMatrix()
+{
+	const double MIN_I = -0.5957;
+	const double MIN_Q = -0.5226;
+	const double mixRGB[3][3] = {
+		{    0.299,    0.587,    0.114 },
+		{ 0.595716, -0.274453, -0.321263 },
+		{ 0.211456, -0.522591,  0.311135 }
+	};
+	const double scale[3] = { 255.0, 255.0 / (MIN_I * -2.0), 255.0 / (MIN_Q * -2.0) };
+	const double offset[3] = { 0.0, 127.5, 127.5 };
+	return makeMatrixFromRGB(mixRGB, scale, offset);
+}
+
+// Make the matrix from YIQ back to B,G,R, with the same coefficients that convertImageYIQtoRGB() always had.
+// It rounded the result down instead of to the nearest integer, so the offset includes -0.5 to keep doing that.
+static ColorMatrix makeYIQtoRGBMatrix()
+{
+	const double MIN_I = -0.5957;
+	const double MIN_Q = -0.5226;
+	// The mix of Y, I & Q in R, G & B, where R,G,B are 0-1.
+	const double mixYIQ[3][3] = {
+		{ 1.0,  0.9563,  0.6210 },
+		{ 1.0, -0.2721, -0.6474 },
+		{ 1.0, -1.1070,  1.7046 }
+	};
+	ColorMatrix matrix;
+	for (int i=0; i<3; i++) {
+		const double *mix = mixYIQ[2 - i];	// B,G,R order.
+		matrix.m[i][0] = (float)mix[0];
+		matrix.m[i][1] = (float)(mix[1] * MIN_I * -2.0);
+		matrix.m[i][2] = (float)(mix[2] * MIN_Q * -2.0);
+		matrix.offset[i] = (float)(255.0 * (mix[1] * MIN_I + mix[2] * MIN_Q) - 0.5);
+	}
+	return matrix;
+}
+
+// Get one of the standard color matrices, such as RGB to YCbCr, for convertImageColorMatrix().
+ColorMatrix getColorMatrix(ColorMatrixType type)
+{
+	switch (type) {
+		case COLOR_MATRIX_RGB_TO_YIQ:
+			return makeRGBtoYIQMatrix();
+		case COLOR_MATRIX_YIQ_TO_RGB:
+			return makeYIQtoRGBMatrix();
+		case COLOR_MATRIX_RGB_TO_YCBCR601:
+		case COLOR_MATRIX_YCBCR601_TO_RGB: {
+			ColorMatrix matrix = makeYCbCrMatrix(0.299, 0.114);
+			return (type == COLOR_MATRIX_RGB_TO_YCBCR601) ? matrix : invertColorMatrix(&matrix);
+		}
+		case COLOR_MATRIX_RGB_TO_YCBCR709:
+		case COLOR_MATRIX_YCBCR709_TO_RGB: {
+			ColorMatrix matrix = makeYCbCrMatrix(0.2126, 0.0722);
+			return (type == COLOR_MATRIX_RGB_TO_YCBCR709) ? matrix : invertColorMatrix(&matrix);
+		}
+		case COLOR_MATRIX_RGB_TO_YUV:
+		case COLOR_MATRIX_YUV_TO_RGB: {
+			ColorMatrix matrix = makeYUVMatrix();
+			return (type == COLOR_MATRIX_RGB_TO_YUV) ? matrix : invertColorMatrix(&matrix);
+		}
+	}
+	printf("ERROR in getColorMatrix()! Unknown color matrix type %d.\n", (int)type);
+	exit(1);
+}
+
+// Get the color matrix that undoes the given one, eg: to convert back to RGB with your own matrix.
+ColorMatrix invertColorMatrix(const ColorMatrix *matrix)
+{
+	const float (*m)[3] = matrix->m;
+	double det = m[0][0] * ((double)m[1][1] * m[2][2] - (double)m[1][2] * m[2][1])
+		- m[0][1] * ((double)m[1][0] * m[2][2] - (double)m[1][2] * m[2][0])
+		+ m[0][2] * ((double)m[1][0] * m[2][1] - (double)m[1][1] * m[2][0]);
+	if (fabs(det) < 1e-12) {
+		printf("ERROR in invertColorMatrix()! The color matrix can't be inverted.\n");
+		exit(1);
+	}
+	// The inverse is the transposed matrix of cofactors, divided by the determinant.
+	double inv[3][3];
+	for (int i=0; i<3; i++) {
+		for (int j=0; j<3; j++) {
+			int i1 = (i+1) % 3, i2 = (i+2) % 3;
+			int j1 = (j+1) % 3, j2 = (j+2) % 3;
+			inv[j][i] = ((double)m[i1][j1] * m[i2][j2] - (double)m[i1][j2] * m[i2][j1]) / det;
+		}
+	}
+	ColorMatrix result;
+	for (int i=0; i<3; i++) {
+		double offset = 0.0;
+		for (int j=0; j<3; j++) {
+			result.m[i][j] = (float)inv[i][j];
+			offset -= inv[i][j] * matrix->offset[j];
+		}
+		result.offset[i] = (float)offset;
+	}
+	return result;
+}
+
+// Create a new 8-bit image by transforming each pixel of the 8-bit 3-channel image with a color matrix.
+// Remember to free the generated image.
+IplImage* convertImageColorMatrix(const IplImage *imageSrc, const ColorMatrix *matrix, bool useFloat)
+{
+	return convertImageRows(imageSrc, getColorMatrixRow(matrix, useFloat), 0, "convertImageColorMatrix");
+}
+
+// Same as convertImageColorMatrix(), but writes into *imageDst, that is only (re)allocated when it is NULL or the wrong size.
+// If grainRows is positive, blocks of at least grainRows rows are converted in parallel using TBB.
+void convertImageColorMatrixInto(const IplImage *imageSrc, IplImage **imageDst, const ColorMatrix *matrix, bool useFloat,
+	int grainRows)
+{
+	convertImageRowsInto(imageSrc, imageDst, getColorMatrixRow(matrix, useFloat), grainRows, "convertImageColorMatrixInto");
+}
+
+// Same as convertImageColorMatrixInto(), but for a cv::Mat, that is only reallocated when it has the wrong size or type.
+void convertImageColorMatrixInto(const cv::Mat &imageSrc, cv::Mat &imageDst, const ColorMatrix *matrix, bool useFloat,
+	int grainRows)
+{
+	convertMatRowsInto(imageSrc, imageDst, getColorMatrixRow(matrix, useFloat), grainRows, "convertImageColorMatrixInto");
+}
+
+// Get the row kernel of a YIQ conversion. It uses the float kernels, that are closer to the original YIQ code than
+// fixed point, although a few colors still round differently by 1.
+static ColorMatrixRow getYIQRow(ColorMatrixType type)
+{
+	ColorMatrix matrix = getColorMatrix(type);
+	return getColorMatrixRow(&matrix, true);
+}
+
+// Get the prepared matrix of COLOR_MATRIX_RGB_TO_YIQ, for the 8-bit YIQ kernels that don't go through getYIQRow().
+// It is only prepared once, on the first call.
+const ColorMatrixCoeffs* getRGBtoYIQCoeffs(void)
+{
+	static const ColorMatrixRow row = getYIQRow(COLOR_MATRIX_RGB_TO_YIQ);
+	return &row.coeffs;
+}
+
+// Create a YIQ image from the RGB image using an approximation of NTSC conversion(ref: "YIQ" Wikipedia page).
+// Remember to free the generated YIQ image.
+IplImage* convertImageRGBtoYIQ(const IplImage *imageRGB)
+{
+	return convertImageRowsAnyDepth(imageRGB, getYIQRow(COLOR_MATRIX_RGB_TO_YIQ), getRGBtoYIQFloat(), 0, "convertImageRGBtoYIQ");
+}
+
+// Same as convertImageRGBtoYIQ(), but converts blocks of at least grainRows rows in parallel using TBB.
+// Remember to free the generated YIQ image.
+IplImage* convertImageRGBtoYIQParallel(const IplImage *imageRGB, int grainRows)
+{
+	return convertImageRowsAnyDepth(imageRGB, getYIQRow(COLOR_MATRIX_RGB_TO_YIQ), getRGBtoYIQFloat(), grainRows,
+		"convertImageRGBtoYIQParallel");
+}
+
+// Same as convertImageRGBtoYIQ(), but writes into *imageYIQ, that is only (re)allocated when it is NULL or the wrong size.
+// If grainRows is positive, blocks of at least grainRows rows are converted in parallel using TBB.
+void convertImageRGBtoYIQInto(const IplImage *imageRGB, IplImage **imageYIQ, int grainRows)
+{
+	convertImageRowsAnyDepthInto(imageRGB, imageYIQ, getYIQRow(COLOR_MATRIX_RGB_TO_YIQ), getRGBtoYIQFloat(), grainRows,
+		"convertImageRGBtoYIQInto");
+}
+
+// Same as convertImageRGBtoYIQInto(), but for a cv::Mat, that is only reallocated when it has the wrong size or type.
+void convertImageRGBtoYIQInto(const cv::Mat &imageRGB, cv::Mat &imageYIQ, int grainRows)
+{
+	convertMatRowsAnyDepthInto(imageRGB, imageYIQ, getYIQRow(COLOR_MATRIX_RGB_TO_YIQ), getRGBtoYIQFloat(), grainRows,
+		"convertImageRGBtoYIQInto");
+}
+
+// Convert a row of BGR pixels to separate Y, I & Q planes, where any of the planes can be NULL to skip it.
+// Uses the same float color matrix as the interleaved YIQ conversion, with each plane in its own loop so that unused planes
+// cost nothing.
+void convertRowRGBtoYIQPlanar_C(const uchar *src, uchar *dstY, uchar *dstI, uchar *dstQ, int width)
+{
+	const ColorMatrixCoeffs *coeffs = getRGBtoYIQCoeffs();
+	uchar *planes[3] = { dstY, dstI, dstQ };
+	for (int c=0; c<3; c++) {
+		uchar *dst = planes[c];
+		if (!dst)
+			continue;
+		for (int x=0; x<width; x++) {
+			// NOTE that OpenCV stores RGB pixels in B,G,R order, that is also the order of the matrix.
+			dst[x] = applyColorMatrixFloat(coeffs, c, src[x*3+0], src[x*3+1], src[x*3+2]);
+		}
+	}
+}
+
+// Same as convertImageRGBtoYIQ(), but writes separate 8-bit Y, I & Q planes instead of an interleaved image.
+// Pass NULL for the planes you don't need, eg: just imageY for a fast greyscale image.
+// The planes are only (re)allocated when they are NULL or the wrong size.
+void convertImageRGBtoYIQPlanes(const IplImage *imageRGB, IplImage **imageY, IplImage **imageI, IplImage **imageQ,
+	int grainRows)
+{
+	convertImagePlanarRowsAnyDepth(imageRGB, imageY, imageI, imageQ, convertRowRGBtoYIQPlanar_C, getRGBtoYIQFloat(), grainRows,
+		"convertImageRGBtoYIQPlanes");
+}
+
+// Create an RGB image from the YIQ image using an approximation of NTSC conversion(ref: "YIQ" Wikipedia page).
+// Remember to free the generated RGB image.
+IplImage* convertImageYIQtoRGB(const IplImage *imageYIQ)
+{
+	return convertImageRowsAnyDepth(imageYIQ, getYIQRow(COLOR_MATRIX_YIQ_TO_RGB), getYIQtoRGBFloat(), 0, "convertImageYIQtoRGB");
+}
+
+// Same as convertImageYIQtoRGB(), but converts blocks of at least grainRows rows in parallel using TBB.
+// Remember to free the generated RGB image.
+IplImage* convertImageYIQtoRGBParallel(const IplImage *imageYIQ, int grainRows)
+{
+	return convertImageRowsAnyDepth(imageYIQ, getYIQRow(COLOR_MATRIX_YIQ_TO_RGB), getYIQtoRGBFloat(), grainRows,
+		"convertImageYIQtoRGBParallel");
+}
+
+// Same as convertImageYIQtoRGB(), but writes into *imageRGB, that is only (re)allocated when it is NULL or the wrong size.
+// If grainRows is positive, blocks of at least grainRows rows are converted in parallel using TBB.
+void convertImageYIQtoRGBInto(const IplImage *imageYIQ, IplImage **imageRGB, int grainRows)
+{
+	convertImageRowsAnyDepthInto(imageYIQ, imageRGB, getYIQRow(COLOR_MATRIX_YIQ_TO_RGB), getYIQtoRGBFloat(), grainRows,
+		"convertImageYIQtoRGBInto");
+}
+
+// Same as convertImageYIQtoRGBInto(), but for a cv::Mat, that is only reallocated when it has the wrong size or type.
+void convertImageYIQtoRGBInto(const cv::Mat &imageYIQ, cv::Mat &imageRGB, int grainRows)
+{
+	convertMatRowsAnyDepthInto(imageYIQ, imageRGB, getYIQRow(COLOR_MATRIX_YIQ_TO_RGB), getYIQtoRGBFloat(), grainRows,
+		"convertImageYIQtoRGBInto");
+}
+
+// Interpolate between the channel values a & b, where f is the position between them from 0 to 256.
+static inline int lerpLUT(int a, int b, int f)
+{
+	return (a * (256 - f) + b * f + 128) >> 8;
+}
+
+// Scalar row kernel of a 3D lookup table, with trilinear interpolation between the 8 corners of each grid cell.
+void convertRowColorLUTTrilinear_C(const uchar *src, uchar *dst, int width, const ColorLUT *lut)
+{
+	const int s0 = lut->size * lut->size;
+	const int s1 = lut->size;
+	for (int x=0; x<width; x++) {
+		const uchar *pSrc = src + x*3;
+		int cell0 = lut->cell[0][pSrc[0]];
+		int cell1 = lut->cell[1][pSrc[1]];
+		int cell2 = lut->cell[2][pSrc[2]];
+		int f0 = cell0 >> COLOR_LUT_FRACTION_SHIFT;
+		int f1 = cell1 >> COLOR_LUT_FRACTION_SHIFT;
+		int f2 = cell2 >> COLOR_LUT_FRACTION_SHIFT;
+		const unsigned int *p = lut->table + (cell0 & COLOR_LUT_OFFSET_MASK) + (cell1 & COLOR_LUT_OFFSET_MASK)
+			+ (cell2 & COLOR_LUT_OFFSET_MASK);
+
+		uchar *pDst = dst + x*3;
+		for (int k=0; k<3; k++) {
+			int shift = k * 8;
+			// Interpolate along channel 2, then channel 1, then channel 0.
+			int v00 = lerpLUT((p[0] >> shift) & 255, (p[1] >> shift) & 255, f2);
+			int v01 = lerpLUT((p[s1] >> shift) & 255, (p[s1+1] >> shift) & 255, f2);
+			int v10 = lerpLUT((p[s0] >> shift) & 255, (p[s0+1] >> shift) & 255, f2);
+			int v11 = lerpLUT((p[s0+s1] >> shift) & 255, (p[s0+s1+1] >> shift) & 255, f2);
+			pDst[k] = lerpLUT(lerpLUT(v00, v01, f1), lerpLUT(v10, v11, f1), f0);
+		}
+	}
+}
+
+// Scalar row kernel of a 3D lookup table, with tetrahedral interpolation between 4 corners of each grid cell.
+// This is faster than trilinear and keeps the grey axis sharper, since greys only use corners on the diagonal of the cell.
+void convertRowColorLUTTetrahedral_C(const uchar *src, uchar *dst, int width, const ColorLUT *lut)
+{
+	const int s[3] = { lut->size * lut->size, lut->size, 1 };
+	const int sAll = s[0] + s[1] + s[2];
+	for (int x=0; x<width; x++) {
+		const uchar *pSrc = src + x*3;
+		int cell0 = lut->cell[0][pSrc[0]];
+		int cell1 = lut->cell[1][pSrc[1]];
+		int cell2 = lut->cell[2][pSrc[2]];
+		int f0 = cell0 >> COLOR_LUT_FRACTION_SHIFT;
+		int f1 = cell1 >> COLOR_LUT_FRACTION_SHIFT;
+		int f2 = cell2 >> COLOR_LUT_FRACTION_SHIFT;
+		const unsigned int *p = lut->table + (cell0 & COLOR_LUT_OFFSET_MASK) + (cell1 & COLOR_LUT_OFFSET_MASK)
+			+ (cell2 & COLOR_LUT_OFFSET_MASK);
+
+		// Sort the positions within the cell to find which of its 6 tetrahedrons the pixel is in. They go from the
+		// first corner along the channel with the biggest position, then the middle one, then the last one.
+		int fMax = max(max(f0, f1), f2);
+		int fMin = min(min(f0, f1), f2);
+		int fMid = f0 + f1 + f2 - fMax - fMin;
+		int sMax = (f0 == fMax) ? s[0] : (f1 == fMax) ? s[1] : s[2];
+		int sMin = (f0 == fMin) ? s[0] : (f1 == fMin) ? s[1] : s[2];
+		unsigned int v0 = p[0];
+		unsigned int v1 = p[sMax];
+		unsigned int v2 = p[sAll - sMin];
+		unsigned int v3 = p[sAll];
+		int w0 = 256 - fMax;
+		int w1 = fMax - fMid;
+		int w2 = fMid - fMin;
+		int w3 = fMin;
+
+		uchar *pDst = dst + x*3;
+		for (int k=0; k<3; k++) {
+			int shift = k * 8;
+			pDst[k] = (w0 * ((v0 >> shift) & 255) + w1 * ((v1 >> shift) & 255) + w2 * ((v2 >> shift) & 255)
+				+ w3 * ((v3 >> shift) & 255) + 128) >> 8;
+		}
+	}
+}
+
+// Get the 8-bit value of grid point i of a ColorLUT. The grid points are spread evenly between 0 and 255.
+static int getColorLUTGridValue(int i, int size)
+{
+	return (i * 255 + (size - 1) / 2) / (size - 1);
+}
+
+// Create an 8-bit 3-channel image containing every grid point of a size^3 ColorLUT, to bake a color transform into a LUT.
+// Convert the image with any functions that work on each pixel by itself, such as convertImageRGBtoHSV(), then pass the
+// result to createColorLUTFromLattice(). The image is 'size' pixels wide and size*size pixels high.
+IplImage* createColorLUTLattice(int size)
+{
+	if (size < 2 || size > COLOR_LUT_MAX_SIZE) {
+		printf("ERROR in createColorLUTLattice()! The size must be between 2 and %d.\n", COLOR_LUT_MAX_SIZE);
+		exit(1);
+	}
+	IplImage *imageLattice = cvCreateImage(cvSize(size, size*size), 8, 3);
+	for (int i0=0; i0<size; i0++) {
+		for (int i1=0; i1<size; i1++) {
+			uchar *row = (uchar*)imageLattice->imageData + (i0*size + i1) * imageLattice->widthStep;
+			for (int i2=0; i2<size; i2++) {
+				row[i2*3+0] = getColorLUTGridValue(i0, size);
+				row[i2*3+1] = getColorLUTGridValue(i1, size);
+				row[i2*3+2] = getColorLUTGridValue(i2, size);
+			}
+		}
+	}
+	return imageLattice;
+}
+
+// Create a ColorLUT from the converted image of createColorLUTLattice(). Remember to free it with releaseColorLUT().
+ColorLUT* createColorLUTFromLattice(const IplImage *imageLattice)
+{
+	int size = imageLattice ? imageLattice->width : 0;
+	if (size < 2 || size > COLOR_LUT_MAX_SIZE || imageLattice->height != size*size || imageLattice->depth != 8
+			|| imageLattice->nChannels != 3) {
+		printf("ERROR in createColorLUTFromLattice()! Bad lattice image.\n");
+		exit(1);
+	}
+	ColorLUT *lut = new ColorLUT;
+	lut->size = size;
+	lut->table = new unsigned int[size*size*size];
+	for (int y=0; y<size*size; y++) {
+		const uchar *row = (const uchar*)imageLattice->imageData + y * imageLattice->widthStep;
+		for (int x=0; x<size; x++) {
+			lut->table[y*size + x] = row[x*3+0] | (row[x*3+1] << 8) | (row[x*3+2] << 16);
+		}
+	}
+
+	// Find the grid cell of each 8-bit value, and its position in the cell. 255 is at the end of the last cell.
+	const int strides[3] = { size*size, size, 1 };
+	for (int c=0; c<3; c++) {
+		int i = 0;
+		for (int v=0; v<256; v++) {
+			while (i < size-2 && getColorLUTGridValue(i+1, size) <= v)
+				i++;
+			int g0 = getColorLUTGridValue(i, size);
+			int g1 = getColorLUTGridValue(i+1, size);
+			int fraction = ((v - g0) * 256 + (g1 - g0) / 2) / (g1 - g0);
+			lut->cell[c][v] = (i * strides[c]) | (fraction << COLOR_LUT_FRACTION_SHIFT);
+		}
+	}
+	return lut;
+}
+
+// Create a ColorLUT by calling func on every grid point of a size^3 lattice, one row of 'size' pixels at a time.
+// Remember to free it with releaseColorLUT().
+ColorLUT* createColorLUT(int size, ColorLUTFunc func, void *userData)
+{
+	IplImage *imageLattice = createColorLUTLattice(size);
+	IplImage *imageConverted = cvCreateImage(cvGetSize(imageLattice), 8, 3);
+	for (int y=0; y<imageLattice->height; y++) {
+		func((const uchar*)imageLattice->imageData + y * imageLattice->widthStep,
+			(uchar*)imageConverted->imageData + y * imageConverted->widthStep, size, userData);
+	}
+	ColorLUT *lut = createColorLUTFromLattice(imageConverted);
+	cvReleaseImage(&imageConverted);
+	cvReleaseImage(&imageLattice);
+	return lut;
+}
 
-	// Draw the horizontal & vertical axis
-	cvLine(imageGraph, cvPoint(b,h-b), cvPoint(b+nArrayLength, h-b), BLACK);
-	cvLine(imageGraph, cvPoint(b,h-b), cvPoint(b, h-(b+s)), BLACK);
+// Free a ColorLUT, and set *lut to NULL.
+void releaseColorLUT(ColorLUT **lut)
+{
+	if (lut && *lut) {
+		delete[] (*lut)->table;
+		delete *lut;
+		*lut = 0;
+	}
+}
 
-	// Find the max value of the data, so we can draw it at full scale
-	float maxV = 0.0;
-	for (int i=0; i<nArrayLength; i++) {
-		float v = (float)arraySrc[i];
-		if (v > maxV)
-			maxV = v;
+// A lookup table row kernel together with its table, that can be called just like a ColorRowFunc.
+struct ColorLUTRow {
+	LUTRowFunc convertRow;
+	const ColorLUT *lut;
+	void operator()(const uchar *src, uchar *dst, int width) const
+	{
+		convertRow(src, dst, width, lut);
 	}
+};
 
-	// Draw the values
-	CvPoint ptPrev = cvPoint(b,h-b);	// Start the lines at the 1st point.
-	if (maxV == 0)
-		maxV = 0.00000001f;	// Stop a divide-by-zero error
-	float fscale = (float)s / maxV;
-	for (int i=0; i<nArrayLength; i++) {
-		int y = (int)((float)arraySrc[i] * fscale);	// Get the values at a bigger scale
-		CvPoint ptNew = cvPoint(b+i,h-(b+y));
-		cvLine(imageGraph, ptPrev, ptNew, colorGraph);	// Draw a line from the previous point to the new point
-		ptPrev = ptNew;
+// Get the fastest row kernel for the lookup table & interpolation.
+static ColorLUTRow getColorLUTRow(const ColorLUT *lut, ColorLUTInterpolation interpolation, const char *funcName)
+{
+	if (!lut) {
+		printf("ERROR in %s()! The ColorLUT is NULL.\n", funcName);
+		exit(1);
 	}
+	ColorLUTRow row;
+	row.lut = lut;
+	if (interpolation == COLOR_LUT_TRILINEAR)
+		row.convertRow = getRowFunc(convertRowColorLUTTrilinear_C, convertRowColorLUTTrilinear_C, convertRowColorLUTTrilinear_AVX2, convertRowColorLUTTrilinear_AVX512);
+	else
+		row.convertRow = getRowFunc(convertRowColorLUTTetrahedral_C, convertRowColorLUTTetrahedral_C, convertRowColorLUTTetrahedral_AVX2, convertRowColorLUTTetrahedral_AVX512);
+	return row;
+}
 
-	return imageGraph;
+// Create a new 8-bit 3-channel image by interpolating each pixel of the 8-bit 3-channel image in a ColorLUT.
+// Remember to free the generated image.
+IplImage* convertImageColorLUT(const IplImage *imageSrc, const ColorLUT *lut, ColorLUTInterpolation interpolation)
+{
+	ColorLUTRow convertRow = getColorLUTRow(lut, interpolation, "convertImageColorLUT");
+	return convertImageRows(imageSrc, convertRow, 0, "convertImageColorLUT");
 }
 
-// Draw the graph of an array of uchars into imageDst or a new image.
-// Remember to free the newly drawn image, even if imageDst isnt given.
-IplImage* drawUCharGraph(const uchar *arraySrc, int nArrayLength, IplImage *imageDst)
+// Same as convertImageColorLUT(), but writes into *imageDst, that is only (re)allocated when it is NULL or the wrong size.
+// If grainRows is positive, blocks of at least grainRows rows are converted in parallel using TBB.
+void convertImageColorLUTInto(const IplImage *imageSrc, IplImage **imageDst, const ColorLUT *lut,
+	ColorLUTInterpolation interpolation, int grainRows)
 {
-	int s = 200;	// size of graph height
-	int b = 10;		// border around graph within the image
-	int w = nArrayLength + b*2;	// width of the image
-	int h = s + b*2;		// height of the image
-	IplImage *imageGraph;	// output image
+	ColorLUTRow convertRow = getColorLUTRow(lut, interpolation, "convertImageColorLUTInto");
+	convertImageRowsInto(imageSrc, imageDst, convertRow, grainRows, "convertImageColorLUTInto");
+}
 
-	// Get the desired image to draw into.
-	if (!imageDst) {
-		// Create an RGB image for graphing the data
-		imageGraph = cvCreateImage(cvSize(w,h), 8, 3);
+// Same as convertImageColorLUTInto(), but for a cv::Mat, that is only reallocated when it has the wrong size or type.
+void convertImageColorLUTInto(const cv::Mat &imageSrc, cv::Mat &imageDst, const ColorLUT *lut,
+	ColorLUTInterpolation interpolation, int grainRows)
+{
+	ColorLUTRow convertRow = getColorLUTRow(lut, interpolation, "convertImageColorLUTInto");
+	convertMatRowsInto(imageSrc, imageDst, convertRow, grainRows, "convertImageColorLUTInto");
+}
 
-		// Clear the image
-		cvSet(imageGraph, WHITE);
-	}
-	else {
-		// Create a new copy of the image, so we know we have to free an image later
-		imageGraph = cvCloneImage(imageDst);
-	}
-	if (!imageGraph) {
-		cerr << "ERROR in drawUCharGraph(): Couldn't create image of " << w << " x " << h << endl;
+// The planes of a YUV 4:2:0 frame, as given by video decoders.
+struct YUV420Frame {
+	const uchar *planeY;
+	const uchar *planeU;
+	const uchar *planeV;
+	size_t strideY;
+	size_t strideUV;
+	int chromaStep;		// 1 for separate U & V planes, or 2 for interleaved U,V pairs.
+	int width;			// The size of the Y plane.
+	int height;
+};
+
+// Get the planes of a YUV 4:2:0 frame stored in a single 8-bit 1-channel image, with the chroma rows below the rows of Y,
+// just like cv::cvtColor() takes. Exits if the image doesn't have that layout.
+static YUV420Frame getYUV420Frame(const cv::Mat &imageYUV, YUV420Format format, const char *funcName)
+{
+	if (imageYUV.type() != CV_8UC1 || imageYUV.rows % 3 != 0 || imageYUV.cols % 2 != 0) {
+		printf("ERROR in %s()! Bad input image. YUV 4:2:0 frames need an even width & height.\n", funcName);
 		exit(1);
 	}
-	CvScalar colorGraph = getGraphColor();	// use a different color each time.
+	YUV420Frame frame;
+	frame.width = imageYUV.cols;
+	frame.height = imageYUV.rows * 2 / 3;
+	frame.planeY = imageYUV.data;
+	frame.strideY = imageYUV.step;
+	const uchar *chroma = imageYUV.data + frame.height * imageYUV.step;
+	switch (format) {
+		case YUV420_I420:
+		case YUV420_YV12: {
+			// Each chroma plane is packed with half the stride of the Y plane.
+			const uchar *plane0 = chroma;
+			const uchar *plane1 = chroma + (frame.height / 2) * (imageYUV.step / 2);
+			frame.planeU = (format == YUV420_I420) ? plane0 : plane1;
+			frame.planeV = (format == YUV420_I420) ? plane1 : plane0;
+			frame.strideUV = imageYUV.step / 2;
+			frame.chromaStep = 1;
+			return frame;
+		}
+		case YUV420_NV12:
+		case YUV420_NV21:
+			frame.planeU = (format == YUV420_NV12) ? chroma : chroma + 1;
+			frame.planeV = (format == YUV420_NV12) ? chroma + 1 : chroma;
+			frame.strideUV = imageYUV.step;
+			frame.chromaStep = 2;
+			return frame;
+	}
+	printf("ERROR in %s()! Unknown YUV 4:2:0 format %d.\n", funcName, (int)format);
+	exit(1);
+}
 
-	// Draw the horizontal & vertical axis
-	cvLine(imageGraph, cvPoint(b,h-b), cvPoint(b+nArrayLength, h-b), BLACK);
-	cvLine(imageGraph, cvPoint(b,h-b), cvPoint(b, h-(b+s)), BLACK);
+// Get the size of the converted image of a YUV 4:2:0 frame, that is the size of the chroma planes if chromaResolution is true.
+static cv::Size getYUV420OutputSize(const YUV420Frame &frame, bool chromaResolution)
+{
+	if (chromaResolution)
+		return cv::Size(frame.width / 2, frame.height / 2);
+	return cv::Size(frame.width, frame.height);
+}
 
-	// Find the max value of the data, so we can draw it at full scale
-	float maxV = 0.0;
-	for (int i=0; i<nArrayLength; i++) {
-		float v = (float)arraySrc[i];
-		if (v > maxV)
-			maxV = v;
+// Convert each row of a YUV 4:2:0 frame into imageDst. Each block of pixels is converted to BGR with the yuvToRGB color
+// matrix and then by convertRow, so the BGR pixels never leave the cache. If chromaResolution is true, each 2x2 block
+// of Y values is averaged to give an image at the resolution of the chroma planes, otherwise the chroma is repeated.
+// If grainRows is positive, blocks of at least grainRows rows are converted in parallel using TBB.
+template<typename ROW_FUNC>
+static void convertYUV420Rows(const YUV420Frame &frame, cv::Mat &imageDst, const ColorMatrix *yuvToRGB, bool chromaResolution,
+	ROW_FUNC convertRow, int grainRows)
+{
+	const int BLOCK = 256;	// Pixels per block, so that the buffer fits in the L1 cache.
+	ColorMatrix matrix = yuvToRGB ? *yuvToRGB : getColorMatrix(COLOR_MATRIX_YCBCR601_TO_RGB);
+	const ColorMatrixRow convertYUV = getColorMatrixRow(&matrix, false);
+	const int w = imageDst.cols;
+	auto convertRange = [&](int y0, int y1) {
+		uchar buffer[BLOCK*3];
+		for (int y=y0; y<y1; y++) {
+			const uchar *rowY = frame.planeY + (chromaResolution ? y*2 : y) * frame.strideY;
+			const uchar *rowU = frame.planeU + (chromaResolution ? y : y/2) * frame.strideUV;
+			const uchar *rowV = frame.planeV + (chromaResolution ? y : y/2) * frame.strideUV;
+			uchar *rowDst = imageDst.data + y * imageDst.step;
+			for (int x0=0; x0<w; x0+=BLOCK) {
+				int n = min(BLOCK, w - x0);
+				// Gather the Y, U & V of each pixel into the buffer.
+				if (chromaResolution) {
+					const uchar *rowY2 = rowY + frame.strideY;
+					for (int i=0; i<n; i++) {
+						int x = x0 + i;
+						buffer[i*3+0] = (rowY[x*2] + rowY[x*2+1] + rowY2[x*2] + rowY2[x*2+1] + 2) >> 2;
+						buffer[i*3+1] = rowU[x * frame.chromaStep];
+						buffer[i*3+2] = rowV[x * frame.chromaStep];
+					}
+				}
+				else {
+					for (int i=0; i<n; i++) {
+						int x = x0 + i;
+						buffer[i*3+0] = rowY[x];
+						buffer[i*3+1] = rowU[(x/2) * frame.chromaStep];
+						buffer[i*3+2] = rowV[(x/2) * frame.chromaStep];
+					}
+				}
+				convertYUV(buffer, buffer, n);
+				convertRow(buffer, rowDst + x0*3, n);
+			}
+		}
+	};
+	if (grainRows > 0) {
+		tbb::parallel_for(tbb::blocked_range<int>(0, imageDst.rows, grainRows), [&](const tbb::blocked_range<int> &rows) {
+			convertRange(rows.begin(), rows.end());
+		});
 	}
-
-	// Draw the values
-	CvPoint ptPrev = cvPoint(b,h-b);	// Start the lines at the 1st point.
-	if (maxV == 0)
-		maxV = 0.00000001f;	// Stop a divide-by-zero error
-	float fscale = (float)s / maxV;
-	for (int i=0; i<nArrayLength; i++) {
-		int y = (int)((float)arraySrc[i] * fscale);	// Get the values at a bigger scale
-		CvPoint ptNew = cvPoint(b+i,h-(b+y));
-		cvLine(imageGraph, ptPrev, ptNew, colorGraph);	// Draw a line from the previous point to the new point
-		ptPrev = ptNew;
+	else {
+		convertRange(0, imageDst.rows);
 	}
-
-	return imageGraph;
 }
 
-// Display a graph of the given float array.
-// If background is provided, it will be drawn into, for combining multiple graphs using drawFloatGraph().
-// Set delay_ms to 0 if you want to wait forever until a keypress, or set it to 1 if you want it to delay just 1 millisecond.
-void showFloatGraph(const char *name, const float *arraySrc, int nArrayLength, int delay_ms, IplImage *background)
+// Convert a YUV 4:2:0 frame into *imageDst, that is only (re)allocated when it is NULL or the wrong size.
+template<typename ROW_FUNC>
+static void convertImageYUV420Into(const IplImage *imageYUV, YUV420Format format, IplImage **imageDst,
+	const ColorMatrix *yuvToRGB, bool chromaResolution, ROW_FUNC convertRow, int grainRows, const char *funcName)
 {
-	// Draw the graph
-	IplImage *imageGraph = drawFloatGraph(arraySrc, nArrayLength, background);
+	if (!imageYUV || !imageDst) {
+		printf("ERROR in %s()! Bad input image.\n", funcName);
+		exit(1);
+	}
+	YUV420Frame frame = getYUV420Frame(cv::cvarrToMat(imageYUV), format, funcName);
+	cv::Size size = getYUV420OutputSize(frame, chromaResolution);
+	cv::Mat dst = cv::cvarrToMat(reuseImage(imageDst, cvSize(size.width, size.height), 8, 3, funcName));
+	convertYUV420Rows(frame, dst, yuvToRGB, chromaResolution, convertRow, grainRows);
+}
 
-	// Display the graph into a window
-    cvNamedWindow( name );
-    cvShowImage( name, imageGraph );
+// Same as convertImageYUV420Into() but for cv::Mat, where Mat::create() only reallocates if the size or type changed.
+template<typename ROW_FUNC>
+static void convertMatYUV420Into(const cv::Mat &imageYUV, YUV420Format format, cv::Mat &imageDst, const ColorMatrix *yuvToRGB,
+	bool chromaResolution, ROW_FUNC convertRow, int grainRows, const char *funcName)
+{
+	YUV420Frame frame = getYUV420Frame(imageYUV, format, funcName);
+	imageDst.create(getYUV420OutputSize(frame, chromaResolution), CV_8UC3);
+	convertYUV420Rows(frame, imageDst, yuvToRGB, chromaResolution, convertRow, grainRows);
+}
 
-	cvWaitKey( 10 );		// Note that cvWaitKey() is required for the OpenCV window to show!
-	cvWaitKey( delay_ms );	// Wait longer to make sure the user has seen the graph
+// Convert a YUV 4:2:0 frame from a video decoder straight to HSV (like convertImageRGBtoHSV()), without creating a BGR image.
+// *imageHSV is only (re)allocated when it is NULL or the wrong size.
+void convertImageYUV420toHSVInto(const IplImage *imageYUV, YUV420Format format, IplImage **imageHSV, const ColorMatrix *yuvToRGB,
+	bool chromaResolution, int grainRows)
+{
+	ColorRowFunc convertRow = getRowFunc(convertRowRGBtoHSV_C, convertRowRGBtoHSV_SSE41, convertRowRGBtoHSV_AVX2, convertRowRGBtoHSV_AVX512);
+	convertImageYUV420Into(imageYUV, format, imageHSV, yuvToRGB, chromaResolution, convertRow, grainRows,
+		"convertImageYUV420toHSVInto");
+}
 
-	cvReleaseImage(&imageGraph);
+// Same as convertImageYUV420toHSVInto(), but for a cv::Mat, that is only reallocated when it has the wrong size or type.
+void convertImageYUV420toHSVInto(const cv::Mat &imageYUV, YUV420Format format, cv::Mat &imageHSV, const ColorMatrix *yuvToRGB,
+	bool chromaResolution, int grainRows)
+{
+	ColorRowFunc convertRow = getRowFunc(convertRowRGBtoHSV_C, convertRowRGBtoHSV_SSE41, convertRowRGBtoHSV_AVX2, convertRowRGBtoHSV_AVX512);
+	convertMatYUV420Into(imageYUV, format, imageHSV, yuvToRGB, chromaResolution, convertRow, grainRows,
+		"convertImageYUV420toHSVInto");
 }
 
-// Display a graph of the given int array.
-// If background is provided, it will be drawn into, for combining multiple graphs using drawIntGraph().
-// Set delay_ms to 0 if you want to wait forever until a keypress, or set it to 1 if you want it to delay just 1 millisecond.
-void showIntGraph(const char *name, const int *arraySrc, int nArrayLength, int delay_ms, IplImage *background)
+// Convert a YUV 4:2:0 frame from a video decoder straight to YIQ (like convertImageRGBtoYIQ()), without creating a BGR image.
+// *imageYIQ is only (re)allocated when it is NULL or the wrong size.
+void convertImageYUV420toYIQInto(const IplImage *imageYUV, YUV420Format format, IplImage **imageYIQ, const ColorMatrix *yuvToRGB,
+	bool chromaResolution, int grainRows)
 {
-	// Draw the graph
-	IplImage *imageGraph = drawIntGraph(arraySrc, nArrayLength, background);
+	convertImageYUV420Into(imageYUV, format, imageYIQ, yuvToRGB, chromaResolution, getYIQRow(COLOR_MATRIX_RGB_TO_YIQ), grainRows,
+		"convertImageYUV420toYIQInto");
+}
 
-	// Display the graph into a window
-    cvNamedWindow( name );
-    cvShowImage( name, imageGraph );
+// Same as convertImageYUV420toYIQInto(), but for a cv::Mat, that is only reallocated when it has the wrong size or type.
+void convertImageYUV420toYIQInto(const cv::Mat &imageYUV, YUV420Format format, cv::Mat &imageYIQ, const ColorMatrix *yuvToRGB,
+	bool chromaResolution, int grainRows)
+{
+	convertMatYUV420Into(imageYUV, format, imageYIQ, yuvToRGB, chromaResolution, getYIQRow(COLOR_MATRIX_RGB_TO_YIQ), grainRows,
+		"convertImageYUV420toYIQInto");
+}
 
-	cvWaitKey( 10 );		// Note that cvWaitKey() is required for the OpenCV window to show!
-	cvWaitKey( delay_ms );	// Wait longer to make sure the user has seen the graph
+namespace imageutils
+{
 
-	cvReleaseImage(&imageGraph);
+// Convert src into dst, that is only reallocated if it has the wrong size or type, by calling convertRow on each row.
+template<typename ROW_FUNC>
+static void convertArrayRows(cv::InputArray src, cv::OutputArray dst, ROW_FUNC convertRow, int grainRows,
+	const char *funcName)
+{
+	cv::Mat imageSrc = src.getMat();
+	dst.create(imageSrc.size(), CV_8UC3);
+	cv::Mat imageDst = dst.getMat();
+	convertMatRowsInto(imageSrc, imageDst, convertRow, grainRows, funcName);
 }
 
-// Display a graph of the given unsigned char array.
-// If background is provided, it will be drawn into, for combining multiple graphs using drawUCharGraph().
-// Set delay_ms to 0 if you want to wait forever until a keypress, or set it to 1 if you want it to delay just 1 millisecond.
-void showUCharGraph(const char *name, const uchar *arraySrc, int nArrayLength, int delay_ms, IplImage *background)
+// Get the templated 8-bit row kernel of a conversion for the given channel order,
+// or exit if the 8-bit image doesn't have the right number of channels for that order.
+template<class CONVERSION, int LAYOUT>
+static PlanarRowFunc getRowFuncForImage(const cv::Mat &imageSrc, ChannelOrder order, const char *funcName)
 {
-	// Draw the graph
-	IplImage *imageGraph = drawUCharGraph(arraySrc, nArrayLength, background);
+	int channels = (order == ORDER_BGRA || order == ORDER_RGBA) ? 4 : 3;
+	PlanarRowFunc convertRow = getRowFuncForOrder<CONVERSION, LAYOUT>(order);
+	if (!convertRow || imageSrc.channels() != channels) {
+		printf("ERROR in %s()! Bad input image.\n", funcName);
+		exit(1);
+	}
+	return convertRow;
+}
 
-	// Display the graph into a window
-    cvNamedWindow( name );
-    cvShowImage( name, imageGraph );
+// Get the depth of the output, where a negative dstDepth means the same depth as imageSrc.
+static int getOutputDepth(const cv::Mat &imageSrc, int dstDepth)
+{
+	return (dstDepth < 0) ? imageSrc.depth() : dstDepth;
+}
 
-	cvWaitKey( 10 );		// Note that cvWaitKey() is required for the OpenCV window to show!
-	cvWaitKey( delay_ms );	// Wait longer to make sure the user has seen the graph
+// Convert imageSrc into the 3-channel image dst of dstDepth with a templated row kernel, reallocating dst only if needed.
+template<typename ROW_FUNC>
+static void convertArrayInterleavedRows(const cv::Mat &imageSrc, cv::OutputArray dst, int dstDepth, ROW_FUNC convertRow,
+	int grainRows)
+{
+	dst.create(imageSrc.size(), CV_MAKETYPE(dstDepth, 3));
+	cv::Mat imageDst = dst.getMat();
+	uchar *imDst[3] = {imageDst.data, 0, 0};
+	size_t rowSizeDst[3] = {imageDst.step, 0, 0};
+	convertPlanarRows(imageSrc.data, imageSrc.step, imDst, rowSizeDst, imageSrc.cols, imageSrc.rows, convertRow, grainRows);
+}
 
-	cvReleaseImage(&imageGraph);
+// Convert imageSrc in the given channel order into the 3-channel image dst of dstDepth with the float conversion.
+static void convertArrayAnyDepthRows(const cv::Mat &imageSrc, cv::OutputArray dst, const FloatConversion &conversion,
+	ChannelOrder order, int dstDepth, int grainRows, const char *funcName)
+{
+	AnyDepthRow convertRow = getAnyDepthRow<LAYOUT_INTERLEAVED>(conversion, imageSrc, order, dstDepth, funcName);
+	convertArrayInterleavedRows(imageSrc, dst, dstDepth, convertRow, grainRows);
 }
 
-//------------------------------------------------------------------------------
-// Color conversion functions
-//------------------------------------------------------------------------------
+void convertRGBtoHSV(cv::InputArray src, cv::OutputArray dst, int grainRows, ChannelOrder order, int dstDepth)
+{
+	cv::Mat imageSrc = src.getMat();
+	dstDepth = getOutputDepth(imageSrc, dstDepth);
+	if (imageSrc.depth() != CV_8U || dstDepth != CV_8U) {
+		convertArrayAnyDepthRows(imageSrc, dst, getRGBtoHSVFloat(), order, dstDepth, grainRows, "imageutils::convertRGBtoHSV");
+		return;
+	}
+	if (imageSrc.type() == CV_8UC3 && order == ORDER_BGR) {
+		// Use the SIMD kernels for normal 8-bit BGR images.
+		ColorRowFunc convertRow = getRowFunc(convertRowRGBtoHSV_C, convertRowRGBtoHSV_SSE41, convertRowRGBtoHSV_AVX2, convertRowRGBtoHSV_AVX512);
+		convertArrayRows(imageSrc, dst, convertRow, grainRows, "imageutils::convertRGBtoHSV");
+		return;
+	}
+	PlanarRowFunc convertRow = getRowFuncForImage<ConvertRGBtoHSV, LAYOUT_INTERLEAVED>(imageSrc, order, "imageutils::convertRGBtoHSV");
+	convertArrayInterleavedRows(imageSrc, dst, CV_8U, convertRow, grainRows);
+}
 
-// Create a HSV image from the RGB image using the full 8-bits, since OpenCV only allows Hues up to 180 instead of 255.
-// ref: "http://cs.haifa.ac.il/hagit/courses/ist/Lectures/Demos/ColorApplet2/t_convert.html"
-// Remember to free the generated HSV image.
-IplImage* convertImageRGBtoHSV(const IplImage *imageRGB)
+void convertHSVtoRGB(cv::InputArray src, cv::OutputArray dst, int grainRows, int dstDepth)
 {
-	float fR, fG, fB;
-	float fH, fS, fV;
-	const float FLOAT_TO_BYTE = 255.0f;
-	const float BYTE_TO_FLOAT = 1.0f / FLOAT_TO_BYTE;
+	cv::Mat imageSrc = src.getMat();
+	dstDepth = getOutputDepth(imageSrc, dstDepth);
+	if (imageSrc.depth() != CV_8U || dstDepth != CV_8U) {
+		convertArrayAnyDepthRows(imageSrc, dst, getHSVtoRGBFloat(), ORDER_BGR, dstDepth, grainRows, "imageutils::convertHSVtoRGB");
+		return;
+	}
+	ColorRowFunc convertRow = getRowFunc(convertRowHSVtoRGB_C, convertRowHSVtoRGB_SSE41, convertRowHSVtoRGB_AVX2, convertRowHSVtoRGB_AVX512);
+	convertArrayRows(imageSrc, dst, convertRow, grainRows, "imageutils::convertHSVtoRGB");
+}
 
-	// Create a blank HSV image
-	IplImage *imageHSV = cvCreateImage(cvGetSize(imageRGB), 8, 3);
-	if (!imageHSV || imageRGB->depth != 8 || imageRGB->nChannels != 3) {
-		printf("ERROR in convertImageRGBtoHSV()! Bad input image.\n");
-		exit(1);
+void convertRGBtoYIQ(cv::InputArray src, cv::OutputArray dst, int grainRows, ChannelOrder order, int dstDepth)
+{
+	cv::Mat imageSrc = src.getMat();
+	dstDepth = getOutputDepth(imageSrc, dstDepth);
+	if (imageSrc.depth() != CV_8U || dstDepth != CV_8U) {
+		convertArrayAnyDepthRows(imageSrc, dst, getRGBtoYIQFloat(), order, dstDepth, grainRows, "imageutils::convertRGBtoYIQ");
+		return;
+	}
+	if (imageSrc.type() == CV_8UC3 && order == ORDER_BGR) {
+		convertArrayRows(imageSrc, dst, getYIQRow(COLOR_MATRIX_RGB_TO_YIQ), grainRows, "imageutils::convertRGBtoYIQ");
+		return;
 	}
+	PlanarRowFunc convertRow = getRowFuncForImage<ConvertRGBtoYIQ, LAYOUT_INTERLEAVED>(imageSrc, order, "imageutils::convertRGBtoYIQ");
+	convertArrayInterleavedRows(imageSrc, dst, CV_8U, convertRow, grainRows);
+}
 
-	int h = imageRGB->height;				// Pixel height
-	int w = imageRGB->width;				// Pixel width
-	int rowSizeRGB = imageRGB->widthStep;	// Size of row in bytes, including extra padding
-	char *imRGB = imageRGB->imageData;		// Pointer to the start of the image pixels.
-	int rowSizeHSV = imageHSV->widthStep;	// Size of row in bytes, including extra padding
-	char *imHSV = imageHSV->imageData;		// Pointer to the start of the image pixels.
-	for (int y=0; y<h; y++) {
-		for (int x=0; x<w; x++) {
-			// Get the RGB pixel components. NOTE that OpenCV stores RGB pixels in B,G,R order.
-			uchar *pRGB = (uchar*)(imRGB + y*rowSizeRGB + x*3);
-			int bB = *(uchar*)(pRGB+0);	// Blue component
-			int bG = *(uchar*)(pRGB+1);	// Green component
-			int bR = *(uchar*)(pRGB+2);	// Red component
-
-			// Convert from 8-bit integers to floats
-			fR = bR * BYTE_TO_FLOAT;
-			fG = bG * BYTE_TO_FLOAT;
-			fB = bB * BYTE_TO_FLOAT;
-
-			// Convert from RGB to HSV, using float ranges 0.0 to 1.0
-			float fDelta;
-			float fMin, fMax;
-			int iMax;
-			// Get the min & max, but use integer comparisons for slight speedup
-			if (bB < bG) {
-				if (bB < bR) {
-					fMin = fB;
-					if (bR > bG) {
-						iMax = bR;
-						fMax = fR;
-					}
-					else {
-						iMax = bG;
-						fMax = fG;
-					}
-				}
-				else {
-					fMin = fR;
-					fMax = fG;
-					iMax = bG;
-				}
-			}
-			else {
-				if (bG < bR) {
-					fMin = fG;
-					if (bB > bR) {
-						fMax = fB;
-						iMax = bB;
-					}
-					else {
-						fMax = fR;
-						iMax = bR;
-					}
-				}
-				else {
-					fMin = fR;
-					fMax = fB;
-					iMax = bB;
-				}
-			}
-			fDelta = fMax - fMin;
-			fV = fMax;					// Value (Brightness).
-			if (iMax != 0) {			// Make sure its not pure black.
-				fS = fDelta / fMax;		// Saturation.
-				float ANGLE_TO_UNIT = 1.0f / (6.0f * fDelta);	// Make the Hues between 0.0 to 1.0 instead of 6.0
-				if (iMax == bR) {		// between yellow & magenta.
-					fH = (fG - fB) * ANGLE_TO_UNIT;
-				}
-				else if (iMax == bG) {	// between cyan & yellow.
-					fH = (2.0f/6.0f) + ( fB - fR ) * ANGLE_TO_UNIT;
-				}
-				else {					// between magenta & cyan.
-					fH = (4.0f/6.0f) + ( fR - fG ) * ANGLE_TO_UNIT;
-				}
-				// Wrap outlier Hues around the circle.
-				if (fH < 0.0f)
-					fH += 1.0f;
-				if (fH >= 1.0f)
-					fH -= 1.0f;
-			}
-			else {
-				// color is pure Black.
-				fS = 0;
-				fH = 0;	// undefined hue
-			}
+void convertYIQtoRGB(cv::InputArray src, cv::OutputArray dst, int grainRows, int dstDepth)
+{
+	cv::Mat imageSrc = src.getMat();
+	dstDepth = getOutputDepth(imageSrc, dstDepth);
+	if (imageSrc.depth() != CV_8U || dstDepth != CV_8U) {
+		convertArrayAnyDepthRows(imageSrc, dst, getYIQtoRGBFloat(), ORDER_BGR, dstDepth, grainRows, "imageutils::convertYIQtoRGB");
+		return;
+	}
+	convertArrayRows(imageSrc, dst, getYIQRow(COLOR_MATRIX_YIQ_TO_RGB), grainRows, "imageutils::convertYIQtoRGB");
+}
 
-			// Convert from floats to 8-bit integers
-			int bH = (int)(0.5f + fH * 255.0f);
-			int bS = (int)(0.5f + fS * 255.0f);
-			int bV = (int)(0.5f + fV * 255.0f);
-
-			// Clip the values to make sure it fits within the 8bits
-			//if (bH > 255 || bH < 0 || bS > 255 || bS < 0 || bV > 255 || bV < 0) {
-			//	cout << "Warning: HSV pixel(" << x << "," << y << ") is being clipped. " << bH << "," << bS << "," << bV << endl;
-			//}
-			if (bH > 255)
-				bH = 255;
-			if (bH < 0)
-				bH = 0;
-			if (bS > 255)
-				bS = 255;
-			if (bS < 0)
-				bS = 0;
-			if (bV > 255)
-				bV = 255;
-			if (bV < 0)
-				bV = 0;
-
-			// Set the HSV pixel components
-			uchar *pHSV = (uchar*)(imHSV + y*rowSizeHSV + x*3);
-			*(pHSV+0) = bH;		// H component
-			*(pHSV+1) = bS;		// S component
-			*(pHSV+2) = bV;		// V component
+// Convert imageSrc into the planes of dstDepth that are needed (ie: not cv::noArray()), by calling convertRow on each row.
+template<typename ROW_FUNC>
+static void convertArrayPlanarRows(const cv::Mat &imageSrc, cv::OutputArray plane0, cv::OutputArray plane1,
+	cv::OutputArray plane2, int dstDepth, ROW_FUNC convertRow, int grainRows)
+{
+	const cv::_OutputArray *planes[3] = {&plane0, &plane1, &plane2};
+	cv::Mat mats[3];
+	uchar *imDst[3];
+	size_t rowSizeDst[3];
+	for (int c=0; c<3; c++) {
+		imDst[c] = 0;
+		rowSizeDst[c] = 0;
+		if (planes[c]->needed()) {
+			planes[c]->create(imageSrc.size(), CV_MAKETYPE(dstDepth, 1));
+			mats[c] = planes[c]->getMat();
+			imDst[c] = mats[c].data;
+			rowSizeDst[c] = mats[c].step;
 		}
 	}
-	return imageHSV;
+	convertPlanarRows(imageSrc.data, imageSrc.step, imDst, rowSizeDst, imageSrc.cols, imageSrc.rows, convertRow, grainRows);
 }
 
-// Create an RGB image from the HSV image using the full 8-bits, since OpenCV only allows Hues up to 180 instead of 255.
-// ref: "http://cs.haifa.ac.il/hagit/courses/ist/Lectures/Demos/ColorApplet2/t_convert.html"
-// Remember to free the generated RGB image.
-IplImage* convertImageHSVtoRGB(const IplImage *imageHSV)
+void convertRGBtoHSVPlanes(cv::InputArray src, cv::OutputArray h, cv::OutputArray s, cv::OutputArray v, int grainRows,
+	ChannelOrder order, int dstDepth)
 {
-	float fH, fS, fV;
-	float fR, fG, fB;
-	const float FLOAT_TO_BYTE = 255.0f;
-	const float BYTE_TO_FLOAT = 1.0f / FLOAT_TO_BYTE;
+	cv::Mat imageSrc = src.getMat();
+	dstDepth = getOutputDepth(imageSrc, dstDepth);
+	if (imageSrc.depth() != CV_8U || dstDepth != CV_8U) {
+		AnyDepthRow convertRow = getAnyDepthRow<LAYOUT_PLANAR>(getRGBtoHSVFloat(), imageSrc, order, dstDepth,
+			"imageutils::convertRGBtoHSVPlanes");
+		convertArrayPlanarRows(imageSrc, h, s, v, dstDepth, convertRow, grainRows);
+		return;
+	}
+	PlanarRowFunc convertRow = convertRowRGBtoHSVPlanar;
+	if (imageSrc.type() != CV_8UC3 || order != ORDER_BGR)
+		convertRow = getRowFuncForImage<ConvertRGBtoHSV, LAYOUT_PLANAR>(imageSrc, order, "imageutils::convertRGBtoHSVPlanes");
+	convertArrayPlanarRows(imageSrc, h, s, v, CV_8U, convertRow, grainRows);
+}
 
-	// Create a blank RGB image
-	IplImage *imageRGB = cvCreateImage(cvGetSize(imageHSV), 8, 3);
-	if (!imageRGB || imageHSV->depth != 8 || imageHSV->nChannels != 3) {
-		printf("ERROR in convertImageHSVtoRGB()! Bad input image.\n");
-		exit(1);
+void convertRGBtoYIQPlanes(cv::InputArray src, cv::OutputArray y, cv::OutputArray i, cv::OutputArray q, int grainRows,
+	ChannelOrder order, int dstDepth)
+{
+	cv::Mat imageSrc = src.getMat();
+	dstDepth = getOutputDepth(imageSrc, dstDepth);
+	if (imageSrc.depth() != CV_8U || dstDepth != CV_8U) {
+		AnyDepthRow convertRow = getAnyDepthRow<LAYOUT_PLANAR>(getRGBtoYIQFloat(), imageSrc, order, dstDepth,
+			"imageutils::convertRGBtoYIQPlanes");
+		convertArrayPlanarRows(imageSrc, y, i, q, dstDepth, convertRow, grainRows);
+		return;
 	}
+	PlanarRowFunc convertRow = convertRowRGBtoYIQPlanar_C;
+	if (imageSrc.type() != CV_8UC3 || order != ORDER_BGR)
+		convertRow = getRowFuncForImage<ConvertRGBtoYIQ, LAYOUT_PLANAR>(imageSrc, order, "imageutils::convertRGBtoYIQPlanes");
+	convertArrayPlanarRows(imageSrc, y, i, q, CV_8U, convertRow, grainRows);
+}
 
-	int h = imageHSV->height;				// Pixel height
-	int w = imageHSV->width;				// Pixel width
-	int rowSizeHSV = imageHSV->widthStep;	// Size of row in bytes, including extra padding
-	char *imHSV = imageHSV->imageData;		// Pointer to the start of the image pixels.
-	int rowSizeRGB = imageRGB->widthStep;	// Size of row in bytes, including extra padding
-	char *imRGB = imageRGB->imageData;		// Pointer to the start of the image pixels.
-	for (int y=0; y<h; y++) {
-		for (int x=0; x<w; x++) {
-			// Get the HSV pixel components
-			uchar *pHSV = (uchar*)(imHSV + y*rowSizeHSV + x*3);
-			int bH = *(uchar*)(pHSV+0);	// H component
-			int bS = *(uchar*)(pHSV+1);	// S component
-			int bV = *(uchar*)(pHSV+2);	// V component
-
-			// Convert from 8-bit integers to floats
-			fH = (float)bH * BYTE_TO_FLOAT;
-			fS = (float)bS * BYTE_TO_FLOAT;
-			fV = (float)bV * BYTE_TO_FLOAT;
-
-			// Convert from HSV to RGB, using float ranges 0.0 to 1.0
-			int iI;
-			float fI, fF, p, q, t;
-
-			if( bS == 0 ) {
-				// achromatic (grey)
-				fR = fG = fB = fV;
-			}
-			else {
-				//if (bH < 0 || bH >= 255 || bS < 0 || bS > 255 || bV < 0 || bV > 255) {
-				//	cout << "ERROR: HSVi pixel(" << x << "," << y << ") is being clipped. " << bH << "," << bS << "," << bV << endl;
-				//	cout << "ERROR: HSVf pixel(" << x << "," << y << ") is being clipped. " << fH << "," << fS << "," << fV << endl;
-				//}
+void convertColorMatrix(cv::InputArray src, cv::OutputArray dst, const ColorMatrix &matrix, bool useFloat, int grainRows)
+{
+	convertArrayRows(src, dst, getColorMatrixRow(&matrix, useFloat), grainRows, "imageutils::convertColorMatrix");
+}
 
-				// If Hue == 1.0, then wrap it around the circle to 0.0
-				if (fH >= 1.0f)
-					fH = 0.0f;
-
-				fH *= 6.0;			// sector 0 to 5
-				fI = floor( fH );		// integer part of h (0,1,2,3,4,5 or 6)
-				iI = (int) fH;			//		"		"		"		"
-				fF = fH - fI;			// factorial part of h (0 to 1)
-
-				p = fV * ( 1.0f - fS );
-				q = fV * ( 1.0f - fS * fF );
-				t = fV * ( 1.0f - fS * ( 1.0f - fF ) );
-
-				switch( iI ) {
-					case 0:
-						fR = fV;
-						fG = t;
-						fB = p;
-						break;
-					case 1:
-						fR = q;
-						fG = fV;
-						fB = p;
-						break;
-					case 2:
-						fR = p;
-						fG = fV;
-						fB = t;
-						break;
-					case 3:
-						fR = p;
-						fG = q;
-						fB = fV;
-						break;
-					case 4:
-						fR = t;
-						fG = p;
-						fB = fV;
-						break;
-					default:		// case 5 (or 6):
-						fR = fV;
-						fG = p;
-						fB = q;
-						break;
-				}
-			}
+ColorLUTPtr createColorLUTFromLattice(cv::InputArray lattice)
+{
+	IplImage imageLattice = toIplImage(lattice.getMat());
+	return ColorLUTPtr(::createColorLUTFromLattice(&imageLattice));
+}
 
-			// Convert from floats to 8-bit integers
-			int bR = (int)(fR * FLOAT_TO_BYTE);
-			int bG = (int)(fG * FLOAT_TO_BYTE);
-			int bB = (int)(fB * FLOAT_TO_BYTE);
-
-			// Clip the values to make sure it fits within the 8bits
-			//if (bR > 255 || bR < 0 || bG > 255 || bG < 0 || bB > 255 || bB < 0) {
-			//	cout << "Warning: RGB pixel(" << x << "," << y << ") is being clipped. " << bR << "," << bG << "," << bB << endl;
-			//}
-			if (bR > 255)
-				bR = 255;
-			if (bR < 0)
-				bR = 0;
-			if (bG > 255)
-				bG = 255;
-			if (bG < 0)
-				bG = 0;
-			if (bB > 255)
-				bB = 255;
-			if (bB < 0)
-				bB = 0;
-
-			// Set the RGB pixel components. NOTE that OpenCV stores RGB pixels in B,G,R order.
-			uchar *pRGB = (uchar*)(imRGB + y*rowSizeRGB + x*3);
-			*(pRGB+0) = bB;		// B component
-			*(pRGB+1) = bG;		// G component
-			*(pRGB+2) = bR;		// R component
-		}
-	}
-	return imageRGB;
+void convertColorLUT(cv::InputArray src, cv::OutputArray dst, const ColorLUT *lut, ColorLUTInterpolation interpolation,
+	int grainRows)
+{
+	ColorLUTRow convertRow = getColorLUTRow(lut, interpolation, "imageutils::convertColorLUT");
+	convertArrayRows(src, dst, convertRow, grainRows, "imageutils::convertColorLUT");
 }
 
-// Create a YIQ image from the RGB image using an approximation of NTSC conversion(ref: "YIQ" Wikipedia page).
-// Remember to free the generated YIQ image.
-IplImage* convertImageRGBtoYIQ(const IplImage *imageRGB)
+void convertYUV420toHSV(cv::InputArray src, cv::OutputArray dst, YUV420Format format, const ColorMatrix *yuvToRGB,
+	bool chromaResolution, int grainRows)
 {
-	float fR, fG, fB;
-	float fY, fI, fQ;
-	const float FLOAT_TO_BYTE = 255.0f;
-	const float BYTE_TO_FLOAT = 1.0f / FLOAT_TO_BYTE;
-	const float MIN_I = -0.5957f;
-	const float MIN_Q = -0.5226f;
-	const float Y_TO_BYTE = 255.0f;
-	const float I_TO_BYTE = 255.0f / (MIN_I * -2.0f);
-	const float Q_TO_BYTE = 255.0f / (MIN_Q * -2.0f);
-
-	// Create a blank YIQ image
-	IplImage *imageYIQ = cvCreateImage(cvGetSize(imageRGB), 8, 3);
-	if (!imageYIQ || imageRGB->depth != 8 || imageRGB->nChannels != 3) {
-		printf("ERROR in convertImageRGBtoYIQ()! Bad input image.\n");
-		exit(1);
-	}
+	ColorRowFunc convertRow = getRowFunc(convertRowRGBtoHSV_C, convertRowRGBtoHSV_SSE41, convertRowRGBtoHSV_AVX2, convertRowRGBtoHSV_AVX512);
+	YUV420Frame frame = getYUV420Frame(src.getMat(), format, "imageutils::convertYUV420toHSV");
+	dst.create(getYUV420OutputSize(frame, chromaResolution), CV_8UC3);
+	cv::Mat imageDst = dst.getMat();
+	convertYUV420Rows(frame, imageDst, yuvToRGB, chromaResolution, convertRow, grainRows);
+}
 
-	int h = imageRGB->height;				// Pixel height
-	int w = imageRGB->width;				// Pixel width
-	int rowSizeRGB = imageRGB->widthStep;	// Size of row in bytes, including extra padding
-	char *imRGB = imageRGB->imageData;		// Pointer to the start of the image pixels.
-	int rowSizeYIQ = imageYIQ->widthStep;	// Size of row in bytes, including extra padding
-	char *imYIQ = imageYIQ->imageData;		// Pointer to the start of the image pixels.
-	for (int y=0; y<h; y++) {
-		for (int x=0; x<w; x++) {
-			// Get the RGB pixel components. NOTE that OpenCV stores RGB pixels in B,G,R order.
-			uchar *pRGB = (uchar*)(imRGB + y*rowSizeRGB + x*3);
-			int bB = *(uchar*)(pRGB+0);	// Blue component
-			int bG = *(uchar*)(pRGB+1);	// Green component
-			int bR = *(uchar*)(pRGB+2);	// Red component
-
-			// Convert from 8-bit integers to floats
-			fR = bR * BYTE_TO_FLOAT;
-			fG = bG * BYTE_TO_FLOAT;
-			fB = bB * BYTE_TO_FLOAT;
-			// Convert from RGB to YIQ,
-			// where R,G,B are 0-1, Y is 0-1, I is -0.5957 to +0.5957, Q is -0.5226 to +0.5226.
-			fY =    0.299 * fR +    0.587 * fG +    0.114 * fB;
-			fI = 0.595716 * fR - 0.274453 * fG - 0.321263 * fB;
-			fQ = 0.211456 * fR - 0.522591 * fG + 0.311135 * fB;
-			// Convert from floats to 8-bit integers
-			int bY = (int)(0.5f + fY * Y_TO_BYTE);
-			int bI = (int)(0.5f + (fI - MIN_I) * I_TO_BYTE);
-			int bQ = (int)(0.5f + (fQ - MIN_Q) * Q_TO_BYTE);
-
-			// Clip the values to make sure it fits within the 8bits
-			//if (bY > 255 || bY < 0 || bI > 255 || bI < 0 || bQ > 255 || bQ < 0) {
-			//	cout << "Warning: YIQ pixel(" << x << "," << y << ") is being clipped. " << bY << "," << bI << "," << bQ << endl;
-			//}
-			if (bY > 255)
-				bY = 255;
-			if (bY < 0)
-				bY = 0;
-			if (bI > 255)
-				bI = 255;
-			if (bI < 0)
-				bI = 0;
-			if (bQ > 255)
-				bQ = 255;
-			if (bQ < 0)
-				bQ = 0;
-
-			// Set the YIQ pixel components
-			uchar *pYIQ = (uchar*)(imYIQ + y*rowSizeYIQ + x*3);
-			*(pYIQ+0) = bY;		// Y component
-			*(pYIQ+1) = bI;		// I component
-			*(pYIQ+2) = bQ;		// Q component
-		}
-	}
-	return imageYIQ;
+void convertYUV420toYIQ(cv::InputArray src, cv::OutputArray dst, YUV420Format format, const ColorMatrix *yuvToRGB,
+	bool chromaResolution, int grainRows)
+{
+	YUV420Frame frame = getYUV420Frame(src.getMat(), format, "imageutils::convertYUV420toYIQ");
+	dst.create(getYUV420OutputSize(frame, chromaResolution), CV_8UC3);
+	cv::Mat imageDst = dst.getMat();
+	convertYUV420Rows(frame, imageDst, yuvToRGB, chromaResolution, getYIQRow(COLOR_MATRIX_RGB_TO_YIQ), grainRows);
 }
 
-// Create an RGB image from the YIQ image using an approximation of NTSC conversion(ref: "YIQ" Wikipedia page).
-// Remember to free the generated RGB image.
-IplImage* convertImageYIQtoRGB(const IplImage *imageYIQ)
+void convertRGBtoHSVMask(cv::InputArray src, cv::OutputArray mask, const RangeHSV &range, HistogramHSV *histogram,
+	int grainRows)
 {
-	float fY, fI, fQ;
-	float fR, fG, fB;
-	const float FLOAT_TO_BYTE = 255.0f;
-	const float BYTE_TO_FLOAT = 1.0f / FLOAT_TO_BYTE;
-	const float MIN_I = -0.5957f;
-	const float MIN_Q = -0.5226f;
-	const float Y_TO_FLOAT = 1.0f / 255.0f;
-	const float I_TO_FLOAT = -2.0f * MIN_I / 255.0f;
-	const float Q_TO_FLOAT = -2.0f * MIN_Q / 255.0f;
-
-	// Create a blank RGB image
-	IplImage *imageRGB = cvCreateImage(cvGetSize(imageYIQ), 8, 3);
-	if (!imageRGB || imageYIQ->depth != 8 || imageYIQ->nChannels != 3) {
-		printf("ERROR in convertImageYIQtoRGB()! Bad input image.\n");
+	cv::Mat imageRGB = src.getMat();
+	if (imageRGB.type() != CV_8UC3) {
+		printf("ERROR in imageutils::convertRGBtoHSVMask()! Bad input image.\n");
 		exit(1);
 	}
-
-	int h = imageYIQ->height;				// Pixel height
-	int w = imageYIQ->width;				// Pixel width
-	int rowSizeYIQ = imageYIQ->widthStep;	// Size of row in bytes, including extra padding
-	char *imYIQ = imageYIQ->imageData;		// Pointer to the start of the image pixels.
-	int rowSizeRGB = imageRGB->widthStep;	// Size of row in bytes, including extra padding
-	char *imRGB = imageRGB->imageData;		// Pointer to the start of the image pixels.
-	for (int y=0; y<h; y++) {
-		for (int x=0; x<w; x++) {
-			// Get the YIQ pixel components
-			uchar *pYIQ = (uchar*)(imYIQ + y*rowSizeYIQ + x*3);
-			int bY = *(uchar*)(pYIQ+0);	// Y component
-			int bI = *(uchar*)(pYIQ+1);	// I component
-			int bQ = *(uchar*)(pYIQ+2);	// Q component
-
-			// Convert from 8-bit integers to floats
-			fY = (float)bY * Y_TO_FLOAT;
-			fI = (float)bI * I_TO_FLOAT + MIN_I;
-			fQ = (float)bQ * Q_TO_FLOAT + MIN_Q;
-			// Convert from YIQ to RGB
-			// where R,G,B are 0-1, Y is 0-1, I is -0.5957 to +0.5957, Q is -0.5226 to +0.5226.
-			fR =  fY  + 0.9563 * fI + 0.6210 * fQ;
-			fG =  fY  - 0.2721 * fI - 0.6474 * fQ;
-			fB =  fY  - 1.1070 * fI + 1.7046 * fQ;
-			// Convert from floats to 8-bit integers
-			int bR = (int)(fR * FLOAT_TO_BYTE);
-			int bG = (int)(fG * FLOAT_TO_BYTE);
-			int bB = (int)(fB * FLOAT_TO_BYTE);
-
-			// Clip the values to make sure it fits within the 8bits
-			//if (bR > 255 || bR < 0 || bG > 255 || bG < 0 || bB > 255 || bB < 0) {
-			//	cout << "Warning: RGB pixel(" << x << "," << y << ") is being clipped. " << bR << "," << bG << "," << bB << endl;
-			//}
-			if (bR > 255)
-				bR = 255;
-			if (bR < 0)
-				bR = 0;
-			if (bG > 255)
-				bG = 255;
-			if (bG < 0)
-				bG = 0;
-			if (bB > 255)
-				bB = 255;
-			if (bB < 0)
-				bB = 0;
-
-			// Set the RGB pixel components. NOTE that OpenCV stores RGB pixels in B,G,R order.
-			uchar *pRGB = (uchar*)(imRGB + y*rowSizeRGB + x*3);
-			*(pRGB+0) = bB;		// B component
-			*(pRGB+1) = bG;		// G component
-			*(pRGB+2) = bR;		// R component
-		}
-	}
-	return imageRGB;
+	mask.create(imageRGB.size(), CV_8UC1);
+	cv::Mat imageMask = mask.getMat();
+	convertImageRowsRGBtoHSVMask(imageRGB.data, imageRGB.step, imageMask.data, imageMask.step, imageRGB.cols, imageRGB.rows,
+		range, histogram, grainRows);
 }
 
+}	// namespace imageutils
+
 //------------------------------------------------------------------------------
 // 2D Point functions
 //------------------------------------------------------------------------------
@@ -956,6 +2930,17 @@ CvRect cropRect(const CvRect rectIn, int w, int h)
 // Image transforming functions
 //------------------------------------------------------------------------------
 
+// Copy a region of an 8-bit image. If you don't need a copy, just use src(region) instead.
+void imageutils::cropImage(cv::InputArray src, cv::OutputArray dst, cv::Rect region)
+{
+	cv::Mat img = src.getMat();
+	if (img.depth() != CV_8U) {
+		std::cerr << "ERROR: Unknown image depth of " << img.depth() << " given in cropImage() instead of 8-bit." << std::endl;
+		exit(1);
+	}
+	img(region).copyTo(dst);
+}
+
 // Returns a new image that is a cropped version of the original image. 
 IplImage* cropImage(const IplImage *img, const CvRect region)
 {
@@ -988,6 +2973,48 @@ IplImage* cropImage(const IplImage *img, const CvRect region)
 	return imageRGB;		
 }
 
+// Resize the image to newSize. The aspect ratio will be kept constant if 'keepAspectRatio' is true,
+// by cropping undesired parts so that only pixels of the original image are shown, instead of adding extra blank space.
+void imageutils::resizeImage(cv::InputArray src, cv::OutputArray dst, cv::Size newSize, bool keepAspectRatio)
+{
+	cv::Mat img = src.getMat();
+	int origWidth = img.cols;
+	int origHeight = img.rows;
+	int newWidth = newSize.width;
+	int newHeight = newSize.height;
+	if (newWidth <= 0 || newHeight <= 0 || origWidth <= 0 || origHeight <= 0) {
+		std::cerr << "ERROR: Bad desired image size of " << newWidth << "x" << newHeight << " in resizeImage().\n";
+		exit(1);
+	}
+
+	if (keepAspectRatio) {
+		// Resize the image without changing its aspect ratio, by cropping off the edges and enlarging the middle section.
+		cv::Rect r;
+		float origAspect = (origWidth / (float)origHeight);	// input aspect ratio
+		float newAspect = (newWidth / (float)newHeight);	// output aspect ratio
+		if (origAspect > newAspect) {	// crop width to be origHeight * newAspect
+			int tw = (origHeight * newWidth) / newHeight;
+			r = cv::Rect((origWidth - tw)/2, 0, tw, origHeight);
+		}
+		else {	// crop height to be origWidth / newAspect
+			int th = (origWidth * newHeight) / newWidth;
+			r = cv::Rect(0, (origHeight - th)/2, origWidth, th);
+		}
+		// Just look at the cropped region instead of copying it, since the aspect ratio is correct now.
+		img = img(r);
+	}
+
+	// Scale the image to the new dimensions, even if the aspect ratio will be changed.
+	if (newWidth > img.cols && newHeight > img.rows) {
+		// Make the image larger
+		cv::resize(img, dst, newSize, 0, 0, cv::INTER_LINEAR);	// INTER_CUBIC or INTER_LINEAR is good for enlarging
+	}
+	else {
+		// Make the image smaller
+		cv::resize(img, dst, newSize, 0, 0, cv::INTER_AREA);	// INTER_AREA is good for shrinking / decimation, but bad at enlarging.
+	}
+}
+
 // Creates a new image copy that is of a desired size. The aspect ratio will be kept constant if 'keepAspectRatio' is true,
 // by cropping undesired parts so that only pixels of the original image are shown, instead of adding extra blank space.
 // Remember to free the new image later.
@@ -1048,6 +3075,37 @@ IplImage* resizeImage(const IplImage *origImg, int newWidth, int newHeight, bool
 	return outImg;
 }
 
+// Rotate the image clockwise and possibly scale the image. Use 'mapRotatedImagePoint()' to map pixels from the src to dst image.
+void imageutils::rotateImage(cv::InputArray src, cv::OutputArray dst, float angleDegrees, float scale)
+{
+	cv::Mat img = src.getMat();
+	// Create a map_matrix, where the left 2x2 matrix is the transform and the right 2x1 is the dimensions.
+	float m[6];
+	CvMat M = cvMat(2, 3, CV_32F, m);
+	int w = img.cols;
+	int h = img.rows;
+
+	float divscale = 1.0f;
+	if (scale != 1.0f && scale > 1e-20)
+		divscale = 1.0f / scale;
+	float angleRadians = angleDegrees * (CV_PI / 180.0f);
+	m[0] = (float)(cos(angleRadians) * divscale);
+	m[1] = (float)(sin(angleRadians) * divscale);
+	m[3] = -m[1];
+	m[4] = m[0];
+	m[2] = w*0.5f;  
+	m[5] = h*0.5f;  
+
+	// Make a spare image for the result
+	dst.create(cvRound(scale * h), cvRound(scale * w), img.type());
+	cv::Mat imageRotated = dst.getMat();
+
+	// Transform the image, using IplImage views of the Mats since there is no C++ version of cvGetQuadrangleSubPix().
+	IplImage iplSrc = toIplImage(img);
+	IplImage iplDst = toIplImage(imageRotated);
+	cvGetQuadrangleSubPix( &iplSrc, &iplDst, &M);
+}
+
 // Rotate the image clockwise and possibly scale the image. Use 'mapRotatedImagePoint()' to map pixels from the src to dst image.
 IplImage *rotateImage(const IplImage *src, float angleDegrees, float scale)
 {
@@ -1103,6 +3161,18 @@ CvPoint2D32f mapRotatedImagePoint(const CvPoint2D32f pointOrig, const IplImage *
 // Image utility functions
 //------------------------------------------------------------------------------
 
+// Do Bilateral Filtering to smooth the image noise but preserve the edges.
+// A smoothness of 5 is very little filtering, and 100 is very high filtering.
+void imageutils::smoothImageBilateral(cv::InputArray src, cv::OutputArray dst, float smoothness)
+{
+	// Do bilateral fitering on the input image, the same way as cvSmooth(CV_BILATERAL).
+	cv::Mat imageSmooth;
+	cv::bilateralFilter( src, imageSmooth, 5, smoothness, smoothness, cv::BORDER_REPLICATE );
+
+	// Mix the smoothed image with the original image
+	cv::addWeighted( src, 0.70, imageSmooth, 0.70, 0.0, dst );
+}
+
 // Do Bilateral Filtering to smooth the image noise but preserve the edges.
 // A smoothness of 5 is very little filtering, and 100 is very high filtering.
 // Remember to free the returned image.
@@ -1261,7 +3331,7 @@ int saveImage(const char *filename, const IplImage *image)
 	if (image8Bit)
 		cvConvert(image, image8Bit);	// Convert to an 8-bit image instead of potentially 16,24,32 or 64bit image.
 	if (image8Bit)
-		ret = cvSaveImage(filename, image8Bit);
+		ret = cv::imwrite(filename, cv::cvarrToMat(image8Bit)) ? 1 : 0;
 	if (image8Bit)
 		cvReleaseImage(&image8Bit);
 	return ret;
@@ -1326,7 +3396,7 @@ void saveFloatImage(const char *filename, const IplImage *srcImg)
 {
 	cout << "Saving Float Image '" << filename << "' (" << srcImg->width << "," << srcImg->height << "). " << endl;
 	IplImage *byteImg = convertFloatImageToUcharImage(srcImg);
-	cvSaveImage(filename, byteImg);
+	cv::imwrite(filename, cv::cvarrToMat(byteImg));
 	cvReleaseImage(&byteImg);
 	//cout << "done saveFloatImage()" << endl;
 }
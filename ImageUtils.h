@@ -28,55 +28,364 @@ typedef struct {
 	uchar Val;
 } PixelHSV;
 
+// A range of HSV values, for thresholding an image. All the limits are inclusive.
+typedef struct {
+	uchar minHue, maxHue;	// If minHue > maxHue, the range wraps around through red (eg: 240 to 15).
+	uchar minSat, maxSat;
+	uchar minVal, maxVal;
+} RangeHSV;
+
+// The number of pixels with each Hue, Saturation & Value. Can be shown with showIntGraph().
+typedef struct {
+	int hue[256];
+	int sat[256];
+	int val[256];
+} HistogramHSV;
+
+// A color transform for convertImageColorMatrix(), where each 8-bit output channel is
+// m[out][0] * in[0] + m[out][1] * in[1] + m[out][2] * in[2] + offset[out], rounded & clipped to 0..255,
+// and in[] are the 8-bit input channels in the order they are stored (ie: B,G,R for OpenCV color images).
+typedef struct {
+	float m[3][3];
+	float offset[3];
+} ColorMatrix;
+
+// The standard color matrices given by getColorMatrix(). The conversions from RGB take B,G,R images,
+// and the conversions to RGB give B,G,R images.
+typedef enum {
+	COLOR_MATRIX_RGB_TO_YIQ,		// Same as convertImageRGBtoYIQ().
+	COLOR_MATRIX_YIQ_TO_RGB,		// Same as convertImageYIQtoRGB().
+	COLOR_MATRIX_RGB_TO_YCBCR601,	// Studio range YCbCr of SD video (ITU-R BT.601), with Y from 16 to 235 and Cb,Cr from 16 to 240.
+	COLOR_MATRIX_YCBCR601_TO_RGB,
+	COLOR_MATRIX_RGB_TO_YCBCR709,	// Studio range YCbCr of HD video (ITU-R BT.709).
+	COLOR_MATRIX_YCBCR709_TO_RGB,
+	COLOR_MATRIX_RGB_TO_YUV,		// Analog PAL YUV, with Y from 0 to 255 and U,V centered on 127.5 like YIQ.
+	COLOR_MATRIX_YUV_TO_RGB
+} ColorMatrixType;
+
+// A 3D lookup table of a color transform, that can replace a whole chain of per-pixel color conversions with a single pass.
+// Create it with createColorLUT() or createColorLUTFromLattice(), and free it with releaseColorLUT().
+typedef struct ColorLUT ColorLUT;
+
+// The biggest number of grid points along each channel of a ColorLUT. Typical sizes are 17, 33 & 65.
+#define COLOR_LUT_MAX_SIZE 65
+
+// How to interpolate between the grid points of a ColorLUT.
+typedef enum {
+	COLOR_LUT_TRILINEAR,	// Between the 8 corners of the grid cell.
+	COLOR_LUT_TETRAHEDRAL	// Between 4 corners of the grid cell. Faster, and keeps greys sharper.
+} ColorLUTInterpolation;
+
+// The layouts of YUV 4:2:0 frames from video decoders, stored in a single 8-bit 1-channel image that is 'width' pixels
+// wide and height*3/2 rows high, with the chroma rows below the Y rows (the same layout that cv::cvtColor() takes).
+typedef enum {
+	YUV420_I420,	// A U plane then a V plane, each at half the width & height.
+	YUV420_YV12,	// A V plane then a U plane, each at half the width & height.
+	YUV420_NV12,	// A single plane of interleaved U,V pairs at half the height.
+	YUV420_NV21		// A single plane of interleaved V,U pairs at half the height.
+} YUV420Format;
+
+// The levels of SIMD kernels of the color conversions, from slowest to fastest. The fastest level that the CPU
+// supports is picked when ImageUtils is loaded, and can be limited by setting the IMAGEUTILS_CPU environment
+// variable to C, SSE4.1, AVX2 or AVX512.
+typedef enum {
+	SIMD_LEVEL_NONE,	// Plain C++ kernels, built for the baseline CPU (SSE2 on x86-64).
+	SIMD_LEVEL_SSE41,
+	SIMD_LEVEL_AVX2,
+	SIMD_LEVEL_AVX512	// Needs AVX-512 F, BW, VL & DQ.
+} SimdLevel;
+
+// How drawFloatGraphDecimated() shrinks an array to fit the width of the graph.
+typedef enum {
+	GRAPH_DECIMATE_MINMAX,	// Draw the range of the values within each column, so that no peaks are lost.
+	GRAPH_DECIMATE_LTTB		// Draw a line through the value of each column that best keeps the shape of the graph.
+} GraphDecimation;
+
+// A live graph of a stream of values, that scrolls to the left as values are added.
+// Create it with createScrollingGraph(), and free it with releaseScrollingGraph().
+typedef struct ScrollingGraph ScrollingGraph;
+
+// The state of drawing graphs for one thread or plot: a reusable canvas, its colors & its range of values.
+// Create it with createGraphContext(), and free it with releaseGraphContext().
+typedef struct GraphContext GraphContext;
+
+// Saves graph images to files on its own thread, instead of showing them in a window.
+// Create it with createGraphWriter(), and free it with releaseGraphWriter().
+typedef struct GraphWriter GraphWriter;
+
+// The kinds of files that a GraphWriter saves.
+typedef enum {
+	GRAPH_WRITER_PNG,		// A numbered PNG file for each image.
+	GRAPH_WRITER_MJPEG		// A single Motion-JPEG video (eg: an .avi file) of all the images.
+} GraphWriterFormat;
+
+// A color transform to bake into a ColorLUT, that converts a row of 'width' 8-bit 3-channel pixels from src to dst.
+typedef void (*ColorLUTFunc)(const uchar *src, uchar *dst, int width, void *userData);
+
 //------------------------------------------------------------------------------
 // Graphing functions
 //------------------------------------------------------------------------------
 
 // Draw the graph of an array of floats into imageDst or a new image.
+// The values are scaled to fit the graph, unless maxValue is bigger than minValue, to show that range of values instead.
+// Remember to free the newly drawn image, even if imageDst isnt given.
+IplImage* drawFloatGraph(const float *arraySrc, int nArrayLength, IplImage *imageDst DEFAULT(0), float minValue DEFAULT(0),
+	float maxValue DEFAULT(0));
+
+// Draw the graph of an array of ints into imageDst or a new image.
+// The values are scaled to fit the graph, unless maxValue is bigger than minValue, to show that range of values instead.
 // Remember to free the newly drawn image, even if imageDst isnt given.
-IplImage* drawFloatGraph(const float *arraySrc, int nArrayLength, IplImage *imageDst DEFAULT(0));
+IplImage* drawIntGraph(const int *arraySrc, int nArrayLength, IplImage *imageDst DEFAULT(0), float minValue DEFAULT(0),
+	float maxValue DEFAULT(0));
 
 // Draw the graph of an array of uchars into imageDst or a new image.
+// The values are scaled to fit the graph, unless maxValue is bigger than minValue, to show that range of values instead.
 // Remember to free the newly drawn image, even if imageDst isnt given.
-IplImage* drawUCharGraph(const uchar *arraySrc, int nArrayLength, IplImage *imageDst DEFAULT(0));
+IplImage* drawUCharGraph(const uchar *arraySrc, int nArrayLength, IplImage *imageDst DEFAULT(0), float minValue DEFAULT(0),
+	float maxValue DEFAULT(0));
 
 // Display a graph of the given float array.
 // If background is provided, it will be drawn into, for combining multiple graphs using drawFloatGraph().
 // Set delay_ms to 0 if you want to wait forever until a keypress, or set it to 1 if you want it to delay just 1 millisecond.
-void showFloatGraph(const char *name, const float *arraySrc, int nArrayLength, int delay_ms DEFAULT(500), IplImage *background DEFAULT(0));
+void showFloatGraph(const char *name, const float *arraySrc, int nArrayLength, int delay_ms DEFAULT(500), IplImage *background DEFAULT(0),
+	float minValue DEFAULT(0), float maxValue DEFAULT(0));
 
 // Display a graph of the given int array.
 // If background is provided, it will be drawn into, for combining multiple graphs using drawIntGraph().
 // Set delay_ms to 0 if you want to wait forever until a keypress, or set it to 1 if you want it to delay just 1 millisecond.
-void showIntGraph(const char *name, const int *arraySrc, int nArrayLength, int delay_ms DEFAULT(500), IplImage *background DEFAULT(0));
+void showIntGraph(const char *name, const int *arraySrc, int nArrayLength, int delay_ms DEFAULT(500), IplImage *background DEFAULT(0),
+	float minValue DEFAULT(0), float maxValue DEFAULT(0));
 
 // Display a graph of the given unsigned char array.
 // If background is provided, it will be drawn into, for combining multiple graphs using drawUCharGraph().
 // Set delay_ms to 0 if you want to wait forever until a keypress, or set it to 1 if you want it to delay just 1 millisecond.
-void showUCharGraph(const char *name, const uchar *arraySrc, int nArrayLength, int delay_ms DEFAULT(500), IplImage *background DEFAULT(0));
+// Pass a fixed range such as 0 to 255 to skip finding the range, eg: for per-frame histograms.
+void showUCharGraph(const char *name, const uchar *arraySrc, int nArrayLength, int delay_ms DEFAULT(500), IplImage *background DEFAULT(0),
+	float minValue DEFAULT(0), float maxValue DEFAULT(0));
+
+// Create a GraphContext, that draws graphs into its own canvas, with its own colors & range of values, so that graphs can
+// be drawn in parallel (eg: dozens of metrics with TBB) without any locks, by giving each thread or plot its own context.
+// The other draw functions can also be called from several threads, since each thread gets its own colors, but the
+// show*Graph() functions use highgui windows, so only call them from one thread.
+// The graphs show minValue to maxValue, or are scaled to fit the values if maxValue isn't bigger than minValue.
+// Remember to free it with releaseGraphContext().
+GraphContext* createGraphContext(float minValue DEFAULT(0), float maxValue DEFAULT(0));
+
+// Set the range of values that the graphs of a GraphContext show, or scale them to fit the values if maxValue <= minValue.
+void setGraphContextRange(GraphContext *context, float minValue, float maxValue);
+
+// Draw the graph of an array into the canvas of a GraphContext, that is only reallocated when the width changes.
+// If combine is true and the canvas is the same width, the graph is drawn over the last graph in the next color,
+// otherwise the canvas is cleared and the colors start again, so each graph always looks the same.
+// The image belongs to the context and is overwritten by the next graph, so don't free it.
+const IplImage* drawFloatGraphInto(const float *arraySrc, int nArrayLength, GraphContext *context, bool combine DEFAULT(false));
+const IplImage* drawIntGraphInto(const int *arraySrc, int nArrayLength, GraphContext *context, bool combine DEFAULT(false));
+const IplImage* drawUCharGraphInto(const uchar *arraySrc, int nArrayLength, GraphContext *context, bool combine DEFAULT(false));
+
+// Free a GraphContext and its canvas, and set *context to NULL.
+void releaseGraphContext(GraphContext **context);
+
+// Draw the graph of a long array of floats (eg: millions of samples from a recording) into imageDst or a new image that is
+// only 'width' pixels wide (plus the border), by decimating the values within each column. The min & max of each column
+// are found in a single pass over the array with SIMD & in parallel, and only 'width' lines are drawn. LTTB keeps the shape
+// of smooth signals better, but picks its values in another pass that is single-threaded.
+// minValue & maxValue give a fixed range like drawFloatGraph().
+// Remember to free the newly drawn image, even if imageDst isnt given.
+IplImage* drawFloatGraphDecimated(const float *arraySrc, int nArrayLength, int width DEFAULT(1000),
+	GraphDecimation decimation DEFAULT(GRAPH_DECIMATE_MINMAX), IplImage *imageDst DEFAULT(0), float minValue DEFAULT(0),
+	float maxValue DEFAULT(0));
+
+// Display a decimated graph of the given long float array, 'width' pixels wide.
+// If background is provided, it will be drawn into, for combining multiple graphs using drawFloatGraphDecimated().
+// Set delay_ms to 0 if you want to wait forever until a keypress, or set it to 1 if you want it to delay just 1 millisecond.
+void showFloatGraphDecimated(const char *name, const float *arraySrc, int nArrayLength, int width DEFAULT(1000),
+	GraphDecimation decimation DEFAULT(GRAPH_DECIMATE_MINMAX), int delay_ms DEFAULT(500), IplImage *background DEFAULT(0),
+	float minValue DEFAULT(0), float maxValue DEFAULT(0));
+
+// Create a scrolling graph of the last nSamples values, one pixel apart, in a plot 'height' pixels high, eg: to show the
+// time taken by each video frame. Adding a value only draws its own column, so it just takes a few microseconds.
+// If maxValue is positive the plot always shows 0 to maxValue, otherwise it scales itself to fit the values shown.
+// Remember to free it with releaseScrollingGraph().
+ScrollingGraph* createScrollingGraph(int nSamples DEFAULT(300), int height DEFAULT(200), float maxValue DEFAULT(0));
+
+// Add a value to the right end of the graph, scrolling the oldest value off the left end once the graph is full.
+void addScrollingGraphValue(ScrollingGraph *graph, float value);
+
+// Get the image of the graph, with its values in order from the oldest to the newest.
+// Since every column moves left as the graph scrolls, this copies the whole plot (nSamples x height pixels) when values
+// have been added since the last call, so call it once per displayed frame rather than once per value.
+// The image belongs to the graph and is overwritten by the next call, so don't free it.
+const IplImage* getScrollingGraphImage(ScrollingGraph *graph);
+
+// Display the graph in a window, then wait delay_ms for a keypress (0 waits forever).
+// It only waits once, so call it with a delay of 1 from a video loop.
+void showScrollingGraph(const char *name, ScrollingGraph *graph, int delay_ms DEFAULT(1));
+
+// Free a ScrollingGraph, and set *graph to NULL.
+void releaseScrollingGraph(ScrollingGraph **graph);
+
+// Create a GraphWriter, that saves graph images on its own thread, so that batch jobs, worker threads & headless servers
+// can save graphs of their metrics without opening a window or waiting in cvWaitKey() like the show*Graph() functions.
+// For PNG files, path is a pattern of the filenames with a single %d or %0Nd for the image number, eg:
+// "graphs/latency_%05d.png", with any other % written as %%.
+// For MJPEG, path is the video file, that plays at fps images per second, at the size of the first image.
+// Up to queueSize images wait to be saved, in canvases that are reused. When they are all waiting, writeGraphImage()
+// waits for the oldest one to be saved, or if dropWhenFull is true, replaces it so that the caller never waits.
+// It prints an error & returns NULL if the path, format or queueSize is bad, including a bad PNG pattern.
+// Remember to free it with releaseGraphWriter().
+GraphWriter* createGraphWriter(const char *path, GraphWriterFormat format DEFAULT(GRAPH_WRITER_PNG), double fps DEFAULT(30),
+	int queueSize DEFAULT(8), bool dropWhenFull DEFAULT(false));
+
+// Queue a copy of a graph image (eg: from drawFloatGraph() or getScrollingGraphImage()) to be saved by the GraphWriter.
+// It just copies the pixels, so imageGraph can be freed or drawn over straight away.
+// Only call it from one thread at a time, eg: give each thread its own GraphWriter.
+void writeGraphImage(GraphWriter *writer, const IplImage *imageGraph);
+
+// Get the number of images that were dropped because the GraphWriter was full, when it was created with dropWhenFull.
+int getGraphWriterDropped(const GraphWriter *writer);
+
+// Save the images still waiting, then free the GraphWriter and set *writer to NULL.
+void releaseGraphWriter(GraphWriter **writer);
 
 //------------------------------------------------------------------------------
 // Color conversion functions
+// The HSV & YIQ conversions also take 16-bit & float 3-channel images, giving images of the same depth. 16-bit images
+// use the full range of 0 to 65535. Float images hold B,G,R and H,S,V from 0.0 to 1.0, and Y from 0.0 to 1.0 with
+// I from -0.5957 to +0.5957 and Q from -0.5226 to +0.5226. The other conversions only take 8-bit images.
 //------------------------------------------------------------------------------
 
+// Limit the color conversions to SIMD kernels up to maxLevel, eg: to compare the speed & accuracy of each level.
+// Levels that the CPU doesn't support are never used. Only affects the conversions started afterwards.
+// It can't raise the limit set by the IMAGEUTILS_CPU environment variable ("C", "SSE4.1", "AVX2" or "AVX512").
+void setMaxSimdLevel(SimdLevel maxLevel);
+
+// Get the level of SIMD kernels that the color conversions use, that is the fastest this CPU supports up to both
+// IMAGEUTILS_CPU and setMaxSimdLevel().
+SimdLevel getSimdLevel(void);
+
 // Create an RGB image from the YIQ image using an approximation of NTSC conversion(ref: "YIQ" Wikipedia page).
 // Remember to free the generated RGB image.
 IplImage* convertImageYIQtoRGB(const IplImage *imageYIQ);
 
+// Same as convertImageYIQtoRGB(), but converts blocks of at least grainRows rows in parallel using TBB.
+// Remember to free the generated RGB image.
+IplImage* convertImageYIQtoRGBParallel(const IplImage *imageYIQ, int grainRows DEFAULT(16));
+
+// Same as convertImageYIQtoRGB(), but writes into *imageRGB, that is only (re)allocated when it is NULL or the wrong size,
+// so it doesn't allocate anything when called on every frame. Set grainRows to convert blocks of rows in parallel.
+void convertImageYIQtoRGBInto(const IplImage *imageYIQ, IplImage **imageRGB, int grainRows DEFAULT(0));
+
 // Create a YIQ image from the RGB image using an approximation of NTSC conversion(ref: "YIQ" Wikipedia page).
 // Remember to free the generated YIQ image.
 IplImage* convertImageRGBtoYIQ(const IplImage *imageRGB);
 
+// Same as convertImageRGBtoYIQ(), but converts blocks of at least grainRows rows in parallel using TBB.
+// Remember to free the generated YIQ image.
+IplImage* convertImageRGBtoYIQParallel(const IplImage *imageRGB, int grainRows DEFAULT(16));
+
+// Same as convertImageRGBtoYIQ(), but writes into *imageYIQ, that is only (re)allocated when it is NULL or the wrong size,
+// so it doesn't allocate anything when called on every frame. Set grainRows to convert blocks of rows in parallel.
+void convertImageRGBtoYIQInto(const IplImage *imageRGB, IplImage **imageYIQ, int grainRows DEFAULT(0));
+
+// Same as convertImageRGBtoYIQ(), but writes separate 8-bit Y, I & Q planes instead of an interleaved image.
+// Pass NULL for the planes you don't need, eg: just imageY for a fast greyscale image.
+// The planes are only (re)allocated when they are NULL or the wrong size. Set grainRows to convert blocks of rows in parallel.
+void convertImageRGBtoYIQPlanes(const IplImage *imageRGB, IplImage **imageY, IplImage **imageI, IplImage **imageQ,
+	int grainRows DEFAULT(0));
+
 // Create an RGB image from the HSV image using the full 8-bits, since OpenCV only allows Hues up to 180 instead of 255.
 // ref: "http://cs.haifa.ac.il/hagit/courses/ist/Lectures/Demos/ColorApplet2/t_convert.html"
 // Remember to free the generated RGB image.
 IplImage* convertImageHSVtoRGB(const IplImage *imageHSV);
 
+// Same as convertImageHSVtoRGB(), but converts blocks of at least grainRows rows in parallel using TBB.
+// Remember to free the generated RGB image.
+IplImage* convertImageHSVtoRGBParallel(const IplImage *imageHSV, int grainRows DEFAULT(16));
+
+// Same as convertImageHSVtoRGB(), but writes into *imageRGB, that is only (re)allocated when it is NULL or the wrong size,
+// so it doesn't allocate anything when called on every frame. Set grainRows to convert blocks of rows in parallel.
+void convertImageHSVtoRGBInto(const IplImage *imageHSV, IplImage **imageRGB, int grainRows DEFAULT(0));
+
 // Create a HSV image from the RGB image using the full 8-bits, since OpenCV only allows Hues up to 180 instead of 255.
 // ref: "http://cs.haifa.ac.il/hagit/courses/ist/Lectures/Demos/ColorApplet2/t_convert.html"
 // Remember to free the generated HSV image.
 IplImage* convertImageRGBtoHSV(const IplImage *imageRGB);
 
+// Same as convertImageRGBtoHSV(), but converts blocks of at least grainRows rows in parallel using TBB.
+// Remember to free the generated HSV image.
+IplImage* convertImageRGBtoHSVParallel(const IplImage *imageRGB, int grainRows DEFAULT(16));
+
+// Same as convertImageRGBtoHSV(), but writes into *imageHSV, that is only (re)allocated when it is NULL or the wrong size,
+// so it doesn't allocate anything when called on every frame. Set grainRows to convert blocks of rows in parallel.
+void convertImageRGBtoHSVInto(const IplImage *imageRGB, IplImage **imageHSV, int grainRows DEFAULT(0));
+
+// Same as convertImageRGBtoHSV(), but writes separate 8-bit H, S & V planes instead of an interleaved image.
+// Pass NULL for the planes you don't need. Getting just imageV is much faster, since it is just the max of B,G,R.
+// The planes are only (re)allocated when they are NULL or the wrong size. Set grainRows to convert blocks of rows in parallel.
+void convertImageRGBtoHSVPlanes(const IplImage *imageRGB, IplImage **imageH, IplImage **imageS, IplImage **imageV,
+	int grainRows DEFAULT(0));
+
+// Convert the BGR image to HSV (like convertImageRGBtoHSV()) and threshold it by range, all in a single pass over the
+// image without creating an HSV image. *imageMask gets 255 for the pixels within range and 0 elsewhere, and is only
+// (re)allocated when it is NULL or the wrong size. If histogram isn't NULL, it gets the H, S & V histograms of the whole image.
+// Set grainRows to do blocks of rows in parallel using TBB.
+void convertImageRGBtoHSVMask(const IplImage *imageRGB, const RangeHSV *range, IplImage **imageMask,
+	HistogramHSV *histogram DEFAULT(0), int grainRows DEFAULT(0));
+
+// Get one of the standard color matrices, such as RGB to YCbCr, for convertImageColorMatrix().
+ColorMatrix getColorMatrix(ColorMatrixType type);
+
+// Get the color matrix that undoes the given one, eg: to convert back to RGB with your own matrix.
+ColorMatrix invertColorMatrix(const ColorMatrix *matrix);
+
+// Create a new 8-bit image by transforming each pixel of the 8-bit 3-channel image with a color matrix.
+// Uses 16-bit fixed point math, which can round differently by 1 compared to floats. Set useFloat to use floats instead,
+// which is slower. Matrices with coefficients of 8 or more always use floats. Remember to free the generated image.
+IplImage* convertImageColorMatrix(const IplImage *imageSrc, const ColorMatrix *matrix, bool useFloat DEFAULT(false));
+
+// Same as convertImageColorMatrix(), but writes into *imageDst, that is only (re)allocated when it is NULL or the wrong size.
+// Set grainRows to convert blocks of rows in parallel.
+void convertImageColorMatrixInto(const IplImage *imageSrc, IplImage **imageDst, const ColorMatrix *matrix,
+	bool useFloat DEFAULT(false), int grainRows DEFAULT(0));
+
+// Create an 8-bit 3-channel image containing every grid point of a size^3 ColorLUT, to bake a color transform into a LUT.
+// Convert the image with any functions that work on each pixel by itself (eg: convertImageRGBtoHSV(), edit the HSV
+// image, then convertImageHSVtoRGB()), and pass the result to createColorLUTFromLattice().
+// The image is 'size' pixels wide and size*size pixels high. Remember to free it.
+IplImage* createColorLUTLattice(int size);
+
+// Create a ColorLUT from the converted image of createColorLUTLattice(). Remember to free it with releaseColorLUT().
+ColorLUT* createColorLUTFromLattice(const IplImage *imageLattice);
+
+// Create a ColorLUT with 'size' grid points along each channel (up to COLOR_LUT_MAX_SIZE), by calling func on every
+// grid point, one row of 'size' pixels at a time. Remember to free it with releaseColorLUT().
+ColorLUT* createColorLUT(int size, ColorLUTFunc func, void *userData DEFAULT(0));
+
+// Free a ColorLUT, and set *lut to NULL.
+void releaseColorLUT(ColorLUT **lut);
+
+// Create a new 8-bit 3-channel image by interpolating each pixel of the 8-bit 3-channel image in a ColorLUT.
+// Remember to free the generated image.
+IplImage* convertImageColorLUT(const IplImage *imageSrc, const ColorLUT *lut,
+	ColorLUTInterpolation interpolation DEFAULT(COLOR_LUT_TETRAHEDRAL));
+
+// Same as convertImageColorLUT(), but writes into *imageDst, that is only (re)allocated when it is NULL or the wrong size.
+// Set grainRows to convert blocks of rows in parallel.
+void convertImageColorLUTInto(const IplImage *imageSrc, IplImage **imageDst, const ColorLUT *lut,
+	ColorLUTInterpolation interpolation DEFAULT(COLOR_LUT_TETRAHEDRAL), int grainRows DEFAULT(0));
+
+// Convert a YUV 4:2:0 frame from a video decoder straight to HSV (like convertImageRGBtoHSV()), converting small blocks of
+// pixels to BGR on the way instead of creating a whole BGR image. yuvToRGB is the color matrix of the video, such as
+// getColorMatrix(COLOR_MATRIX_YCBCR709_TO_RGB) for HD video, or NULL for SD video (BT.601). If chromaResolution is true,
+// the HSV image is at the resolution of the chroma (half the width & height), using the average Y of each 2x2 block.
+// *imageHSV is only (re)allocated when it is NULL or the wrong size. Set grainRows to convert blocks of rows in parallel.
+void convertImageYUV420toHSVInto(const IplImage *imageYUV, YUV420Format format, IplImage **imageHSV,
+	const ColorMatrix *yuvToRGB DEFAULT(0), bool chromaResolution DEFAULT(false), int grainRows DEFAULT(0));
+
+// Same as convertImageYUV420toHSVInto(), but converts to YIQ (like convertImageRGBtoYIQ()).
+void convertImageYUV420toYIQInto(const IplImage *imageYUV, YUV420Format format, IplImage **imageYIQ,
+	const ColorMatrix *yuvToRGB DEFAULT(0), bool chromaResolution DEFAULT(false), int grainRows DEFAULT(0));
+
 //------------------------------------------------------------------------------
 // 2D Point functions
 //------------------------------------------------------------------------------
@@ -198,4 +507,26 @@ void printImageInfo(const IplImage *image_tile, const char *label DEFAULT(0));
 }
 #endif
 
+//------------------------------------------------------------------------------
+// C++ versions of the color conversion functions, that write into a cv::Mat.
+// The Mat is only reallocated when it has the wrong size or type, so they don't allocate anything when called on
+// every frame. Set grainRows to convert blocks of rows in parallel using TBB.
+//------------------------------------------------------------------------------
+#if defined (__cplusplus)
+#include <opencv2/core.hpp>
+
+void convertImageYIQtoRGBInto(const cv::Mat &imageYIQ, cv::Mat &imageRGB, int grainRows = 0);
+void convertImageRGBtoYIQInto(const cv::Mat &imageRGB, cv::Mat &imageYIQ, int grainRows = 0);
+void convertImageHSVtoRGBInto(const cv::Mat &imageHSV, cv::Mat &imageRGB, int grainRows = 0);
+void convertImageRGBtoHSVInto(const cv::Mat &imageRGB, cv::Mat &imageHSV, int grainRows = 0);
+void convertImageColorMatrixInto(const cv::Mat &imageSrc, cv::Mat &imageDst, const ColorMatrix *matrix, bool useFloat = false,
+	int grainRows = 0);
+void convertImageColorLUTInto(const cv::Mat &imageSrc, cv::Mat &imageDst, const ColorLUT *lut,
+	ColorLUTInterpolation interpolation = COLOR_LUT_TETRAHEDRAL, int grainRows = 0);
+void convertImageYUV420toHSVInto(const cv::Mat &imageYUV, YUV420Format format, cv::Mat &imageHSV, const ColorMatrix *yuvToRGB = 0,
+	bool chromaResolution = false, int grainRows = 0);
+void convertImageYUV420toYIQInto(const cv::Mat &imageYUV, YUV420Format format, cv::Mat &imageYIQ, const ColorMatrix *yuvToRGB = 0,
+	bool chromaResolution = false, int grainRows = 0);
+#endif
+
 #endif	// NV_IMAGE_UTILS_H
\ No newline at end of file
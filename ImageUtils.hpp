@@ -0,0 +1,174 @@
+/**		ImageUtils.hpp:		C++ interface to ImageUtils, using cv::Mat, cv::InputArray & cv::OutputArray.
+ * The color conversions share the same row kernels as the C functions in ImageUtils.h, so both give exactly the same results.
+ * The image transforming functions are separate versions written with the cv:: API, that aren't guaranteed to give
+ * exactly the same pixels as the C functions.
+ * The view functions below just wrap the pixels of an image in another kind of header, so code using the old
+ * IplImage / CvMat types and code using cv::Mat can pass images to each other without copying any pixels.
+ **/
+
+#ifndef NV_IMAGE_UTILS_HPP
+#define NV_IMAGE_UTILS_HPP
+
+#include <memory>
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/core_c.h>
+#include <opencv2/imgproc.hpp>		// for CV_RGB, used by ImageUtils.h
+
+#include "ImageUtils.h"		// for the types shared with the C functions, such as RangeHSV
+
+
+namespace imageutils
+{
+
+//------------------------------------------------------------------------------
+// Views between the C & C++ image types. None of these copy or own the pixels, so the original image
+// must stay alive (and not be reallocated) while the view is used.
+//------------------------------------------------------------------------------
+
+// View an IplImage (including its ROI) as a cv::Mat.
+inline cv::Mat toMat(const IplImage *image)
+{
+	return cv::cvarrToMat(image);
+}
+
+// View a CvMat as a cv::Mat.
+inline cv::Mat toMat(const CvMat *mat)
+{
+	return cv::cvarrToMat(mat);
+}
+
+// View a cv::Mat as an IplImage, eg: to pass it to the C functions in ImageUtils.h.
+inline IplImage toIplImage(const cv::Mat &mat)
+{
+	return cvIplImage(mat);
+}
+
+// View a cv::Mat as a CvMat.
+inline CvMat toCvMat(const cv::Mat &mat)
+{
+	return cvMat(mat);
+}
+
+// Owns an IplImage returned by the C functions, and calls cvReleaseImage() on it automatically.
+// Use toMat(ptr.get()) to work on it as a cv::Mat without copying it.
+struct IplImageDeleter {
+	void operator()(IplImage *image) const { cvReleaseImage(&image); }
+};
+typedef std::unique_ptr<IplImage, IplImageDeleter> IplImagePtr;
+
+// Owns a ColorLUT, and calls releaseColorLUT() on it automatically.
+struct ColorLUTDeleter {
+	void operator()(ColorLUT *lut) const { releaseColorLUT(&lut); }
+};
+typedef std::unique_ptr<ColorLUT, ColorLUTDeleter> ColorLUTPtr;
+
+// Owns a ScrollingGraph, and calls releaseScrollingGraph() on it automatically.
+// Use toMat(getScrollingGraphImage(ptr.get())) to get its image as a cv::Mat without copying it.
+struct ScrollingGraphDeleter {
+	void operator()(ScrollingGraph *graph) const { releaseScrollingGraph(&graph); }
+};
+typedef std::unique_ptr<ScrollingGraph, ScrollingGraphDeleter> ScrollingGraphPtr;
+
+// Owns a GraphContext, and calls releaseGraphContext() on it automatically.
+struct GraphContextDeleter {
+	void operator()(GraphContext *context) const { releaseGraphContext(&context); }
+};
+typedef std::unique_ptr<GraphContext, GraphContextDeleter> GraphContextPtr;
+
+// Owns a GraphWriter, and calls releaseGraphWriter() on it automatically, that saves any images still waiting.
+struct GraphWriterDeleter {
+	void operator()(GraphWriter *writer) const { releaseGraphWriter(&writer); }
+};
+typedef std::unique_ptr<GraphWriter, GraphWriterDeleter> GraphWriterPtr;
+
+//------------------------------------------------------------------------------
+// Color conversion functions. dst is only reallocated if it has the wrong size or type.
+// Set grainRows to convert blocks of rows in parallel using TBB.
+// The conversions from RGB also accept images in any channel order, with a separate kernel compiled for each, so eg:
+// BGRA screen captures or 16-bit camera frames don't need converting first.
+// The HSV & YIQ conversions accept 8-bit, 16-bit or float images, and give 8-bit output unless dstDepth is CV_16U or
+// CV_32F (or -1 for the same depth as src). 16-bit images use the full range of 0 to 65535 like 8-bit images use 0 to 255.
+// Float images hold the actual values: B,G,R and H,S,V from 0.0 to 1.0 (with the Hue as a fraction of the color circle),
+// and Y from 0.0 to 1.0 with I & Q signed around 0. Anything other than 8-bit in & out uses the float SIMD kernels.
+// The other conversions only take 8-bit 3-channel images.
+//------------------------------------------------------------------------------
+
+// The order of the color channels of an image. OpenCV normally uses BGR.
+enum ChannelOrder {
+	ORDER_BGR,
+	ORDER_RGB,
+	ORDER_BGRA,
+	ORDER_RGBA
+};
+
+// Convert a BGR image to HSV using the full 8-bits, since OpenCV only allows Hues up to 180 instead of 255.
+void convertRGBtoHSV(cv::InputArray src, cv::OutputArray dst, int grainRows = 0, ChannelOrder order = ORDER_BGR,
+	int dstDepth = CV_8U);
+
+// Convert an HSV image (with Hues up to 255) to BGR.
+void convertHSVtoRGB(cv::InputArray src, cv::OutputArray dst, int grainRows = 0, int dstDepth = CV_8U);
+
+// Convert a BGR image to YIQ using an approximation of NTSC conversion (ref: "YIQ" Wikipedia page).
+void convertRGBtoYIQ(cv::InputArray src, cv::OutputArray dst, int grainRows = 0, ChannelOrder order = ORDER_BGR,
+	int dstDepth = CV_8U);
+
+// Convert a YIQ image to BGR using an approximation of NTSC conversion (ref: "YIQ" Wikipedia page).
+void convertYIQtoRGB(cv::InputArray src, cv::OutputArray dst, int grainRows = 0, int dstDepth = CV_8U);
+
+// Convert a BGR image to separate H, S & V planes. Pass cv::noArray() for the planes you don't need.
+void convertRGBtoHSVPlanes(cv::InputArray src, cv::OutputArray h, cv::OutputArray s, cv::OutputArray v, int grainRows = 0,
+	ChannelOrder order = ORDER_BGR, int dstDepth = CV_8U);
+
+// Convert a BGR image to separate Y, I & Q planes. Pass cv::noArray() for the planes you don't need,
+// eg: convertRGBtoYIQPlanes(frame, grey, cv::noArray(), cv::noArray()) only computes Y.
+void convertRGBtoYIQPlanes(cv::InputArray src, cv::OutputArray y, cv::OutputArray i, cv::OutputArray q, int grainRows = 0,
+	ChannelOrder order = ORDER_BGR, int dstDepth = CV_8U);
+
+// Convert a YUV 4:2:0 frame from a video decoder (an 8-bit 1-channel image with height*3/2 rows, like cv::cvtColor() takes)
+// straight to HSV or YIQ, without creating a BGR image. yuvToRGB is the color matrix of the video, or NULL for BT.601.
+// If chromaResolution is true, dst is at the resolution of the chroma planes (half the width & height).
+void convertYUV420toHSV(cv::InputArray src, cv::OutputArray dst, YUV420Format format, const ColorMatrix *yuvToRGB = 0,
+	bool chromaResolution = false, int grainRows = 0);
+void convertYUV420toYIQ(cv::InputArray src, cv::OutputArray dst, YUV420Format format, const ColorMatrix *yuvToRGB = 0,
+	bool chromaResolution = false, int grainRows = 0);
+
+// Convert a BGR image to HSV and threshold it by range in a single pass, without creating an HSV image.
+// mask gets 255 for the pixels within range and 0 elsewhere. If histogram isn't NULL, it gets the H, S & V histograms.
+void convertRGBtoHSVMask(cv::InputArray src, cv::OutputArray mask, const RangeHSV &range, HistogramHSV *histogram = 0,
+	int grainRows = 0);
+
+// Transform each pixel of an 8-bit 3-channel image with a color matrix, such as getColorMatrix(COLOR_MATRIX_RGB_TO_YCBCR709).
+// Uses 16-bit fixed point unless useFloat is set or the matrix has coefficients of 8 or more.
+void convertColorMatrix(cv::InputArray src, cv::OutputArray dst, const ColorMatrix &matrix, bool useFloat = false,
+	int grainRows = 0);
+
+// Create a ColorLUT from a lattice image of createColorLUTLattice(), after it was converted by your own functions.
+ColorLUTPtr createColorLUTFromLattice(cv::InputArray lattice);
+
+// Convert an 8-bit 3-channel image by interpolating each pixel in a ColorLUT, eg: to apply a whole chain of color
+// conversions baked into the LUT in a single pass.
+void convertColorLUT(cv::InputArray src, cv::OutputArray dst, const ColorLUT *lut,
+	ColorLUTInterpolation interpolation = COLOR_LUT_TETRAHEDRAL, int grainRows = 0);
+
+//------------------------------------------------------------------------------
+// Image transforming functions, written with the cv:: API instead of sharing the code of the C versions.
+//------------------------------------------------------------------------------
+
+// Copy a region of an 8-bit image. If you don't need a copy, just use src(region) instead.
+void cropImage(cv::InputArray src, cv::OutputArray dst, cv::Rect region);
+
+// Resize the image to newSize. The aspect ratio will be kept constant if 'keepAspectRatio' is true,
+// by cropping undesired parts so that only pixels of the original image are shown, instead of adding extra blank space.
+void resizeImage(cv::InputArray src, cv::OutputArray dst, cv::Size newSize, bool keepAspectRatio);
+
+// Rotate the image clockwise and possibly scale the image. Use 'mapRotatedImagePoint()' to map pixels from the src to dst image.
+void rotateImage(cv::InputArray src, cv::OutputArray dst, float angleDegrees, float scale = 1.0f);
+
+// Do Bilateral Filtering to smooth the image noise but preserve the edges.
+// A smoothness of 5 is very little filtering, and 100 is very high filtering.
+void smoothImageBilateral(cv::InputArray src, cv::OutputArray dst, float smoothness);
+
+}	// namespace imageutils
+
+#endif	// NV_IMAGE_UTILS_HPP
@@ -0,0 +1,262 @@
+/**		ImageUtilsSimd.h:		Row kernels of the ImageUtils color conversions, with SIMD versions for several x86 instruction sets.
+ * Only used inside ImageUtils, not part of its public API.
+ * Each kernel converts one row of 'width' 3-channel 8-bit pixels. The SIMD versions live in their own
+ * source files (eg: ImageUtils_avx2.cpp) that are compiled with the matching compiler flags, and
+ * ImageUtils.cpp picks one at runtime based on what the CPU supports.
+ **/
+
+#ifndef NV_IMAGE_UTILS_SIMD_H
+#define NV_IMAGE_UTILS_SIMD_H
+
+#include <algorithm>
+#include <opencv2/core/hal/interface.h>		// for uchar
+
+
+// Convert one row of pixels from src to dst.
+typedef void (*ColorRowFunc)(const uchar *src, uchar *dst, int width);
+
+// Convert one row of pixels from src into 3 separate planes, skipping the planes that are NULL.
+typedef void (*PlanarRowFunc)(const uchar *src, uchar *dst0, uchar *dst1, uchar *dst2, int width);
+
+// BGR to full-range HSV, matching convertImageRGBtoHSV().
+void convertRowRGBtoHSV_C(const uchar *src, uchar *dst, int width);
+void convertRowRGBtoHSV_SSE41(const uchar *src, uchar *dst, int width);
+void convertRowRGBtoHSV_AVX2(const uchar *src, uchar *dst, int width);
+void convertRowRGBtoHSV_AVX512(const uchar *src, uchar *dst, int width);
+void convertRowRGBtoHSVPlanar(const uchar *src, uchar *dstH, uchar *dstS, uchar *dstV, int width);
+
+// Full-range HSV to BGR, matching convertImageHSVtoRGB().
+void convertRowHSVtoRGB_C(const uchar *src, uchar *dst, int width);
+void convertRowHSVtoRGB_SSE41(const uchar *src, uchar *dst, int width);
+void convertRowHSVtoRGB_AVX2(const uchar *src, uchar *dst, int width);
+void convertRowHSVtoRGB_AVX512(const uchar *src, uchar *dst, int width);
+
+// BGR to separate Y, I & Q planes, matching convertImageRGBtoYIQPlanes(). Only a scalar version so far.
+// Like the interleaved YIQ conversions, it uses the float color matrix of getRGBtoYIQCoeffs().
+void convertRowRGBtoYIQPlanar_C(const uchar *src, uchar *dstY, uchar *dstI, uchar *dstQ, int width);
+
+// A ColorMatrix (from ImageUtils.h) prepared for the row kernels by prepareColorMatrix() in ImageUtils.cpp.
+// Each output channel is the sum of the input channels times a row of the matrix, plus the offset, rounded & clipped to 0..255.
+struct ColorMatrixCoeffs {
+	short fixedM[3][3];		// The matrix in fixed point, with 'shift' fraction bits.
+	int fixedOffset[3];		// The offset in fixed point, plus 0.5 for rounding.
+	int shift;
+	float floatM[3][3];
+	float floatOffset[3];	// The offset plus 0.5 for rounding.
+};
+
+// Convert one row of pixels from src to dst with a prepared color matrix.
+typedef void (*MatrixRowFunc)(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs);
+
+// Color matrix kernels using 16-bit fixed point, which can round differently from the float kernels by 1.
+void convertRowColorMatrix_C(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs);
+void convertRowColorMatrix_SSE41(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs);
+void convertRowColorMatrix_AVX2(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs);
+void convertRowColorMatrix_AVX512(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs);
+
+// Get output channel c of a pixel with the float color matrix, exactly like convertRowColorMatrixFloat_C() does.
+static inline uchar applyColorMatrixFloat(const ColorMatrixCoeffs *coeffs, int c, float f0, float f1, float f2)
+{
+	const float *m = coeffs->floatM[c];
+	float v = f0 * m[0] + f1 * m[1] + f2 * m[2] + coeffs->floatOffset[c];
+	return (uchar)(int)std::min(std::max(v, 0.0f), 255.0f);
+}
+
+// The prepared matrix of COLOR_MATRIX_RGB_TO_YIQ, shared by every 8-bit RGB to YIQ kernel so that they all give the same bytes.
+const ColorMatrixCoeffs* getRGBtoYIQCoeffs(void);
+
+// Color matrix kernels using floats. All the versions give exactly the same results.
+void convertRowColorMatrixFloat_C(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs);
+void convertRowColorMatrixFloat_SSE41(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs);
+void convertRowColorMatrixFloat_AVX2(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs);
+void convertRowColorMatrixFloat_AVX512(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs);
+
+// A 3D lookup table of a color transform, made by createColorLUT() & applied by convertImageColorLUT() (see ImageUtils.h).
+struct ColorLUT {
+	int size;				// The number of grid points along each channel.
+	unsigned int *table;	// size^3 output pixels with their 3 channels in the low 3 bytes. Grid point (i0,i1,i2) is at (i0*size + i1)*size + i2.
+	int cell[3][256];		// For each channel & 8-bit value: the table offset of the grid cell the value is in, plus the
+							// position of the value within the cell (0 to 256) shifted left by COLOR_LUT_FRACTION_SHIFT.
+};
+static const int COLOR_LUT_FRACTION_SHIFT = 20;
+static const int COLOR_LUT_OFFSET_MASK = (1 << COLOR_LUT_FRACTION_SHIFT) - 1;
+
+// Convert one row of pixels from src to dst by interpolating a 3D lookup table.
+typedef void (*LUTRowFunc)(const uchar *src, uchar *dst, int width, const ColorLUT *lut);
+
+// Trilinear & tetrahedral interpolation of a 3D lookup table, with integer math so that all versions give exactly the same results.
+// There are no SSE4.1 versions, since interpolating a lookup table needs the gathers of AVX2 to be worth vectorizing.
+void convertRowColorLUTTrilinear_C(const uchar *src, uchar *dst, int width, const ColorLUT *lut);
+void convertRowColorLUTTrilinear_AVX2(const uchar *src, uchar *dst, int width, const ColorLUT *lut);
+void convertRowColorLUTTrilinear_AVX512(const uchar *src, uchar *dst, int width, const ColorLUT *lut);
+void convertRowColorLUTTetrahedral_C(const uchar *src, uchar *dst, int width, const ColorLUT *lut);
+void convertRowColorLUTTetrahedral_AVX2(const uchar *src, uchar *dst, int width, const ColorLUT *lut);
+void convertRowColorLUTTetrahedral_AVX512(const uchar *src, uchar *dst, int width, const ColorLUT *lut);
+
+// Convert one row of interleaved 3-channel float pixels, for the conversions of 16-bit & float images.
+// B,G,R and H,S,V are all from 0.0 to 1.0, with the Hue as a fraction of the color circle.
+// Y is from 0.0 to 1.0, I is from -0.5957 to +0.5957 and Q is from -0.5226 to +0.5226.
+// The values aren't clipped, so HDR values above 1.0 pass through. All the versions give exactly the same results.
+typedef void (*FloatRowFunc)(const float *src, float *dst, int width);
+void convertRowRGBtoHSVFloat_C(const float *src, float *dst, int width);
+void convertRowRGBtoHSVFloat_SSE41(const float *src, float *dst, int width);
+void convertRowRGBtoHSVFloat_AVX2(const float *src, float *dst, int width);
+void convertRowRGBtoHSVFloat_AVX512(const float *src, float *dst, int width);
+void convertRowHSVtoRGBFloat_C(const float *src, float *dst, int width);
+void convertRowHSVtoRGBFloat_SSE41(const float *src, float *dst, int width);
+void convertRowHSVtoRGBFloat_AVX2(const float *src, float *dst, int width);
+void convertRowHSVtoRGBFloat_AVX512(const float *src, float *dst, int width);
+void convertRowRGBtoYIQFloat_C(const float *src, float *dst, int width);
+void convertRowRGBtoYIQFloat_SSE41(const float *src, float *dst, int width);
+void convertRowRGBtoYIQFloat_AVX2(const float *src, float *dst, int width);
+void convertRowRGBtoYIQFloat_AVX512(const float *src, float *dst, int width);
+void convertRowYIQtoRGBFloat_C(const float *src, float *dst, int width);
+void convertRowYIQtoRGBFloat_SSE41(const float *src, float *dst, int width);
+void convertRowYIQtoRGBFloat_AVX2(const float *src, float *dst, int width);
+void convertRowYIQtoRGBFloat_AVX512(const float *src, float *dst, int width);
+
+// The coefficients of the float YIQ kernels, where each output is (m[0] * in[0] + m[1] * in[1]) + m[2] * in[2].
+// RGB to YIQ takes B,G,R in that order, and YIQ to RGB gives B,G,R.
+static const float RGB_TO_YIQ_FLOAT[3][3] = {
+	{     0.114f,     0.587f,     0.299f },
+	{ -0.321263f, -0.274453f,  0.595716f },
+	{  0.311135f, -0.522591f,  0.211456f }
+};
+static const float YIQ_TO_RGB_FLOAT[3][3] = {
+	{ 1.0f, -1.1070f,  1.7046f },
+	{ 1.0f, -0.2721f, -0.6474f },
+	{ 1.0f,  0.9563f,  0.6210f }
+};
+
+// Find the min & max of an array of n floats, for scaling graphs. *minValue & *maxValue must already hold a value
+// (such as the first float), and are only replaced by smaller or bigger values, so NaNs are skipped.
+// All the versions give exactly the same results.
+typedef void (*MinMaxFunc)(const float *src, int n, float *minValue, float *maxValue);
+void findMinMaxFloat_C(const float *src, int n, float *minValue, float *maxValue);
+void findMinMaxFloat_SSE41(const float *src, int n, float *minValue, float *maxValue);
+void findMinMaxFloat_AVX2(const float *src, int n, float *minValue, float *maxValue);
+void findMinMaxFloat_AVX512(const float *src, int n, float *minValue, float *maxValue);
+
+
+//------------------------------------------------------------------------------
+// Helpers shared by the SIMD kernels, for the source files compiled with SSSE3 or newer.
+// MSVC never defines __SSSE3__, but allows every SSE intrinsic without any /arch flag.
+//------------------------------------------------------------------------------
+#if defined(__SSSE3__) || defined(_MSC_VER)
+#include <immintrin.h>
+
+// Split 16 interleaved 3-channel pixels (48 bytes) into 3 planes of 16 bytes.
+static inline void loadDeinterleave3(const uchar *ptr, __m128i &c0, __m128i &c1, __m128i &c2)
+{
+	const __m128i m00 = _mm_setr_epi8(0,3,6,9,12,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+	const __m128i m01 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,2,5,8,11,14,-1,-1,-1,-1,-1);
+	const __m128i m02 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,1,4,7,10,13);
+	const __m128i m10 = _mm_setr_epi8(1,4,7,10,13,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+	const __m128i m11 = _mm_setr_epi8(-1,-1,-1,-1,-1,0,3,6,9,12,15,-1,-1,-1,-1,-1);
+	const __m128i m12 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,2,5,8,11,14);
+	const __m128i m20 = _mm_setr_epi8(2,5,8,11,14,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+	const __m128i m21 = _mm_setr_epi8(-1,-1,-1,-1,-1,1,4,7,10,13,-1,-1,-1,-1,-1,-1);
+	const __m128i m22 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,0,3,6,9,12,15);
+	__m128i a0 = _mm_loadu_si128((const __m128i*)(ptr + 0));
+	__m128i a1 = _mm_loadu_si128((const __m128i*)(ptr + 16));
+	__m128i a2 = _mm_loadu_si128((const __m128i*)(ptr + 32));
+	c0 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, m00), _mm_shuffle_epi8(a1, m01)), _mm_shuffle_epi8(a2, m02));
+	c1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, m10), _mm_shuffle_epi8(a1, m11)), _mm_shuffle_epi8(a2, m12));
+	c2 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, m20), _mm_shuffle_epi8(a1, m21)), _mm_shuffle_epi8(a2, m22));
+}
+
+// Merge 3 planes of 16 bytes into 16 interleaved 3-channel pixels (48 bytes).
+static inline void storeInterleave3(uchar *ptr, __m128i c0, __m128i c1, __m128i c2)
+{
+	const __m128i m00 = _mm_setr_epi8(0,-1,-1,1,-1,-1,2,-1,-1,3,-1,-1,4,-1,-1,5);
+	const __m128i m01 = _mm_setr_epi8(-1,0,-1,-1,1,-1,-1,2,-1,-1,3,-1,-1,4,-1,-1);
+	const __m128i m02 = _mm_setr_epi8(-1,-1,0,-1,-1,1,-1,-1,2,-1,-1,3,-1,-1,4,-1);
+	const __m128i m10 = _mm_setr_epi8(-1,-1,6,-1,-1,7,-1,-1,8,-1,-1,9,-1,-1,10,-1);
+	const __m128i m11 = _mm_setr_epi8(5,-1,-1,6,-1,-1,7,-1,-1,8,-1,-1,9,-1,-1,10);
+	const __m128i m12 = _mm_setr_epi8(-1,5,-1,-1,6,-1,-1,7,-1,-1,8,-1,-1,9,-1,-1);
+	const __m128i m20 = _mm_setr_epi8(-1,11,-1,-1,12,-1,-1,13,-1,-1,14,-1,-1,15,-1,-1);
+	const __m128i m21 = _mm_setr_epi8(-1,-1,11,-1,-1,12,-1,-1,13,-1,-1,14,-1,-1,15,-1);
+	const __m128i m22 = _mm_setr_epi8(10,-1,-1,11,-1,-1,12,-1,-1,13,-1,-1,14,-1,-1,15);
+	__m128i a0 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m00), _mm_shuffle_epi8(c1, m01)), _mm_shuffle_epi8(c2, m02));
+	__m128i a1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m10), _mm_shuffle_epi8(c1, m11)), _mm_shuffle_epi8(c2, m12));
+	__m128i a2 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m20), _mm_shuffle_epi8(c1, m21)), _mm_shuffle_epi8(c2, m22));
+	_mm_storeu_si128((__m128i*)(ptr + 0), a0);
+	_mm_storeu_si128((__m128i*)(ptr + 16), a1);
+	_mm_storeu_si128((__m128i*)(ptr + 32), a2);
+}
+
+// Split 4 interleaved 3-channel float pixels into 3 vectors of 4 floats.
+static inline void deinterleave3f(__m128 t0, __m128 t1, __m128 t2, __m128 &c0, __m128 &c1, __m128 &c2)
+{
+	// t0 = [a0 b0 c0 a1], t1 = [b1 c1 a2 b2], t2 = [c2 a3 b3 c3]
+	__m128 a23 = _mm_shuffle_ps(t1, t2, _MM_SHUFFLE(1,1,2,2));
+	c0 = _mm_shuffle_ps(t0, a23, _MM_SHUFFLE(2,0,3,0));
+	__m128 b01 = _mm_shuffle_ps(t0, t1, _MM_SHUFFLE(0,0,1,1));
+	__m128 b23 = _mm_shuffle_ps(t1, t2, _MM_SHUFFLE(2,2,3,3));
+	c1 = _mm_shuffle_ps(b01, b23, _MM_SHUFFLE(2,0,2,0));
+	__m128 c01 = _mm_shuffle_ps(t0, t1, _MM_SHUFFLE(1,1,2,2));
+	c2 = _mm_shuffle_ps(c01, t2, _MM_SHUFFLE(3,0,2,0));
+}
+
+// Merge 3 vectors of 4 floats into 4 interleaved 3-channel float pixels. The reverse of deinterleave3f().
+static inline void interleave3f(__m128 c0, __m128 c1, __m128 c2, __m128 &t0, __m128 &t1, __m128 &t2)
+{
+	t0 = _mm_shuffle_ps(_mm_shuffle_ps(c0, c1, _MM_SHUFFLE(0,0,0,0)), _mm_shuffle_ps(c2, c0, _MM_SHUFFLE(1,1,0,0)),
+		_MM_SHUFFLE(2,0,2,0));
+	t1 = _mm_shuffle_ps(_mm_shuffle_ps(c1, c2, _MM_SHUFFLE(1,1,1,1)), _mm_shuffle_ps(c0, c1, _MM_SHUFFLE(2,2,2,2)),
+		_MM_SHUFFLE(2,0,2,0));
+	t2 = _mm_shuffle_ps(_mm_shuffle_ps(c2, c0, _MM_SHUFFLE(3,3,2,2)), _mm_shuffle_ps(c1, c2, _MM_SHUFFLE(3,3,3,3)),
+		_MM_SHUFFLE(2,0,2,0));
+}
+
+static inline void loadDeinterleave3f(const float *ptr, __m128 &c0, __m128 &c1, __m128 &c2)
+{
+	deinterleave3f(_mm_loadu_ps(ptr), _mm_loadu_ps(ptr + 4), _mm_loadu_ps(ptr + 8), c0, c1, c2);
+}
+
+static inline void storeInterleave3f(float *ptr, __m128 c0, __m128 c1, __m128 c2)
+{
+	__m128 t0, t1, t2;
+	interleave3f(c0, c1, c2, t0, t1, t2);
+	_mm_storeu_ps(ptr, t0);
+	_mm_storeu_ps(ptr + 4, t1);
+	_mm_storeu_ps(ptr + 8, t2);
+}
+#endif	// __SSSE3__ || _MSC_VER
+
+#if defined(__AVX__)
+// Split 8 interleaved 3-channel float pixels into 3 vectors of 8 floats, with the same shuffles as the SSE version
+// done on both 128-bit lanes, where the low lane has the first 4 pixels and the high lane has the last 4 pixels.
+static inline void loadDeinterleave3f(const float *ptr, __m256 &c0, __m256 &c1, __m256 &c2)
+{
+	__m256 t0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(ptr)), _mm_loadu_ps(ptr + 12), 1);
+	__m256 t1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(ptr + 4)), _mm_loadu_ps(ptr + 16), 1);
+	__m256 t2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(ptr + 8)), _mm_loadu_ps(ptr + 20), 1);
+	__m256 a23 = _mm256_shuffle_ps(t1, t2, _MM_SHUFFLE(1,1,2,2));
+	c0 = _mm256_shuffle_ps(t0, a23, _MM_SHUFFLE(2,0,3,0));
+	__m256 b01 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(0,0,1,1));
+	__m256 b23 = _mm256_shuffle_ps(t1, t2, _MM_SHUFFLE(2,2,3,3));
+	c1 = _mm256_shuffle_ps(b01, b23, _MM_SHUFFLE(2,0,2,0));
+	__m256 c01 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1,1,2,2));
+	c2 = _mm256_shuffle_ps(c01, t2, _MM_SHUFFLE(3,0,2,0));
+}
+
+// Merge 3 vectors of 8 floats into 8 interleaved 3-channel float pixels. The reverse of loadDeinterleave3f().
+static inline void storeInterleave3f(float *ptr, __m256 c0, __m256 c1, __m256 c2)
+{
+	__m256 t0 = _mm256_shuffle_ps(_mm256_shuffle_ps(c0, c1, _MM_SHUFFLE(0,0,0,0)), _mm256_shuffle_ps(c2, c0, _MM_SHUFFLE(1,1,0,0)),
+		_MM_SHUFFLE(2,0,2,0));
+	__m256 t1 = _mm256_shuffle_ps(_mm256_shuffle_ps(c1, c2, _MM_SHUFFLE(1,1,1,1)), _mm256_shuffle_ps(c0, c1, _MM_SHUFFLE(2,2,2,2)),
+		_MM_SHUFFLE(2,0,2,0));
+	__m256 t2 = _mm256_shuffle_ps(_mm256_shuffle_ps(c2, c0, _MM_SHUFFLE(3,3,2,2)), _mm256_shuffle_ps(c1, c2, _MM_SHUFFLE(3,3,3,3)),
+		_MM_SHUFFLE(2,0,2,0));
+	_mm_storeu_ps(ptr, _mm256_castps256_ps128(t0));
+	_mm_storeu_ps(ptr + 4, _mm256_castps256_ps128(t1));
+	_mm_storeu_ps(ptr + 8, _mm256_castps256_ps128(t2));
+	_mm_storeu_ps(ptr + 12, _mm256_extractf128_ps(t0, 1));
+	_mm_storeu_ps(ptr + 16, _mm256_extractf128_ps(t1, 1));
+	_mm_storeu_ps(ptr + 20, _mm256_extractf128_ps(t2, 1));
+}
+#endif	// __AVX__
+
+#endif	// NV_IMAGE_UTILS_SIMD_H
@@ -0,0 +1,296 @@
+/**		ImageUtilsTemplates.h:		Templated row kernels of the ImageUtils color conversions, for any channel order & depth.
+ * Only used inside ImageUtils, not part of its public API.
+ * Each combination of input depth (8U, 16U or 32F), channel order (BGR, RGB, BGRA or RGBA), output depth and output layout
+ * (interleaved or planar) is compiled into its own kernel, so the inner loops have no per-pixel branching on them.
+ * The 8-bit kernels use the same float math as the scalar 8-bit BGR kernels, so they give exactly the same results.
+ * The kernels for 16-bit & float images convert a block of pixels at a time to floats, then call the float SIMD kernels.
+ **/
+
+#ifndef NV_IMAGE_UTILS_TEMPLATES_H
+#define NV_IMAGE_UTILS_TEMPLATES_H
+
+#include <algorithm>
+
+#include "ImageUtils.hpp"
+#include "ImageUtilsSimd.h"
+
+
+namespace imageutils
+{
+
+// Output layouts of the templated kernels.
+enum OutputLayout {
+	LAYOUT_INTERLEAVED,		// dst0 is a 3-channel image, dst1 & dst2 are unused.
+	LAYOUT_PLANAR			// dst0, dst1 & dst2 are separate planes, any of which can be NULL.
+};
+
+// Where each channel order stores R, G & B, and how many channels each pixel has.
+template<int ORDER> struct ChannelLayout;
+template<> struct ChannelLayout<ORDER_BGR>  { enum { CHANNELS = 3, R = 2, G = 1, B = 0 }; };
+template<> struct ChannelLayout<ORDER_RGB>  { enum { CHANNELS = 3, R = 0, G = 1, B = 2 }; };
+template<> struct ChannelLayout<ORDER_BGRA> { enum { CHANNELS = 4, R = 2, G = 1, B = 0 }; };
+template<> struct ChannelLayout<ORDER_RGBA> { enum { CHANNELS = 4, R = 0, G = 1, B = 2 }; };
+
+// The largest value of each depth, that integer images map to 1.0. Float images are used as they are.
+template<typename T> struct DepthTraits;
+template<> struct DepthTraits<uchar>  { enum { IS_FLOAT = 0 }; static float maxValue() { return 255.0f; } };
+template<> struct DepthTraits<ushort> { enum { IS_FLOAT = 0 }; static float maxValue() { return 65535.0f; } };
+template<> struct DepthTraits<float>  { enum { IS_FLOAT = 1 }; static float maxValue() { return 1.0f; } };
+
+// Convert 8-bit values to floats between 0.0 and 1.0.
+static inline float byteToFloat(uchar v)
+{
+	return v * (1.0f / 255.0f);
+}
+
+// Convert a float between 0.0 and 1.0 to a rounded 8-bit integer, clipping values out of range.
+static inline uchar scaleToByte(float f, float scale)
+{
+	int i = (int)(0.5f + std::min(std::max(f * scale, 0.0f), 255.0f));
+	return (uchar)i;
+}
+
+// Write the 3 converted components of pixel x of any depth TD, into whichever output layout.
+template<int LAYOUT> struct PixelStore;
+template<> struct PixelStore<LAYOUT_INTERLEAVED>
+{
+	template<typename TD>
+	static void store(uchar *dst0, uchar *, uchar *, int x, TD c0, TD c1, TD c2)
+	{
+		TD *p = (TD*)dst0 + x*3;
+		p[0] = c0;
+		p[1] = c1;
+		p[2] = c2;
+	}
+};
+template<> struct PixelStore<LAYOUT_PLANAR>
+{
+	template<typename TD>
+	static void store(uchar *dst0, uchar *dst1, uchar *dst2, int x, TD c0, TD c1, TD c2)
+	{
+		if (dst0)
+			((TD*)dst0)[x] = c0;
+		if (dst1)
+			((TD*)dst1)[x] = c1;
+		if (dst2)
+			((TD*)dst2)[x] = c2;
+	}
+};
+
+template<int LAYOUT>
+static inline void storePixel(uchar *dst0, uchar *dst1, uchar *dst2, int x, uchar c0, uchar c1, uchar c2)
+{
+	PixelStore<LAYOUT>::store(dst0, dst1, dst2, x, c0, c1, c2);
+}
+
+// The range of I & Q in YIQ.
+static const float MIN_I = -0.5957f;
+static const float MIN_Q = -0.5226f;
+
+// RGB to full-range 8-bit HSV, matching convertRowRGBtoHSV_C().
+struct ConvertRGBtoHSV
+{
+	template<int ORDER, int LAYOUT>
+	static void row(const uchar *src, uchar *dst0, uchar *dst1, uchar *dst2, int width)
+	{
+		typedef ChannelLayout<ORDER> CL;
+		for (int x=0; x<width; x++) {
+			const uchar *p = src + x*CL::CHANNELS;
+			float fR = byteToFloat(p[CL::R]);
+			float fG = byteToFloat(p[CL::G]);
+			float fB = byteToFloat(p[CL::B]);
+
+			float fMax = std::max(std::max(fR, fG), fB);
+			float fMin = std::min(std::min(fR, fG), fB);
+			float fH = 0;	// undefined hue for black & grey
+			float fS = 0;
+			if (fMax > 0) {			// Make sure its not pure black.
+				float fDelta = fMax - fMin;
+				fS = fDelta / fMax;		// Saturation.
+				if (fDelta > 0) {
+					float ANGLE_TO_UNIT = 1.0f / (6.0f * fDelta);	// Make the Hues between 0.0 to 1.0 instead of 6.0
+					if (fMax == fR)			// between yellow & magenta.
+						fH = (fG - fB) * ANGLE_TO_UNIT;
+					else if (fMax == fG)	// between cyan & yellow.
+						fH = (2.0f/6.0f) + ( fB - fR ) * ANGLE_TO_UNIT;
+					else					// between magenta & cyan.
+						fH = (4.0f/6.0f) + ( fR - fG ) * ANGLE_TO_UNIT;
+					// Wrap outlier Hues around the circle.
+					if (fH < 0.0f)
+						fH += 1.0f;
+					if (fH >= 1.0f)
+						fH -= 1.0f;
+				}
+			}
+			storePixel<LAYOUT>(dst0, dst1, dst2, x, scaleToByte(fH, 255.0f), scaleToByte(fS, 255.0f), scaleToByte(fMax, 255.0f));
+		}
+	}
+};
+
+// RGB to YIQ with the float color matrix of getRGBtoYIQCoeffs(), matching convertRowRGBtoYIQPlanar_C() and the
+// interleaved YIQ conversion.
+struct ConvertRGBtoYIQ
+{
+	template<int ORDER, int LAYOUT>
+	static void row(const uchar *src, uchar *dst0, uchar *dst1, uchar *dst2, int width)
+	{
+		typedef ChannelLayout<ORDER> CL;
+		const ColorMatrixCoeffs *coeffs = getRGBtoYIQCoeffs();
+		for (int x=0; x<width; x++) {
+			const uchar *p = src + x*CL::CHANNELS;
+			// The matrix takes B,G,R, whatever the channel order of the image.
+			float fB = p[CL::B];
+			float fG = p[CL::G];
+			float fR = p[CL::R];
+			storePixel<LAYOUT>(dst0, dst1, dst2, x, applyColorMatrixFloat(coeffs, 0, fB, fG, fR),
+				applyColorMatrixFloat(coeffs, 1, fB, fG, fR), applyColorMatrixFloat(coeffs, 2, fB, fG, fR));
+		}
+	}
+};
+
+// Get the 8-bit kernel of a conversion for the given channel order.
+template<class CONVERSION, int LAYOUT>
+static PlanarRowFunc getRowFuncForOrder(ChannelOrder order)
+{
+	switch (order) {
+		case ORDER_BGR:		return CONVERSION::template row<ORDER_BGR, LAYOUT>;
+		case ORDER_RGB:		return CONVERSION::template row<ORDER_RGB, LAYOUT>;
+		case ORDER_BGRA:	return CONVERSION::template row<ORDER_BGRA, LAYOUT>;
+		case ORDER_RGBA:	return CONVERSION::template row<ORDER_RGBA, LAYOUT>;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+// Conversions of 16-bit & float images, or into 16-bit & float images, using the float SIMD kernels.
+//------------------------------------------------------------------------------
+
+// The float range of each channel of a color space. Integer images map minValue[c] to 0 and minValue[c] + range[c]
+// to the largest value of their depth, while float images hold the float values themselves.
+struct ChannelRanges {
+	float minValue[3];
+	float range[3];
+};
+static const ChannelRanges RANGES_RGB = { {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f} };
+static const ChannelRanges RANGES_HSV = { {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f} };
+static const ChannelRanges RANGES_YIQ = { {0.0f, MIN_I, MIN_Q}, {1.0f, MIN_I * -2.0f, MIN_Q * -2.0f} };
+
+// A float row kernel together with the color spaces it converts between.
+struct FloatConversion {
+	FloatRowFunc convertRow;
+	ChannelRanges srcRanges;
+	ChannelRanges dstRanges;
+};
+
+typedef void (*AnyDepthRowFunc)(const uchar *src, uchar *dst0, uchar *dst1, uchar *dst2, int width,
+	const FloatConversion *conversion);
+
+// Convert a value of depth TD from its float value, rounding & clipping it for integer depths.
+template<typename TD>
+static inline TD fromFloat(float f, float minValue, float scale)
+{
+	return (TD)(int)(0.5f + std::min(std::max((f - minValue) * scale, 0.0f), DepthTraits<TD>::maxValue()));
+}
+template<>
+inline float fromFloat<float>(float f, float, float)
+{
+	return f;
+}
+
+// Convert a row of pixels of depth T in the given channel order into pixels of depth TD in the given output layout,
+// a block at a time through a float buffer that stays in the cache. Float BGR input & interleaved float output are
+// used in place instead of being copied.
+template<typename T, int ORDER, typename TD, int LAYOUT>
+static void convertRowAnyDepth(const uchar *src, uchar *dst0, uchar *dst1, uchar *dst2, int width,
+	const FloatConversion *conversion)
+{
+	typedef ChannelLayout<ORDER> CL;
+	const int BLOCK = 256;		// Pixels per block, so that the buffer fits in the L1 cache.
+	const bool DIRECT_SRC = DepthTraits<T>::IS_FLOAT && CL::CHANNELS == 3 && CL::B == 0;
+	const bool DIRECT_DST = DepthTraits<TD>::IS_FLOAT && LAYOUT == LAYOUT_INTERLEAVED;
+	float buffer[BLOCK*3];
+
+	float srcMin[3], srcScale[3], dstMin[3], dstScale[3];
+	for (int c=0; c<3; c++) {
+		srcMin[c] = conversion->srcRanges.minValue[c];
+		srcScale[c] = conversion->srcRanges.range[c] / DepthTraits<T>::maxValue();
+		dstMin[c] = conversion->dstRanges.minValue[c];
+		dstScale[c] = DepthTraits<TD>::maxValue() / conversion->dstRanges.range[c];
+	}
+
+	const T *pSrc = (const T*)src;
+	for (int x0=0; x0<width; x0+=BLOCK) {
+		int n = std::min(BLOCK, width - x0);
+		const float *in = buffer;
+		if (DIRECT_SRC) {
+			in = (const float*)pSrc + x0*3;
+		}
+		else {
+			for (int i=0; i<n; i++) {
+				const T *p = pSrc + (x0 + i)*CL::CHANNELS;
+				if (DepthTraits<T>::IS_FLOAT) {
+					buffer[i*3+0] = (float)p[CL::B];
+					buffer[i*3+1] = (float)p[CL::G];
+					buffer[i*3+2] = (float)p[CL::R];
+				}
+				else {
+					buffer[i*3+0] = srcMin[0] + p[CL::B] * srcScale[0];
+					buffer[i*3+1] = srcMin[1] + p[CL::G] * srcScale[1];
+					buffer[i*3+2] = srcMin[2] + p[CL::R] * srcScale[2];
+				}
+			}
+		}
+
+		if (DIRECT_DST) {
+			conversion->convertRow(in, (float*)dst0 + x0*3, n);
+			continue;
+		}
+		conversion->convertRow(in, buffer, n);
+		for (int i=0; i<n; i++) {
+			const float *f = buffer + i*3;
+			PixelStore<LAYOUT>::store(dst0, dst1, dst2, x0 + i, fromFloat<TD>(f[0], dstMin[0], dstScale[0]),
+				fromFloat<TD>(f[1], dstMin[1], dstScale[1]), fromFloat<TD>(f[2], dstMin[2], dstScale[2]));
+		}
+	}
+}
+
+// Get the kernel converting pixels of depth T in the given channel order into the OpenCV depth dstDepth.
+template<int LAYOUT, typename T, int ORDER>
+static AnyDepthRowFunc getAnyDepthRowFuncForDst(int dstDepth)
+{
+	switch (dstDepth) {
+		case CV_8U:		return convertRowAnyDepth<T, ORDER, uchar, LAYOUT>;
+		case CV_16U:	return convertRowAnyDepth<T, ORDER, ushort, LAYOUT>;
+		case CV_32F:	return convertRowAnyDepth<T, ORDER, float, LAYOUT>;
+	}
+	return 0;
+}
+
+template<int LAYOUT, typename T>
+static AnyDepthRowFunc getAnyDepthRowFuncForOrder(ChannelOrder order, int dstDepth)
+{
+	switch (order) {
+		case ORDER_BGR:		return getAnyDepthRowFuncForDst<LAYOUT, T, ORDER_BGR>(dstDepth);
+		case ORDER_RGB:		return getAnyDepthRowFuncForDst<LAYOUT, T, ORDER_RGB>(dstDepth);
+		case ORDER_BGRA:	return getAnyDepthRowFuncForDst<LAYOUT, T, ORDER_BGRA>(dstDepth);
+		case ORDER_RGBA:	return getAnyDepthRowFuncForDst<LAYOUT, T, ORDER_RGBA>(dstDepth);
+	}
+	return 0;
+}
+
+// Get the kernel converting pixels of the OpenCV depth srcDepth (CV_8U, CV_16U or CV_32F) in the given channel order
+// into dstDepth, or NULL if either depth isn't supported.
+template<int LAYOUT>
+static AnyDepthRowFunc getAnyDepthRowFunc(int srcDepth, ChannelOrder order, int dstDepth)
+{
+	switch (srcDepth) {
+		case CV_8U:		return getAnyDepthRowFuncForOrder<LAYOUT, uchar>(order, dstDepth);
+		case CV_16U:	return getAnyDepthRowFuncForOrder<LAYOUT, ushort>(order, dstDepth);
+		case CV_32F:	return getAnyDepthRowFuncForOrder<LAYOUT, float>(order, dstDepth);
+	}
+	return 0;
+}
+
+}	// namespace imageutils
+
+#endif	// NV_IMAGE_UTILS_TEMPLATES_H
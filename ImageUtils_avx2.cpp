@@ -0,0 +1,541 @@
+/**		ImageUtils_avx2.cpp:		AVX2 versions of the ImageUtils row kernels. Must be compiled with -mavx2 (or /arch:AVX2 on MSVC).
+ * Don't enable FMA for this file, since fused multiply-adds would round differently from the scalar code.
+ **/
+
+#include "ImageUtilsSimd.h"
+
+
+// Convert 8 pixels from 8-bit B,G,R (as ints) to H,S,V (as ints), with exactly the same float math as convertImageRGBtoHSV().
+static inline void convertRGBtoHSV_8(__m256i iB, __m256i iG, __m256i iR, __m256i &iH, __m256i &iS, __m256i &iV)
+{
+	const __m256 BYTE_TO_FLOAT = _mm256_set1_ps(1.0f / 255.0f);
+	const __m256 FLOAT_TO_BYTE = _mm256_set1_ps(255.0f);
+	const __m256 HALF = _mm256_set1_ps(0.5f);
+	const __m256 ONE = _mm256_set1_ps(1.0f);
+	const __m256 SIX = _mm256_set1_ps(6.0f);
+	const __m256 ZERO = _mm256_setzero_ps();
+
+	// Branchless min & max, using integer comparisons.
+	__m256i iMax = _mm256_max_epi32(_mm256_max_epi32(iB, iG), iR);
+	__m256i iMin = _mm256_min_epi32(_mm256_min_epi32(iB, iG), iR);
+
+	// Convert from 8-bit integers to floats
+	__m256 fB = _mm256_mul_ps(_mm256_cvtepi32_ps(iB), BYTE_TO_FLOAT);
+	__m256 fG = _mm256_mul_ps(_mm256_cvtepi32_ps(iG), BYTE_TO_FLOAT);
+	__m256 fR = _mm256_mul_ps(_mm256_cvtepi32_ps(iR), BYTE_TO_FLOAT);
+	__m256 fMax = _mm256_mul_ps(_mm256_cvtepi32_ps(iMax), BYTE_TO_FLOAT);
+	__m256 fMin = _mm256_mul_ps(_mm256_cvtepi32_ps(iMin), BYTE_TO_FLOAT);
+
+	// Pure black and grey pixels give NaN here, which the saturating packs turn into 0, just like the scalar code.
+	__m256 fDelta = _mm256_sub_ps(fMax, fMin);
+	__m256 fS = _mm256_div_ps(fDelta, fMax);
+	__m256 ANGLE_TO_UNIT = _mm256_div_ps(ONE, _mm256_mul_ps(SIX, fDelta));
+
+	// Compute the hue for all 3 cases, then pick by which component was the max (red first, then green).
+	__m256 fHr = _mm256_mul_ps(_mm256_sub_ps(fG, fB), ANGLE_TO_UNIT);
+	__m256 fHg = _mm256_add_ps(_mm256_set1_ps(2.0f/6.0f), _mm256_mul_ps(_mm256_sub_ps(fB, fR), ANGLE_TO_UNIT));
+	__m256 fHb = _mm256_add_ps(_mm256_set1_ps(4.0f/6.0f), _mm256_mul_ps(_mm256_sub_ps(fR, fG), ANGLE_TO_UNIT));
+	__m256 fH = _mm256_blendv_ps(fHb, fHg, _mm256_castsi256_ps(_mm256_cmpeq_epi32(iMax, iG)));
+	fH = _mm256_blendv_ps(fH, fHr, _mm256_castsi256_ps(_mm256_cmpeq_epi32(iMax, iR)));
+
+	// Wrap outlier Hues around the circle.
+	fH = _mm256_add_ps(fH, _mm256_and_ps(_mm256_cmp_ps(fH, ZERO, _CMP_LT_OQ), ONE));
+	fH = _mm256_sub_ps(fH, _mm256_and_ps(_mm256_cmp_ps(fH, ONE, _CMP_GE_OQ), ONE));
+
+	// Convert from floats to 8-bit integers (clipped later by the packs).
+	iH = _mm256_cvttps_epi32(_mm256_add_ps(HALF, _mm256_mul_ps(fH, FLOAT_TO_BYTE)));
+	iS = _mm256_cvttps_epi32(_mm256_add_ps(HALF, _mm256_mul_ps(fS, FLOAT_TO_BYTE)));
+	iV = _mm256_cvttps_epi32(_mm256_add_ps(HALF, _mm256_mul_ps(fMax, FLOAT_TO_BYTE)));
+}
+
+// Pack 2 groups of 8 ints into 16 bytes, saturating to 0..255.
+static inline __m128i packInts(__m256i a, __m256i b)
+{
+	// The 256-bit pack works within each 128-bit lane, so put the 64-bit blocks back in order afterwards.
+	__m256i ab = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), _MM_SHUFFLE(3,1,2,0));
+	return _mm_packus_epi16(_mm256_castsi256_si128(ab), _mm256_extracti128_si256(ab, 1));
+}
+
+void convertRowRGBtoHSV_AVX2(const uchar *src, uchar *dst, int width)
+{
+	int x = 0;
+	for (; x <= width - 16; x += 16) {
+		__m128i b, g, r;
+		loadDeinterleave3(src + x*3, b, g, r);
+
+		__m256i h0, s0, v0, h1, s1, v1;
+		convertRGBtoHSV_8(_mm256_cvtepu8_epi32(b), _mm256_cvtepu8_epi32(g), _mm256_cvtepu8_epi32(r), h0, s0, v0);
+		convertRGBtoHSV_8(_mm256_cvtepu8_epi32(_mm_srli_si128(b, 8)), _mm256_cvtepu8_epi32(_mm_srli_si128(g, 8)),
+			_mm256_cvtepu8_epi32(_mm_srli_si128(r, 8)), h1, s1, v1);
+
+		storeInterleave3(dst + x*3, packInts(h0, h1), packInts(s0, s1), packInts(v0, v1));
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowRGBtoHSV_C(src + x*3, dst + x*3, width - x);
+}
+
+
+// Divide unsigned 16-bit ints by 255, rounding down. Exact for n < 65535.
+static inline __m256i divideBy255(__m256i n)
+{
+	return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(n, _mm256_set1_epi16(1)), _mm256_srli_epi16(n, 8)), 8);
+}
+
+// Get v * x / (255*255) rounded down, for v <= 255 and x <= 255*255, without leaving 16 bits.
+static inline __m256i multiplyFraction(__m256i v, __m256i x)
+{
+	__m256i xa = divideBy255(x);
+	__m256i xb = _mm256_sub_epi16(x, _mm256_mullo_epi16(xa, _mm256_set1_epi16(255)));
+	__m256i d = _mm256_add_epi16(_mm256_mullo_epi16(v, xa), divideBy255(_mm256_mullo_epi16(v, xb)));
+	return divideBy255(d);
+}
+
+// Convert 16 pixels from 8-bit H,S,V (as 16-bit ints) to B,G,R (as 16-bit ints), with exactly the same integer
+// math as convertRowHSVtoRGB_C(). See the SSE4.1 version for the details.
+static inline void convertHSVtoRGB_16(__m256i iH, __m256i iS, __m256i iV, __m256i &iB, __m256i &iG, __m256i &iR)
+{
+	const __m256i C255 = _mm256_set1_epi16(255);
+	const __m256i C65025 = _mm256_set1_epi16((short)(255*255));
+
+	iH = _mm256_andnot_si256(_mm256_cmpeq_epi16(iH, C255), iH);
+	__m256i h6 = _mm256_mullo_epi16(iH, _mm256_set1_epi16(6));
+	__m256i sector = divideBy255(h6);
+	__m256i fraction = _mm256_sub_epi16(h6, _mm256_mullo_epi16(sector, C255));
+
+	__m256i p = divideBy255(_mm256_mullo_epi16(iV, _mm256_sub_epi16(C255, iS)));
+	__m256i q = multiplyFraction(iV, _mm256_sub_epi16(C65025, _mm256_mullo_epi16(iS, fraction)));
+	__m256i t = multiplyFraction(iV, _mm256_sub_epi16(C65025, _mm256_mullo_epi16(iS, _mm256_sub_epi16(C255, fraction))));
+
+	__m256i s1 = _mm256_cmpeq_epi16(sector, _mm256_set1_epi16(1));
+	__m256i s2 = _mm256_cmpeq_epi16(sector, _mm256_set1_epi16(2));
+	__m256i s3 = _mm256_cmpeq_epi16(sector, _mm256_set1_epi16(3));
+	__m256i s4 = _mm256_cmpeq_epi16(sector, _mm256_set1_epi16(4));
+	__m256i s5 = _mm256_cmpeq_epi16(sector, _mm256_set1_epi16(5));
+	iR = _mm256_blendv_epi8(iV, q, s1);
+	iR = _mm256_blendv_epi8(iR, p, _mm256_or_si256(s2, s3));
+	iR = _mm256_blendv_epi8(iR, t, s4);
+	iG = _mm256_blendv_epi8(t, iV, _mm256_or_si256(s1, s2));
+	iG = _mm256_blendv_epi8(iG, q, s3);
+	iG = _mm256_blendv_epi8(iG, p, _mm256_or_si256(s4, s5));
+	iB = _mm256_blendv_epi8(p, t, s2);
+	iB = _mm256_blendv_epi8(iB, iV, _mm256_or_si256(s3, s4));
+	iB = _mm256_blendv_epi8(iB, q, s5);
+}
+
+// Pack 16 shorts into 16 bytes, saturating to 0..255.
+static inline __m128i packShorts(__m256i a)
+{
+	return _mm_packus_epi16(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+}
+
+void convertRowHSVtoRGB_AVX2(const uchar *src, uchar *dst, int width)
+{
+	int x = 0;
+	for (; x <= width - 16; x += 16) {
+		__m128i h, s, v;
+		loadDeinterleave3(src + x*3, h, s, v);
+
+		__m256i b, g, r;
+		convertHSVtoRGB_16(_mm256_cvtepu8_epi16(h), _mm256_cvtepu8_epi16(s), _mm256_cvtepu8_epi16(v), b, g, r);
+
+		storeInterleave3(dst + x*3, packShorts(b), packShorts(g), packShorts(r));
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowHSVtoRGB_C(src + x*3, dst + x*3, width - x);
+}
+
+
+// Multiply 16 pixels by one row of the fixed-point color matrix, giving 16 shorts (to be saturated to bytes later).
+// The unpacks & packs both work within each 128-bit lane, so the pixels come out in their original order.
+static inline __m256i multiplyMatrixRow(__m256i c01lo, __m256i c01hi, __m256i c2lo, __m256i c2hi, const short *m, int offset,
+	__m128i shift)
+{
+	const __m256i m01 = _mm256_set1_epi32((ushort)m[0] | (m[1] << 16));
+	const __m256i m2 = _mm256_set1_epi32((ushort)m[2]);
+	const __m256i off = _mm256_set1_epi32(offset);
+	__m256i lo = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(c01lo, m01), _mm256_madd_epi16(c2lo, m2)), off);
+	__m256i hi = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(c01hi, m01), _mm256_madd_epi16(c2hi, m2)), off);
+	return _mm256_packs_epi32(_mm256_sra_epi32(lo, shift), _mm256_sra_epi32(hi, shift));
+}
+
+void convertRowColorMatrix_AVX2(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs)
+{
+	const __m256i ZERO = _mm256_setzero_si256();
+	const __m128i shift = _mm_cvtsi32_si128(coeffs->shift);
+	int x = 0;
+	for (; x <= width - 16; x += 16) {
+		__m128i b0, b1, b2;
+		loadDeinterleave3(src + x*3, b0, b1, b2);
+		__m256i c0 = _mm256_cvtepu8_epi16(b0);
+		__m256i c1 = _mm256_cvtepu8_epi16(b1);
+		__m256i c2 = _mm256_cvtepu8_epi16(b2);
+
+		__m256i c01lo = _mm256_unpacklo_epi16(c0, c1);
+		__m256i c01hi = _mm256_unpackhi_epi16(c0, c1);
+		__m256i c2lo = _mm256_unpacklo_epi16(c2, ZERO);
+		__m256i c2hi = _mm256_unpackhi_epi16(c2, ZERO);
+		__m256i d0 = multiplyMatrixRow(c01lo, c01hi, c2lo, c2hi, coeffs->fixedM[0], coeffs->fixedOffset[0], shift);
+		__m256i d1 = multiplyMatrixRow(c01lo, c01hi, c2lo, c2hi, coeffs->fixedM[1], coeffs->fixedOffset[1], shift);
+		__m256i d2 = multiplyMatrixRow(c01lo, c01hi, c2lo, c2hi, coeffs->fixedM[2], coeffs->fixedOffset[2], shift);
+
+		storeInterleave3(dst + x*3, packShorts(d0), packShorts(d1), packShorts(d2));
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowColorMatrix_C(src + x*3, dst + x*3, width - x, coeffs);
+}
+
+// Multiply 8 pixels (as floats) by one row of the float color matrix, giving 8 ints between 0 and 255.
+// Adds the terms in the same order as the scalar code, so that it rounds the same way.
+static inline __m256i multiplyMatrixRowFloat(__m256 f0, __m256 f1, __m256 f2, const float *m, float offset)
+{
+	__m256 v = _mm256_add_ps(_mm256_mul_ps(f0, _mm256_set1_ps(m[0])), _mm256_mul_ps(f1, _mm256_set1_ps(m[1])));
+	v = _mm256_add_ps(_mm256_add_ps(v, _mm256_mul_ps(f2, _mm256_set1_ps(m[2]))), _mm256_set1_ps(offset));
+	v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+	return _mm256_cvttps_epi32(v);
+}
+
+void convertRowColorMatrixFloat_AVX2(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs)
+{
+	int x = 0;
+	for (; x <= width - 16; x += 16) {
+		__m128i c0, c1, c2;
+		loadDeinterleave3(src + x*3, c0, c1, c2);
+
+		__m256i d0[2], d1[2], d2[2];
+		for (int k=0; k<2; k++) {
+			__m256 f0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(c0));
+			__m256 f1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(c1));
+			__m256 f2 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(c2));
+			d0[k] = multiplyMatrixRowFloat(f0, f1, f2, coeffs->floatM[0], coeffs->floatOffset[0]);
+			d1[k] = multiplyMatrixRowFloat(f0, f1, f2, coeffs->floatM[1], coeffs->floatOffset[1]);
+			d2[k] = multiplyMatrixRowFloat(f0, f1, f2, coeffs->floatM[2], coeffs->floatOffset[2]);
+			c0 = _mm_srli_si128(c0, 8);
+			c1 = _mm_srli_si128(c1, 8);
+			c2 = _mm_srli_si128(c2, 8);
+		}
+
+		storeInterleave3(dst + x*3, packInts(d0[0], d0[1]), packInts(d1[0], d1[1]), packInts(d2[0], d2[1]));
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowColorMatrixFloat_C(src + x*3, dst + x*3, width - x, coeffs);
+}
+
+
+// Look up the grid cells of 8 pixels (given as 3 channels of 8 bytes) in a 3D lookup table,
+// giving the table offset of each cell and the position of each channel within it (0 to 256).
+static inline void lookupLUTCells(__m128i b0, __m128i b1, __m128i b2, const ColorLUT *lut, __m256i &base, __m256i &f0,
+	__m256i &f1, __m256i &f2)
+{
+	const __m256i OFFSET_MASK = _mm256_set1_epi32(COLOR_LUT_OFFSET_MASK);
+	__m256i cell0 = _mm256_i32gather_epi32(lut->cell[0], _mm256_cvtepu8_epi32(b0), 4);
+	__m256i cell1 = _mm256_i32gather_epi32(lut->cell[1], _mm256_cvtepu8_epi32(b1), 4);
+	__m256i cell2 = _mm256_i32gather_epi32(lut->cell[2], _mm256_cvtepu8_epi32(b2), 4);
+	base = _mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(cell0, OFFSET_MASK), _mm256_and_si256(cell1, OFFSET_MASK)),
+		_mm256_and_si256(cell2, OFFSET_MASK));
+	f0 = _mm256_srli_epi32(cell0, COLOR_LUT_FRACTION_SHIFT);
+	f1 = _mm256_srli_epi32(cell1, COLOR_LUT_FRACTION_SHIFT);
+	f2 = _mm256_srli_epi32(cell2, COLOR_LUT_FRACTION_SHIFT);
+}
+
+// Get 8 entries of the lookup table.
+static inline __m256i gatherLUT(const ColorLUT *lut, __m256i offset)
+{
+	return _mm256_i32gather_epi32((const int*)lut->table, offset, 4);
+}
+
+// Copy a weight into both 16-bit halves of each int.
+static inline __m256i pairWeights(__m256i w)
+{
+	return _mm256_or_si256(w, _mm256_slli_epi32(w, 16));
+}
+
+// Channels 0 & 2 of lookup table entries, in the low & high 16 bits of each int.
+static inline __m256i evenChannels(__m256i v)
+{
+	return _mm256_and_si256(v, _mm256_set1_epi32(0x00FF00FF));
+}
+
+// Channel 1 of lookup table entries, in the low 16 bits of each int.
+static inline __m256i oddChannels(__m256i v)
+{
+	return _mm256_and_si256(_mm256_srli_epi32(v, 8), _mm256_set1_epi32(0x00FF00FF));
+}
+
+// Interpolate between the channels a & b (in 16-bit halves) with the paired weights wa & wb that add up to 256.
+// Exactly the same as lerpLUT() in the scalar code, since the sums always fit in 16 bits.
+static inline __m256i lerpLUT(__m256i a, __m256i b, __m256i wa, __m256i wb)
+{
+	__m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(a, wa), _mm256_mullo_epi16(b, wb));
+	return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(128)), 8);
+}
+
+// Interpolate 8 pixels (given as 3 channels of 8 bytes) in a 3D lookup table with trilinear interpolation, giving each output channel as ints.
+static inline void interpolateTrilinear_8(__m128i b0, __m128i b1, __m128i b2, const ColorLUT *lut, __m256i &d0, __m256i &d1,
+	__m256i &d2)
+{
+	const __m256i S0 = _mm256_set1_epi32(lut->size * lut->size);
+	const __m256i S1 = _mm256_set1_epi32(lut->size);
+	const __m256i S2 = _mm256_set1_epi32(1);
+	const __m256i C256 = _mm256_set1_epi32(256);
+	__m256i base, f0, f1, f2;
+	lookupLUTCells(b0, b1, b2, lut, base, f0, f1, f2);
+	__m256i base1 = _mm256_add_epi32(base, S1);
+	__m256i base10 = _mm256_add_epi32(base, S0);
+	__m256i base11 = _mm256_add_epi32(base10, S1);
+	__m256i v000 = gatherLUT(lut, base);
+	__m256i v001 = gatherLUT(lut, _mm256_add_epi32(base, S2));
+	__m256i v010 = gatherLUT(lut, base1);
+	__m256i v011 = gatherLUT(lut, _mm256_add_epi32(base1, S2));
+	__m256i v100 = gatherLUT(lut, base10);
+	__m256i v101 = gatherLUT(lut, _mm256_add_epi32(base10, S2));
+	__m256i v110 = gatherLUT(lut, base11);
+	__m256i v111 = gatherLUT(lut, _mm256_add_epi32(base11, S2));
+
+	__m256i wa0 = pairWeights(_mm256_sub_epi32(C256, f0)), wb0 = pairWeights(f0);
+	__m256i wa1 = pairWeights(_mm256_sub_epi32(C256, f1)), wb1 = pairWeights(f1);
+	__m256i wa2 = pairWeights(_mm256_sub_epi32(C256, f2)), wb2 = pairWeights(f2);
+
+	// Interpolate along channel 2, then channel 1, then channel 0, like the scalar code.
+	__m256i e00 = lerpLUT(evenChannels(v000), evenChannels(v001), wa2, wb2);
+	__m256i e01 = lerpLUT(evenChannels(v010), evenChannels(v011), wa2, wb2);
+	__m256i e10 = lerpLUT(evenChannels(v100), evenChannels(v101), wa2, wb2);
+	__m256i e11 = lerpLUT(evenChannels(v110), evenChannels(v111), wa2, wb2);
+	__m256i e = lerpLUT(lerpLUT(e00, e01, wa1, wb1), lerpLUT(e10, e11, wa1, wb1), wa0, wb0);
+	__m256i o00 = lerpLUT(oddChannels(v000), oddChannels(v001), wa2, wb2);
+	__m256i o01 = lerpLUT(oddChannels(v010), oddChannels(v011), wa2, wb2);
+	__m256i o10 = lerpLUT(oddChannels(v100), oddChannels(v101), wa2, wb2);
+	__m256i o11 = lerpLUT(oddChannels(v110), oddChannels(v111), wa2, wb2);
+	__m256i o = lerpLUT(lerpLUT(o00, o01, wa1, wb1), lerpLUT(o10, o11, wa1, wb1), wa0, wb0);
+
+	d0 = _mm256_and_si256(e, _mm256_set1_epi32(0xFFFF));
+	d1 = o;
+	d2 = _mm256_srli_epi32(e, 16);
+}
+
+// Interpolate 8 pixels (given as 3 channels of 8 bytes) in a 3D lookup table with tetrahedral interpolation, giving each output channel as ints.
+static inline void interpolateTetrahedral_8(__m128i b0, __m128i b1, __m128i b2, const ColorLUT *lut, __m256i &d0, __m256i &d1,
+	__m256i &d2)
+{
+	const __m256i S0 = _mm256_set1_epi32(lut->size * lut->size);
+	const __m256i S1 = _mm256_set1_epi32(lut->size);
+	const __m256i S2 = _mm256_set1_epi32(1);
+	const __m256i S_ALL = _mm256_set1_epi32(lut->size * lut->size + lut->size + 1);
+	__m256i base, f0, f1, f2;
+	lookupLUTCells(b0, b1, b2, lut, base, f0, f1, f2);
+
+	// Sort the positions to pick the tetrahedron, choosing the same channels as the scalar code when they are equal.
+	__m256i fMax = _mm256_max_epi32(_mm256_max_epi32(f0, f1), f2);
+	__m256i fMin = _mm256_min_epi32(_mm256_min_epi32(f0, f1), f2);
+	__m256i fMid = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(f0, f1), f2), fMax), fMin);
+	__m256i sMax = _mm256_blendv_epi8(S2, S1, _mm256_cmpeq_epi32(f1, fMax));
+	sMax = _mm256_blendv_epi8(sMax, S0, _mm256_cmpeq_epi32(f0, fMax));
+	__m256i sMin = _mm256_blendv_epi8(S2, S1, _mm256_cmpeq_epi32(f1, fMin));
+	sMin = _mm256_blendv_epi8(sMin, S0, _mm256_cmpeq_epi32(f0, fMin));
+
+	__m256i v0 = gatherLUT(lut, base);
+	__m256i v1 = gatherLUT(lut, _mm256_add_epi32(base, sMax));
+	__m256i v2 = gatherLUT(lut, _mm256_sub_epi32(_mm256_add_epi32(base, S_ALL), sMin));
+	__m256i v3 = gatherLUT(lut, _mm256_add_epi32(base, S_ALL));
+	__m256i w0 = pairWeights(_mm256_sub_epi32(_mm256_set1_epi32(256), fMax));
+	__m256i w1 = pairWeights(_mm256_sub_epi32(fMax, fMid));
+	__m256i w2 = pairWeights(_mm256_sub_epi32(fMid, fMin));
+	__m256i w3 = pairWeights(fMin);
+
+	// The weights add up to 256, so the weighted sums always fit in 16 bits.
+	const __m256i ROUND = _mm256_set1_epi16(128);
+	__m256i e = _mm256_add_epi16(_mm256_mullo_epi16(evenChannels(v0), w0), _mm256_mullo_epi16(evenChannels(v1), w1));
+	e = _mm256_add_epi16(e, _mm256_add_epi16(_mm256_mullo_epi16(evenChannels(v2), w2), _mm256_mullo_epi16(evenChannels(v3), w3)));
+	e = _mm256_srli_epi16(_mm256_add_epi16(e, ROUND), 8);
+	__m256i o = _mm256_add_epi16(_mm256_mullo_epi16(oddChannels(v0), w0), _mm256_mullo_epi16(oddChannels(v1), w1));
+	o = _mm256_add_epi16(o, _mm256_add_epi16(_mm256_mullo_epi16(oddChannels(v2), w2), _mm256_mullo_epi16(oddChannels(v3), w3)));
+	o = _mm256_srli_epi16(_mm256_add_epi16(o, ROUND), 8);
+
+	d0 = _mm256_and_si256(e, _mm256_set1_epi32(0xFFFF));
+	d1 = o;
+	d2 = _mm256_srli_epi32(e, 16);
+}
+
+void convertRowColorLUTTrilinear_AVX2(const uchar *src, uchar *dst, int width, const ColorLUT *lut)
+{
+	int x = 0;
+	for (; x <= width - 16; x += 16) {
+		__m128i c0, c1, c2;
+		loadDeinterleave3(src + x*3, c0, c1, c2);
+
+		__m256i a0, a1, a2, b0, b1, b2;
+		interpolateTrilinear_8(c0, c1, c2, lut, a0, a1, a2);
+		interpolateTrilinear_8(_mm_srli_si128(c0, 8), _mm_srli_si128(c1, 8), _mm_srli_si128(c2, 8), lut, b0, b1, b2);
+
+		storeInterleave3(dst + x*3, packInts(a0, b0), packInts(a1, b1), packInts(a2, b2));
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowColorLUTTrilinear_C(src + x*3, dst + x*3, width - x, lut);
+}
+
+void convertRowColorLUTTetrahedral_AVX2(const uchar *src, uchar *dst, int width, const ColorLUT *lut)
+{
+	int x = 0;
+	for (; x <= width - 16; x += 16) {
+		__m128i c0, c1, c2;
+		loadDeinterleave3(src + x*3, c0, c1, c2);
+
+		__m256i a0, a1, a2, b0, b1, b2;
+		interpolateTetrahedral_8(c0, c1, c2, lut, a0, a1, a2);
+		interpolateTetrahedral_8(_mm_srli_si128(c0, 8), _mm_srli_si128(c1, 8), _mm_srli_si128(c2, 8), lut, b0, b1, b2);
+
+		storeInterleave3(dst + x*3, packInts(a0, b0), packInts(a1, b1), packInts(a2, b2));
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowColorLUTTetrahedral_C(src + x*3, dst + x*3, width - x, lut);
+}
+
+
+// Convert 8 float pixels from B,G,R to H,S,V, with exactly the same math as convertRowRGBtoHSVFloat_C().
+static inline void convertRGBtoHSVFloat_8(__m256 fB, __m256 fG, __m256 fR, __m256 &fH, __m256 &fS, __m256 &fV)
+{
+	const __m256 ONE = _mm256_set1_ps(1.0f);
+	const __m256 SIX = _mm256_set1_ps(6.0f);
+	const __m256 ZERO = _mm256_setzero_ps();
+
+	__m256 fMax = _mm256_max_ps(_mm256_max_ps(fR, fG), fB);
+	__m256 fMin = _mm256_min_ps(_mm256_min_ps(fR, fG), fB);
+	__m256 fDelta = _mm256_sub_ps(fMax, fMin);
+	__m256 isColor = _mm256_cmp_ps(fMax, ZERO, _CMP_GT_OQ);
+
+	// Black pixels give NaN and grey pixels give infinite hues here, so those are masked out to 0 like the scalar code.
+	fS = _mm256_and_ps(_mm256_div_ps(fDelta, fMax), isColor);
+	__m256 ANGLE_TO_UNIT = _mm256_div_ps(ONE, _mm256_mul_ps(SIX, fDelta));
+
+	// Compute the hue for all 3 cases, then pick by which component was the max (red first, then green).
+	__m256 fHr = _mm256_mul_ps(_mm256_sub_ps(fG, fB), ANGLE_TO_UNIT);
+	__m256 fHg = _mm256_add_ps(_mm256_set1_ps(2.0f/6.0f), _mm256_mul_ps(_mm256_sub_ps(fB, fR), ANGLE_TO_UNIT));
+	__m256 fHb = _mm256_add_ps(_mm256_set1_ps(4.0f/6.0f), _mm256_mul_ps(_mm256_sub_ps(fR, fG), ANGLE_TO_UNIT));
+	__m256 h = _mm256_blendv_ps(fHb, fHg, _mm256_cmp_ps(fMax, fG, _CMP_EQ_OQ));
+	h = _mm256_blendv_ps(h, fHr, _mm256_cmp_ps(fMax, fR, _CMP_EQ_OQ));
+
+	// Wrap outlier Hues around the circle.
+	h = _mm256_add_ps(h, _mm256_and_ps(_mm256_cmp_ps(h, ZERO, _CMP_LT_OQ), ONE));
+	h = _mm256_sub_ps(h, _mm256_and_ps(_mm256_cmp_ps(h, ONE, _CMP_GE_OQ), ONE));
+	fH = _mm256_and_ps(h, _mm256_and_ps(_mm256_cmp_ps(fDelta, ZERO, _CMP_GT_OQ), isColor));
+	fV = fMax;
+}
+
+void convertRowRGBtoHSVFloat_AVX2(const float *src, float *dst, int width)
+{
+	int x = 0;
+	for (; x <= width - 8; x += 8) {
+		__m256 b, g, r, h, s, v;
+		loadDeinterleave3f(src + x*3, b, g, r);
+		convertRGBtoHSVFloat_8(b, g, r, h, s, v);
+		storeInterleave3f(dst + x*3, h, s, v);
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowRGBtoHSVFloat_C(src + x*3, dst + x*3, width - x);
+}
+
+// Convert 8 float pixels from H,S,V to B,G,R, with exactly the same math as convertRowHSVtoRGBFloat_C().
+static inline void convertHSVtoRGBFloat_8(__m256 fH, __m256 fS, __m256 fV, __m256 &fB, __m256 &fG, __m256 &fR)
+{
+	const __m256 ONE = _mm256_set1_ps(1.0f);
+
+	// Split the Hue into its sector of the color wheel and the fraction within that sector.
+	// A sector of 6 (when rounding pushes the Hue up to 1.0) matches none of the sectors below, so like sector 0 it
+	// keeps the first value of each blend.
+	__m256 h6 = _mm256_mul_ps(_mm256_sub_ps(fH, _mm256_floor_ps(fH)), _mm256_set1_ps(6.0f));
+	__m256 fI = _mm256_floor_ps(h6);
+	__m256 fF = _mm256_sub_ps(h6, fI);
+	__m256 p = _mm256_mul_ps(fV, _mm256_sub_ps(ONE, fS));
+	__m256 q = _mm256_mul_ps(fV, _mm256_sub_ps(ONE, _mm256_mul_ps(fS, fF)));
+	__m256 t = _mm256_mul_ps(fV, _mm256_sub_ps(ONE, _mm256_mul_ps(fS, _mm256_sub_ps(ONE, fF))));
+
+	__m256 is1 = _mm256_cmp_ps(fI, ONE, _CMP_EQ_OQ);
+	__m256 is2 = _mm256_cmp_ps(fI, _mm256_set1_ps(2.0f), _CMP_EQ_OQ);
+	__m256 is3 = _mm256_cmp_ps(fI, _mm256_set1_ps(3.0f), _CMP_EQ_OQ);
+	__m256 is4 = _mm256_cmp_ps(fI, _mm256_set1_ps(4.0f), _CMP_EQ_OQ);
+	__m256 is5 = _mm256_cmp_ps(fI, _mm256_set1_ps(5.0f), _CMP_EQ_OQ);
+	fR = _mm256_blendv_ps(_mm256_blendv_ps(_mm256_blendv_ps(fV, q, is1), p, _mm256_or_ps(is2, is3)), t, is4);
+	fG = _mm256_blendv_ps(_mm256_blendv_ps(_mm256_blendv_ps(t, fV, _mm256_or_ps(is1, is2)), q, is3), p, _mm256_or_ps(is4, is5));
+	fB = _mm256_blendv_ps(_mm256_blendv_ps(_mm256_blendv_ps(p, t, is2), fV, _mm256_or_ps(is3, is4)), q, is5);
+}
+
+void convertRowHSVtoRGBFloat_AVX2(const float *src, float *dst, int width)
+{
+	int x = 0;
+	for (; x <= width - 8; x += 8) {
+		__m256 h, s, v, b, g, r;
+		loadDeinterleave3f(src + x*3, h, s, v);
+		convertHSVtoRGBFloat_8(h, s, v, b, g, r);
+		storeInterleave3f(dst + x*3, b, g, r);
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowHSVtoRGBFloat_C(src + x*3, dst + x*3, width - x);
+}
+
+// Multiply 8 float pixels by one row of a 3x3 float matrix, adding the terms in the same order as the scalar code.
+static inline __m256 multiplyFloatMatrixRow(__m256 c0, __m256 c1, __m256 c2, const float *m)
+{
+	__m256 v = _mm256_add_ps(_mm256_mul_ps(c0, _mm256_set1_ps(m[0])), _mm256_mul_ps(c1, _mm256_set1_ps(m[1])));
+	return _mm256_add_ps(v, _mm256_mul_ps(c2, _mm256_set1_ps(m[2])));
+}
+
+// Multiply each float pixel of the row by a 3x3 float matrix, using convertTail for the last few pixels.
+static inline void convertRowFloatMatrix(const float *src, float *dst, int width, const float m[3][3], FloatRowFunc convertTail)
+{
+	int x = 0;
+	for (; x <= width - 8; x += 8) {
+		__m256 c0, c1, c2;
+		loadDeinterleave3f(src + x*3, c0, c1, c2);
+		storeInterleave3f(dst + x*3, multiplyFloatMatrixRow(c0, c1, c2, m[0]), multiplyFloatMatrixRow(c0, c1, c2, m[1]),
+			multiplyFloatMatrixRow(c0, c1, c2, m[2]));
+	}
+	if (x < width)
+		convertTail(src + x*3, dst + x*3, width - x);
+}
+
+void convertRowRGBtoYIQFloat_AVX2(const float *src, float *dst, int width)
+{
+	convertRowFloatMatrix(src, dst, width, RGB_TO_YIQ_FLOAT, convertRowRGBtoYIQFloat_C);
+}
+
+void convertRowYIQtoRGBFloat_AVX2(const float *src, float *dst, int width)
+{
+	convertRowFloatMatrix(src, dst, width, YIQ_TO_RGB_FLOAT, convertRowYIQtoRGBFloat_C);
+}
+
+// Find the min & max of the floats, in 2 pairs of vectors to hide the latency of vminps & vmaxps.
+// vminps & vmaxps give their 2nd operand when either is NaN, so NaNs are skipped just like the scalar code.
+void findMinMaxFloat_AVX2(const float *src, int n, float *minValue, float *maxValue)
+{
+	__m256 min0 = _mm256_set1_ps(*minValue);
+	__m256 max0 = _mm256_set1_ps(*maxValue);
+	__m256 min1 = min0;
+	__m256 max1 = max0;
+	int i = 0;
+	for (; i <= n - 16; i += 16) {
+		__m256 v0 = _mm256_loadu_ps(src + i);
+		__m256 v1 = _mm256_loadu_ps(src + i + 8);
+		min0 = _mm256_min_ps(v0, min0);
+		max0 = _mm256_max_ps(v0, max0);
+		min1 = _mm256_min_ps(v1, min1);
+		max1 = _mm256_max_ps(v1, max1);
+	}
+	min0 = _mm256_min_ps(min0, min1);
+	max0 = _mm256_max_ps(max0, max1);
+	__m128 vMin = _mm_min_ps(_mm256_castps256_ps128(min0), _mm256_extractf128_ps(min0, 1));
+	__m128 vMax = _mm_max_ps(_mm256_castps256_ps128(max0), _mm256_extractf128_ps(max0, 1));
+	vMin = _mm_min_ps(vMin, _mm_movehl_ps(vMin, vMin));
+	vMax = _mm_max_ps(vMax, _mm_movehl_ps(vMax, vMax));
+	*minValue = _mm_cvtss_f32(_mm_min_ss(vMin, _mm_shuffle_ps(vMin, vMin, 1)));
+	*maxValue = _mm_cvtss_f32(_mm_max_ss(vMax, _mm_shuffle_ps(vMax, vMax, 1)));
+	// Do the last few floats with the scalar code.
+	if (i < n)
+		findMinMaxFloat_C(src + i, n - i, minValue, maxValue);
+}
@@ -0,0 +1,20 @@
+/**		ImageUtils_avx512.cpp:		AVX-512 versions of the ImageUtils row kernels. Must be compiled with
+ * -mavx512f -mavx512bw -mavx512vl -mavx512dq (or /arch:AVX512 on MSVC), and like the AVX2 file, without FMA.
+ * These are the AVX2 kernels built a second time with the AVX-512 instruction set, so the compiler can use its
+ * 32 vector registers, mask registers & extra instructions (mostly helping the register-hungry LUT kernels),
+ * while giving exactly the same results as every other version.
+ **/
+
+#define convertRowRGBtoHSV_AVX2				convertRowRGBtoHSV_AVX512
+#define convertRowHSVtoRGB_AVX2				convertRowHSVtoRGB_AVX512
+#define convertRowColorMatrix_AVX2			convertRowColorMatrix_AVX512
+#define convertRowColorMatrixFloat_AVX2		convertRowColorMatrixFloat_AVX512
+#define convertRowColorLUTTrilinear_AVX2	convertRowColorLUTTrilinear_AVX512
+#define convertRowColorLUTTetrahedral_AVX2	convertRowColorLUTTetrahedral_AVX512
+#define convertRowRGBtoHSVFloat_AVX2		convertRowRGBtoHSVFloat_AVX512
+#define convertRowHSVtoRGBFloat_AVX2		convertRowHSVtoRGBFloat_AVX512
+#define convertRowRGBtoYIQFloat_AVX2		convertRowRGBtoYIQFloat_AVX512
+#define convertRowYIQtoRGBFloat_AVX2		convertRowYIQtoRGBFloat_AVX512
+#define findMinMaxFloat_AVX2				findMinMaxFloat_AVX512
+
+#include "ImageUtils_avx2.cpp"
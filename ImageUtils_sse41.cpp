@@ -0,0 +1,378 @@
+/**		ImageUtils_sse41.cpp:		SSE4.1 versions of the ImageUtils row kernels. Must be compiled with -msse4.1 (MSVC needs no flag).
+ **/
+
+#include "ImageUtilsSimd.h"
+
+
+// Convert 4 pixels from 8-bit B,G,R (as ints) to H,S,V (as ints), with exactly the same float math as convertImageRGBtoHSV().
+static inline void convertRGBtoHSV_4(__m128i iB, __m128i iG, __m128i iR, __m128i &iH, __m128i &iS, __m128i &iV)
+{
+	const __m128 BYTE_TO_FLOAT = _mm_set1_ps(1.0f / 255.0f);
+	const __m128 FLOAT_TO_BYTE = _mm_set1_ps(255.0f);
+	const __m128 HALF = _mm_set1_ps(0.5f);
+	const __m128 ONE = _mm_set1_ps(1.0f);
+	const __m128 SIX = _mm_set1_ps(6.0f);
+	const __m128 ZERO = _mm_setzero_ps();
+
+	// Branchless min & max, using integer comparisons.
+	__m128i iMax = _mm_max_epi32(_mm_max_epi32(iB, iG), iR);
+	__m128i iMin = _mm_min_epi32(_mm_min_epi32(iB, iG), iR);
+
+	// Convert from 8-bit integers to floats
+	__m128 fB = _mm_mul_ps(_mm_cvtepi32_ps(iB), BYTE_TO_FLOAT);
+	__m128 fG = _mm_mul_ps(_mm_cvtepi32_ps(iG), BYTE_TO_FLOAT);
+	__m128 fR = _mm_mul_ps(_mm_cvtepi32_ps(iR), BYTE_TO_FLOAT);
+	__m128 fMax = _mm_mul_ps(_mm_cvtepi32_ps(iMax), BYTE_TO_FLOAT);
+	__m128 fMin = _mm_mul_ps(_mm_cvtepi32_ps(iMin), BYTE_TO_FLOAT);
+
+	// Pure black and grey pixels give NaN here, which the saturating packs turn into 0, just like the scalar code.
+	__m128 fDelta = _mm_sub_ps(fMax, fMin);
+	__m128 fS = _mm_div_ps(fDelta, fMax);
+	__m128 ANGLE_TO_UNIT = _mm_div_ps(ONE, _mm_mul_ps(SIX, fDelta));
+
+	// Compute the hue for all 3 cases, then pick by which component was the max (red first, then green).
+	__m128 fHr = _mm_mul_ps(_mm_sub_ps(fG, fB), ANGLE_TO_UNIT);
+	__m128 fHg = _mm_add_ps(_mm_set1_ps(2.0f/6.0f), _mm_mul_ps(_mm_sub_ps(fB, fR), ANGLE_TO_UNIT));
+	__m128 fHb = _mm_add_ps(_mm_set1_ps(4.0f/6.0f), _mm_mul_ps(_mm_sub_ps(fR, fG), ANGLE_TO_UNIT));
+	__m128 fH = _mm_blendv_ps(fHb, fHg, _mm_castsi128_ps(_mm_cmpeq_epi32(iMax, iG)));
+	fH = _mm_blendv_ps(fH, fHr, _mm_castsi128_ps(_mm_cmpeq_epi32(iMax, iR)));
+
+	// Wrap outlier Hues around the circle.
+	fH = _mm_add_ps(fH, _mm_and_ps(_mm_cmplt_ps(fH, ZERO), ONE));
+	fH = _mm_sub_ps(fH, _mm_and_ps(_mm_cmpge_ps(fH, ONE), ONE));
+
+	// Convert from floats to 8-bit integers (clipped later by the packs).
+	iH = _mm_cvttps_epi32(_mm_add_ps(HALF, _mm_mul_ps(fH, FLOAT_TO_BYTE)));
+	iS = _mm_cvttps_epi32(_mm_add_ps(HALF, _mm_mul_ps(fS, FLOAT_TO_BYTE)));
+	iV = _mm_cvttps_epi32(_mm_add_ps(HALF, _mm_mul_ps(fMax, FLOAT_TO_BYTE)));
+}
+
+// Pack 4 groups of 4 ints into 16 bytes, saturating to 0..255.
+static inline __m128i packInts(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+	return _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d));
+}
+
+void convertRowRGBtoHSV_SSE41(const uchar *src, uchar *dst, int width)
+{
+	int x = 0;
+	for (; x <= width - 16; x += 16) {
+		__m128i b, g, r;
+		loadDeinterleave3(src + x*3, b, g, r);
+
+		__m128i h[4], s[4], v[4];
+		for (int k=0; k<4; k++) {
+			convertRGBtoHSV_4(_mm_cvtepu8_epi32(b), _mm_cvtepu8_epi32(g), _mm_cvtepu8_epi32(r), h[k], s[k], v[k]);
+			b = _mm_srli_si128(b, 4);
+			g = _mm_srli_si128(g, 4);
+			r = _mm_srli_si128(r, 4);
+		}
+
+		storeInterleave3(dst + x*3, packInts(h[0], h[1], h[2], h[3]), packInts(s[0], s[1], s[2], s[3]),
+			packInts(v[0], v[1], v[2], v[3]));
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowRGBtoHSV_C(src + x*3, dst + x*3, width - x);
+}
+
+
+// Divide unsigned 16-bit ints by 255, rounding down. Exact for n < 65535.
+static inline __m128i divideBy255(__m128i n)
+{
+	return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(n, _mm_set1_epi16(1)), _mm_srli_epi16(n, 8)), 8);
+}
+
+// Get v * x / (255*255) rounded down, for v <= 255 and x <= 255*255, without leaving 16 bits.
+// Splits x into 255 * xa + xb, so that the first division by 255 can be done in 2 parts.
+static inline __m128i multiplyFraction(__m128i v, __m128i x)
+{
+	__m128i xa = divideBy255(x);
+	__m128i xb = _mm_sub_epi16(x, _mm_mullo_epi16(xa, _mm_set1_epi16(255)));
+	__m128i d = _mm_add_epi16(_mm_mullo_epi16(v, xa), divideBy255(_mm_mullo_epi16(v, xb)));
+	return divideBy255(d);
+}
+
+// Convert 8 pixels from 8-bit H,S,V (as 16-bit ints) to B,G,R (as 16-bit ints), with exactly the same integer
+// math as convertRowHSVtoRGB_C().
+static inline void convertHSVtoRGB_8(__m128i iH, __m128i iS, __m128i iV, __m128i &iB, __m128i &iG, __m128i &iR)
+{
+	const __m128i C255 = _mm_set1_epi16(255);
+	const __m128i C65025 = _mm_set1_epi16((short)(255*255));
+
+	// Same as the Hue tables: wrap 255 to 0, then split into the sector & the fraction within the sector.
+	iH = _mm_andnot_si128(_mm_cmpeq_epi16(iH, C255), iH);
+	__m128i h6 = _mm_mullo_epi16(iH, _mm_set1_epi16(6));
+	__m128i sector = divideBy255(h6);
+	__m128i fraction = _mm_sub_epi16(h6, _mm_mullo_epi16(sector, C255));
+
+	__m128i p = divideBy255(_mm_mullo_epi16(iV, _mm_sub_epi16(C255, iS)));
+	__m128i q = multiplyFraction(iV, _mm_sub_epi16(C65025, _mm_mullo_epi16(iS, fraction)));
+	__m128i t = multiplyFraction(iV, _mm_sub_epi16(C65025, _mm_mullo_epi16(iS, _mm_sub_epi16(C255, fraction))));
+
+	// Pick the components for each sector, like the switch in the scalar code.
+	__m128i s1 = _mm_cmpeq_epi16(sector, _mm_set1_epi16(1));
+	__m128i s2 = _mm_cmpeq_epi16(sector, _mm_set1_epi16(2));
+	__m128i s3 = _mm_cmpeq_epi16(sector, _mm_set1_epi16(3));
+	__m128i s4 = _mm_cmpeq_epi16(sector, _mm_set1_epi16(4));
+	__m128i s5 = _mm_cmpeq_epi16(sector, _mm_set1_epi16(5));
+	iR = _mm_blendv_epi8(iV, q, s1);
+	iR = _mm_blendv_epi8(iR, p, _mm_or_si128(s2, s3));
+	iR = _mm_blendv_epi8(iR, t, s4);
+	iG = _mm_blendv_epi8(t, iV, _mm_or_si128(s1, s2));
+	iG = _mm_blendv_epi8(iG, q, s3);
+	iG = _mm_blendv_epi8(iG, p, _mm_or_si128(s4, s5));
+	iB = _mm_blendv_epi8(p, t, s2);
+	iB = _mm_blendv_epi8(iB, iV, _mm_or_si128(s3, s4));
+	iB = _mm_blendv_epi8(iB, q, s5);
+}
+
+void convertRowHSVtoRGB_SSE41(const uchar *src, uchar *dst, int width)
+{
+	const __m128i ZERO = _mm_setzero_si128();
+	int x = 0;
+	for (; x <= width - 16; x += 16) {
+		__m128i h, s, v;
+		loadDeinterleave3(src + x*3, h, s, v);
+
+		__m128i b0, g0, r0, b1, g1, r1;
+		convertHSVtoRGB_8(_mm_unpacklo_epi8(h, ZERO), _mm_unpacklo_epi8(s, ZERO), _mm_unpacklo_epi8(v, ZERO), b0, g0, r0);
+		convertHSVtoRGB_8(_mm_unpackhi_epi8(h, ZERO), _mm_unpackhi_epi8(s, ZERO), _mm_unpackhi_epi8(v, ZERO), b1, g1, r1);
+
+		storeInterleave3(dst + x*3, _mm_packus_epi16(b0, b1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(r0, r1));
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowHSVtoRGB_C(src + x*3, dst + x*3, width - x);
+}
+
+
+// Multiply 8 pixels by one row of the fixed-point color matrix, giving 8 shorts (to be saturated to bytes later).
+// c01lo & c01hi hold channels 0 & 1 as pairs of shorts, and c2lo & c2hi hold channel 2 paired with 0.
+static inline __m128i multiplyMatrixRow(__m128i c01lo, __m128i c01hi, __m128i c2lo, __m128i c2hi, const short *m, int offset,
+	__m128i shift)
+{
+	const __m128i m01 = _mm_set1_epi32((ushort)m[0] | (m[1] << 16));
+	const __m128i m2 = _mm_set1_epi32((ushort)m[2]);
+	const __m128i off = _mm_set1_epi32(offset);
+	__m128i lo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(c01lo, m01), _mm_madd_epi16(c2lo, m2)), off);
+	__m128i hi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(c01hi, m01), _mm_madd_epi16(c2hi, m2)), off);
+	return _mm_packs_epi32(_mm_sra_epi32(lo, shift), _mm_sra_epi32(hi, shift));
+}
+
+// Multiply 8 pixels (as 16-bit channels) by the fixed-point color matrix.
+static inline void multiplyMatrix_8(__m128i c0, __m128i c1, __m128i c2, const ColorMatrixCoeffs *coeffs, __m128i shift,
+	__m128i &d0, __m128i &d1, __m128i &d2)
+{
+	const __m128i ZERO = _mm_setzero_si128();
+	__m128i c01lo = _mm_unpacklo_epi16(c0, c1);
+	__m128i c01hi = _mm_unpackhi_epi16(c0, c1);
+	__m128i c2lo = _mm_unpacklo_epi16(c2, ZERO);
+	__m128i c2hi = _mm_unpackhi_epi16(c2, ZERO);
+	d0 = multiplyMatrixRow(c01lo, c01hi, c2lo, c2hi, coeffs->fixedM[0], coeffs->fixedOffset[0], shift);
+	d1 = multiplyMatrixRow(c01lo, c01hi, c2lo, c2hi, coeffs->fixedM[1], coeffs->fixedOffset[1], shift);
+	d2 = multiplyMatrixRow(c01lo, c01hi, c2lo, c2hi, coeffs->fixedM[2], coeffs->fixedOffset[2], shift);
+}
+
+void convertRowColorMatrix_SSE41(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs)
+{
+	const __m128i ZERO = _mm_setzero_si128();
+	const __m128i shift = _mm_cvtsi32_si128(coeffs->shift);
+	int x = 0;
+	for (; x <= width - 16; x += 16) {
+		__m128i c0, c1, c2;
+		loadDeinterleave3(src + x*3, c0, c1, c2);
+
+		__m128i a0, a1, a2, b0, b1, b2;
+		multiplyMatrix_8(_mm_unpacklo_epi8(c0, ZERO), _mm_unpacklo_epi8(c1, ZERO), _mm_unpacklo_epi8(c2, ZERO), coeffs, shift,
+			a0, a1, a2);
+		multiplyMatrix_8(_mm_unpackhi_epi8(c0, ZERO), _mm_unpackhi_epi8(c1, ZERO), _mm_unpackhi_epi8(c2, ZERO), coeffs, shift,
+			b0, b1, b2);
+
+		storeInterleave3(dst + x*3, _mm_packus_epi16(a0, b0), _mm_packus_epi16(a1, b1), _mm_packus_epi16(a2, b2));
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowColorMatrix_C(src + x*3, dst + x*3, width - x, coeffs);
+}
+
+// Multiply 4 pixels (as floats) by one row of the float color matrix, giving 4 ints between 0 and 255.
+// Adds the terms in the same order as the scalar code, so that it rounds the same way.
+static inline __m128i multiplyMatrixRowFloat(__m128 f0, __m128 f1, __m128 f2, const float *m, float offset)
+{
+	__m128 v = _mm_add_ps(_mm_mul_ps(f0, _mm_set1_ps(m[0])), _mm_mul_ps(f1, _mm_set1_ps(m[1])));
+	v = _mm_add_ps(_mm_add_ps(v, _mm_mul_ps(f2, _mm_set1_ps(m[2]))), _mm_set1_ps(offset));
+	v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+	return _mm_cvttps_epi32(v);
+}
+
+void convertRowColorMatrixFloat_SSE41(const uchar *src, uchar *dst, int width, const ColorMatrixCoeffs *coeffs)
+{
+	int x = 0;
+	for (; x <= width - 16; x += 16) {
+		__m128i c0, c1, c2;
+		loadDeinterleave3(src + x*3, c0, c1, c2);
+
+		__m128i d0[4], d1[4], d2[4];
+		for (int k=0; k<4; k++) {
+			__m128 f0 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(c0));
+			__m128 f1 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(c1));
+			__m128 f2 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(c2));
+			d0[k] = multiplyMatrixRowFloat(f0, f1, f2, coeffs->floatM[0], coeffs->floatOffset[0]);
+			d1[k] = multiplyMatrixRowFloat(f0, f1, f2, coeffs->floatM[1], coeffs->floatOffset[1]);
+			d2[k] = multiplyMatrixRowFloat(f0, f1, f2, coeffs->floatM[2], coeffs->floatOffset[2]);
+			c0 = _mm_srli_si128(c0, 4);
+			c1 = _mm_srli_si128(c1, 4);
+			c2 = _mm_srli_si128(c2, 4);
+		}
+
+		storeInterleave3(dst + x*3, packInts(d0[0], d0[1], d0[2], d0[3]), packInts(d1[0], d1[1], d1[2], d1[3]),
+			packInts(d2[0], d2[1], d2[2], d2[3]));
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowColorMatrixFloat_C(src + x*3, dst + x*3, width - x, coeffs);
+}
+
+
+// Convert 4 float pixels from B,G,R to H,S,V, with exactly the same math as convertRowRGBtoHSVFloat_C().
+static inline void convertRGBtoHSVFloat_4(__m128 fB, __m128 fG, __m128 fR, __m128 &fH, __m128 &fS, __m128 &fV)
+{
+	const __m128 ONE = _mm_set1_ps(1.0f);
+	const __m128 SIX = _mm_set1_ps(6.0f);
+	const __m128 ZERO = _mm_setzero_ps();
+
+	__m128 fMax = _mm_max_ps(_mm_max_ps(fR, fG), fB);
+	__m128 fMin = _mm_min_ps(_mm_min_ps(fR, fG), fB);
+	__m128 fDelta = _mm_sub_ps(fMax, fMin);
+	__m128 isColor = _mm_cmpgt_ps(fMax, ZERO);
+
+	// Black pixels give NaN and grey pixels give infinite hues here, so those are masked out to 0 like the scalar code.
+	fS = _mm_and_ps(_mm_div_ps(fDelta, fMax), isColor);
+	__m128 ANGLE_TO_UNIT = _mm_div_ps(ONE, _mm_mul_ps(SIX, fDelta));
+
+	// Compute the hue for all 3 cases, then pick by which component was the max (red first, then green).
+	__m128 fHr = _mm_mul_ps(_mm_sub_ps(fG, fB), ANGLE_TO_UNIT);
+	__m128 fHg = _mm_add_ps(_mm_set1_ps(2.0f/6.0f), _mm_mul_ps(_mm_sub_ps(fB, fR), ANGLE_TO_UNIT));
+	__m128 fHb = _mm_add_ps(_mm_set1_ps(4.0f/6.0f), _mm_mul_ps(_mm_sub_ps(fR, fG), ANGLE_TO_UNIT));
+	__m128 h = _mm_blendv_ps(fHb, fHg, _mm_cmpeq_ps(fMax, fG));
+	h = _mm_blendv_ps(h, fHr, _mm_cmpeq_ps(fMax, fR));
+
+	// Wrap outlier Hues around the circle.
+	h = _mm_add_ps(h, _mm_and_ps(_mm_cmplt_ps(h, ZERO), ONE));
+	h = _mm_sub_ps(h, _mm_and_ps(_mm_cmpge_ps(h, ONE), ONE));
+	fH = _mm_and_ps(h, _mm_and_ps(_mm_cmpgt_ps(fDelta, ZERO), isColor));
+	fV = fMax;
+}
+
+void convertRowRGBtoHSVFloat_SSE41(const float *src, float *dst, int width)
+{
+	int x = 0;
+	for (; x <= width - 4; x += 4) {
+		__m128 b, g, r, h, s, v;
+		loadDeinterleave3f(src + x*3, b, g, r);
+		convertRGBtoHSVFloat_4(b, g, r, h, s, v);
+		storeInterleave3f(dst + x*3, h, s, v);
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowRGBtoHSVFloat_C(src + x*3, dst + x*3, width - x);
+}
+
+// Convert 4 float pixels from H,S,V to B,G,R, with exactly the same math as convertRowHSVtoRGBFloat_C().
+static inline void convertHSVtoRGBFloat_4(__m128 fH, __m128 fS, __m128 fV, __m128 &fB, __m128 &fG, __m128 &fR)
+{
+	const __m128 ONE = _mm_set1_ps(1.0f);
+
+	// Split the Hue into its sector of the color wheel and the fraction within that sector.
+	// A sector of 6 (when rounding pushes the Hue up to 1.0) matches none of the sectors below, so like sector 0 it
+	// keeps the first value of each blend.
+	__m128 h6 = _mm_mul_ps(_mm_sub_ps(fH, _mm_floor_ps(fH)), _mm_set1_ps(6.0f));
+	__m128 fI = _mm_floor_ps(h6);
+	__m128 fF = _mm_sub_ps(h6, fI);
+	__m128 p = _mm_mul_ps(fV, _mm_sub_ps(ONE, fS));
+	__m128 q = _mm_mul_ps(fV, _mm_sub_ps(ONE, _mm_mul_ps(fS, fF)));
+	__m128 t = _mm_mul_ps(fV, _mm_sub_ps(ONE, _mm_mul_ps(fS, _mm_sub_ps(ONE, fF))));
+
+	__m128 is1 = _mm_cmpeq_ps(fI, ONE);
+	__m128 is2 = _mm_cmpeq_ps(fI, _mm_set1_ps(2.0f));
+	__m128 is3 = _mm_cmpeq_ps(fI, _mm_set1_ps(3.0f));
+	__m128 is4 = _mm_cmpeq_ps(fI, _mm_set1_ps(4.0f));
+	__m128 is5 = _mm_cmpeq_ps(fI, _mm_set1_ps(5.0f));
+	fR = _mm_blendv_ps(_mm_blendv_ps(_mm_blendv_ps(fV, q, is1), p, _mm_or_ps(is2, is3)), t, is4);
+	fG = _mm_blendv_ps(_mm_blendv_ps(_mm_blendv_ps(t, fV, _mm_or_ps(is1, is2)), q, is3), p, _mm_or_ps(is4, is5));
+	fB = _mm_blendv_ps(_mm_blendv_ps(_mm_blendv_ps(p, t, is2), fV, _mm_or_ps(is3, is4)), q, is5);
+}
+
+void convertRowHSVtoRGBFloat_SSE41(const float *src, float *dst, int width)
+{
+	int x = 0;
+	for (; x <= width - 4; x += 4) {
+		__m128 h, s, v, b, g, r;
+		loadDeinterleave3f(src + x*3, h, s, v);
+		convertHSVtoRGBFloat_4(h, s, v, b, g, r);
+		storeInterleave3f(dst + x*3, b, g, r);
+	}
+	// Do the last few pixels with the scalar code.
+	if (x < width)
+		convertRowHSVtoRGBFloat_C(src + x*3, dst + x*3, width - x);
+}
+
+// Multiply 4 float pixels by one row of a 3x3 float matrix, adding the terms in the same order as the scalar code.
+static inline __m128 multiplyFloatMatrixRow(__m128 c0, __m128 c1, __m128 c2, const float *m)
+{
+	__m128 v = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(m[0])), _mm_mul_ps(c1, _mm_set1_ps(m[1])));
+	return _mm_add_ps(v, _mm_mul_ps(c2, _mm_set1_ps(m[2])));
+}
+
+// Multiply each float pixel of the row by a 3x3 float matrix, using convertTail for the last few pixels.
+static inline void convertRowFloatMatrix(const float *src, float *dst, int width, const float m[3][3], FloatRowFunc convertTail)
+{
+	int x = 0;
+	for (; x <= width - 4; x += 4) {
+		__m128 c0, c1, c2;
+		loadDeinterleave3f(src + x*3, c0, c1, c2);
+		storeInterleave3f(dst + x*3, multiplyFloatMatrixRow(c0, c1, c2, m[0]), multiplyFloatMatrixRow(c0, c1, c2, m[1]),
+			multiplyFloatMatrixRow(c0, c1, c2, m[2]));
+	}
+	if (x < width)
+		convertTail(src + x*3, dst + x*3, width - x);
+}
+
+void convertRowRGBtoYIQFloat_SSE41(const float *src, float *dst, int width)
+{
+	convertRowFloatMatrix(src, dst, width, RGB_TO_YIQ_FLOAT, convertRowRGBtoYIQFloat_C);
+}
+
+void convertRowYIQtoRGBFloat_SSE41(const float *src, float *dst, int width)
+{
+	convertRowFloatMatrix(src, dst, width, YIQ_TO_RGB_FLOAT, convertRowYIQtoRGBFloat_C);
+}
+
+// Find the min & max of the floats, in 2 pairs of vectors to hide the latency of minps & maxps.
+// minps & maxps give their 2nd operand when either is NaN, so NaNs are skipped just like the scalar code.
+void findMinMaxFloat_SSE41(const float *src, int n, float *minValue, float *maxValue)
+{
+	__m128 min0 = _mm_set1_ps(*minValue);
+	__m128 max0 = _mm_set1_ps(*maxValue);
+	__m128 min1 = min0;
+	__m128 max1 = max0;
+	int i = 0;
+	for (; i <= n - 8; i += 8) {
+		__m128 v0 = _mm_loadu_ps(src + i);
+		__m128 v1 = _mm_loadu_ps(src + i + 4);
+		min0 = _mm_min_ps(v0, min0);
+		max0 = _mm_max_ps(v0, max0);
+		min1 = _mm_min_ps(v1, min1);
+		max1 = _mm_max_ps(v1, max1);
+	}
+	__m128 vMin = _mm_min_ps(min0, min1);
+	__m128 vMax = _mm_max_ps(max0, max1);
+	vMin = _mm_min_ps(vMin, _mm_movehl_ps(vMin, vMin));
+	vMax = _mm_max_ps(vMax, _mm_movehl_ps(vMax, vMax));
+	*minValue = _mm_cvtss_f32(_mm_min_ss(vMin, _mm_shuffle_ps(vMin, vMin, 1)));
+	*maxValue = _mm_cvtss_f32(_mm_max_ss(vMax, _mm_shuffle_ps(vMax, vMax, 1)));
+	// Do the last few floats with the scalar code.
+	if (i < n)
+		findMinMaxFloat_C(src + i, n - i, minValue, maxValue);
+}
@@ -0,0 +1,147 @@
+/**		ParallelReader.cpp:		Decode separate parts of a video file on several threads at once, for offline processing.
+ **/
+
+#include <algorithm>
+#include <iostream>
+
+#include "ParallelReader.h"
+
+
+using namespace std;
+
+
+ParallelReader::ParallelReader()
+	: inOrder(true), currentChunk(0), nextFrame(0), nextWorker(0)
+{
+}
+
+ParallelReader::~ParallelReader()
+{
+	close();
+}
+
+bool ParallelReader::open(const char *videoFilename, int nThreads, bool ordered, int chunkFrames, int queueDepth)
+{
+	close();
+	if (!videoIndex.loadOrBuild(videoFilename))
+		return false;
+	filename = videoFilename;
+	inOrder = ordered;
+
+	if (nThreads <= 0)
+		nThreads = max((int)thread::hardware_concurrency(), 1);
+	if (chunkFrames <= 0)
+		chunkFrames = videoIndex.syncInterval();
+	if (queueDepth <= 0)
+		queueDepth = chunkFrames;
+
+	// Cut the video at the first sync point after every chunkFrames frames.
+	int64 n = videoIndex.frameCount();
+	chunks.clear();
+	Chunk chunk;
+	chunk.first = 0;
+	for (int64 i=1; i<n; i++) {
+		if (i - chunk.first >= chunkFrames && videoIndex.isSyncPoint(i)) {
+			chunk.end = i;
+			chunks.push_back(chunk);
+			chunk.first = i;
+		}
+	}
+	chunk.end = n;
+	chunks.push_back(chunk);
+	nThreads = min(nThreads, (int)chunks.size());
+
+	currentChunk = 0;
+	nextFrame = 0;
+	nextWorker = 0;
+	finished.assign(nThreads, false);
+	for (int w=0; w<nThreads; w++)
+		queues.push_back(unique_ptr<FrameRingBuffer>(new FrameRingBuffer(queueDepth, FRAME_QUEUE_BLOCK)));
+	for (int w=0; w<nThreads; w++)
+		workers.push_back(thread(&ParallelReader::decodeChunks, this, w));
+	return true;
+}
+
+// Body of each worker thread: decode every chunk that belongs to this worker into its queue.
+void ParallelReader::decodeChunks(int worker)
+{
+	FrameRingBuffer &queue = *queues[worker];
+	IndexedCapture cap;
+	if (!cap.open(filename.c_str(), videoIndex)) {
+		cerr << "ERROR in ParallelReader: Worker " << worker << " couldn't open '" << filename << "'." << endl;
+		queue.close();
+		return;
+	}
+
+	int nWorkers = (int)queues.size();
+	for (size_t c=worker; c<chunks.size(); c+=nWorkers) {
+		if (!cap.seek(chunks[c].first))
+			break;
+		for (int64 f=chunks[c].first; f<chunks[c].end; f++) {
+			cv::Mat *slot = queue.beginWrite();
+			if (!slot) {
+				return;		// The reader was closed.
+			}
+			if (!cap.read(*slot)) {
+				queue.close();
+				return;
+			}
+			queue.endWrite(f, videoIndex.framePts(f));
+		}
+	}
+	queue.close();
+}
+
+bool ParallelReader::read(cv::Mat &frame, int64 *frameIndex)
+{
+	int nWorkers = (int)queues.size();
+	if (nWorkers == 0)
+		return false;
+
+	if (inOrder) {
+		// Take the frames of each chunk from the worker that decoded it.
+		while (currentChunk < chunks.size() && nextFrame >= chunks[currentChunk].end)
+			currentChunk++;
+		if (currentChunk >= chunks.size())
+			return false;
+		int64 index;
+		if (!queues[currentChunk % nWorkers]->pop(frame, &index))
+			return false;	// The worker failed to decode its chunk.
+		nextFrame = index + 1;
+		if (frameIndex)
+			*frameIndex = index;
+		return true;
+	}
+
+	// Take a frame from any worker that has one ready, otherwise wait on the next unfinished worker.
+	for (int i=0; i<nWorkers; i++) {
+		int w = (nextWorker + i) % nWorkers;
+		if (!finished[w] && queues[w]->tryPop(frame, frameIndex)) {
+			nextWorker = (w + 1) % nWorkers;
+			return true;
+		}
+	}
+	for (int i=0; i<nWorkers; i++) {
+		int w = (nextWorker + i) % nWorkers;
+		if (finished[w])
+			continue;
+		if (queues[w]->pop(frame, frameIndex)) {
+			nextWorker = (w + 1) % nWorkers;
+			return true;
+		}
+		finished[w] = true;
+	}
+	return false;
+}
+
+void ParallelReader::close(void)
+{
+	for (size_t w=0; w<queues.size(); w++)
+		queues[w]->close();
+	for (size_t w=0; w<workers.size(); w++)
+		workers[w].join();
+	workers.clear();
+	queues.clear();
+	chunks.clear();
+	finished.clear();
+}
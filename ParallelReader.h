@@ -0,0 +1,66 @@
+/**		ParallelReader.h:		Decode separate parts of a video file on several threads at once, for offline processing.
+ **/
+
+#ifndef PARALLEL_READER_H
+#define PARALLEL_READER_H
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "FrameQueue.h"
+#include "VideoIndex.h"
+
+
+// Splits a video into chunks that start on sync points of its VideoIndex, and decodes them with one
+// VideoCapture per worker thread. Worker w decodes chunks w, w+N, w+2N, ... into its own FrameRingBuffer.
+// In ordered mode, read() returns the frames in their original order by visiting the workers' queues chunk by chunk.
+// Otherwise read() returns whichever frame is ready first, along with its frame number.
+// Each queue holds a whole chunk by default, so memory use is about (nThreads * chunkFrames) frames.
+class ParallelReader
+{
+public:
+	ParallelReader();
+	~ParallelReader();
+
+	// Start decoding the video on nThreads workers (0 = one per CPU core).
+	// Chunks are at least chunkFrames long (0 = the index's sync interval), and each worker can run ahead by
+	// queueDepth frames (0 = chunkFrames).
+	bool open(const char *videoFilename, int nThreads = 0, bool ordered = true, int chunkFrames = 0, int queueDepth = 0);
+
+	// Get the next frame, and its frame number. Returns false at the end of the video.
+	bool read(cv::Mat &frame, int64 *frameIndex = 0);
+
+	// Stop the workers and close the video.
+	void close(void);
+
+	int64 frameCount(void) const { return videoIndex.frameCount(); }
+	int threadCount(void) const { return (int)queues.size(); }
+
+private:
+	struct Chunk {
+		int64 first;	// First frame of the chunk.
+		int64 end;		// One past the last frame.
+	};
+
+	void decodeChunks(int worker);
+
+	std::string filename;
+	VideoIndex videoIndex;
+	std::vector<Chunk> chunks;
+	std::vector<std::unique_ptr<FrameRingBuffer> > queues;
+	std::vector<std::thread> workers;
+	bool inOrder;
+
+	// Read position for ordered mode.
+	size_t currentChunk;
+	int64 nextFrame;
+	// Read position for unordered mode.
+	int nextWorker;
+	std::vector<bool> finished;
+};
+
+#endif	// PARALLEL_READER_H
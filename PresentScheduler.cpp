@@ -0,0 +1,99 @@
+/**		PresentScheduler.cpp:		Decide when to show each video frame from its timestamp, instead of using fixed delays.
+ **/
+
+#include <iostream>
+#include <math.h>
+
+#include "PresentScheduler.h"
+
+
+using namespace std;
+
+
+// If the timestamps jump forward by more than this, or the video falls this far behind the clock,
+// then start the clock again instead of waiting or dropping frames for a long time.
+static const double RESYNC_MS = 1000.0;
+
+
+PresentScheduler::PresentScheduler(double maxLate_ms)
+	: maxLateAllowed(maxLate_ms), started(false), ptsStart(0.0), ptsLast(0.0),
+	  nPresented(0), nDropped(0), sumLate(0.0), sumLateSquared(0.0), maxLate(0.0)
+{
+}
+
+double PresentScheduler::elapsed_ms(void) const
+{
+	if (!started)
+		return 0.0;
+	return chrono::duration<double, milli>(Clock::now() - clockStart).count();
+}
+
+PresentAction PresentScheduler::schedule(double pts_ms, double *wait_ms)
+{
+	// Restart the clock at the first frame, or if the timestamps go backwards or skip ahead (eg: after a seek).
+	if (!started || pts_ms < ptsLast || pts_ms - ptsLast > RESYNC_MS) {
+		started = true;
+		clockStart = Clock::now();
+		ptsStart = pts_ms;
+	}
+	ptsLast = pts_ms;
+
+	double late = elapsed_ms() - (pts_ms - ptsStart);	// Positive if the frame is already overdue.
+	if (late > RESYNC_MS) {
+		// We are hopelessly behind (eg: the decoder is slower than real-time), so show this frame and continue from it.
+		clockStart = Clock::now();
+		ptsStart = pts_ms;
+		late = 0.0;
+	}
+	else if (late > maxLateAllowed) {
+		nDropped++;
+		if (wait_ms)
+			*wait_ms = 0.0;
+		return DROP_FRAME;
+	}
+
+	if (wait_ms)
+		*wait_ms = (late < 0.0) ? -late : 0.0;
+	return PRESENT_FRAME;
+}
+
+void PresentScheduler::presented(void)
+{
+	if (!started)
+		return;
+	double late = elapsed_ms() - (ptsLast - ptsStart);
+	if (late < 0.0)
+		late = 0.0;		// Shown early, which counts as on time.
+	nPresented++;
+	sumLate += late;
+	sumLateSquared += late * late;
+	if (late > maxLate)
+		maxLate = late;
+}
+
+void PresentScheduler::restart(void)
+{
+	started = false;
+}
+
+double PresentScheduler::meanLateness_ms(void) const
+{
+	return nPresented ? sumLate / nPresented : 0.0;
+}
+
+double PresentScheduler::jitter_ms(void) const
+{
+	if (!nPresented)
+		return 0.0;
+	double mean = sumLate / nPresented;
+	double variance = sumLateSquared / nPresented - mean * mean;
+	return (variance > 0.0) ? sqrt(variance) : 0.0;
+}
+
+void PresentScheduler::printStats(const char *label) const
+{
+	if (label)
+		cout << label << ": ";
+	cout << "Presented " << nPresented << " frames, dropped " << nDropped << ". Lateness: mean=" << meanLateness_ms()
+		<< " ms, max=" << maxLate << " ms, jitter=" << jitter_ms() << " ms." << endl;
+}
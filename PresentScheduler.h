@@ -0,0 +1,68 @@
+/**		PresentScheduler.h:		Decide when to show each video frame from its timestamp, instead of using fixed delays.
+ **/
+
+#ifndef PRESENT_SCHEDULER_H
+#define PRESENT_SCHEDULER_H
+
+#include <chrono>
+
+
+// What to do with the next frame.
+enum PresentAction {
+	PRESENT_FRAME,		// Show the frame after waiting the given time (which is 0 if the frame is already due).
+	DROP_FRAME			// The frame is too late to be worth showing, so skip it to catch up.
+};
+
+// Maps the presentation timestamps of frames (eg: CAP_PROP_POS_MSEC) onto a monotonic clock.
+// The clock starts at the first frame, so the video plays at its real speed no matter how long
+// decoding or processing takes, and frames that are more than 'maxLate_ms' behind are dropped.
+// Sample usage:
+//	PresentScheduler scheduler;
+//	while (cap.read(frame)) {
+//		double wait_ms;
+//		if (scheduler.schedule(cap.get(CAP_PROP_POS_MSEC), &wait_ms) == DROP_FRAME)
+//			continue;
+//		waitKey(cvRound(wait_ms));	// or do other work until the frame is due.
+//		imshow("Frame", frame);
+//		scheduler.presented();
+//	}
+class PresentScheduler
+{
+public:
+	PresentScheduler(double maxLate_ms = 50.0);
+
+	// Decide whether to show the frame with timestamp pts_ms, and how long to wait until it is due.
+	PresentAction schedule(double pts_ms, double *wait_ms);
+	// Record that the frame passed to the last schedule() call has just been shown, to measure its lateness.
+	void presented(void);
+	// Start the clock again at the next frame, eg: after seeking or pausing.
+	void restart(void);
+
+	double elapsed_ms(void) const;	// Time since the first frame, on the monotonic clock.
+
+	long framesPresented(void) const { return nPresented; }
+	long framesDropped(void) const { return nDropped; }
+	double meanLateness_ms(void) const;		// Average time that frames were shown after they were due.
+	double maxLateness_ms(void) const { return maxLate; }
+	double jitter_ms(void) const;			// Standard deviation of the lateness of shown frames.
+
+	// Print the presentation stats to std::cout.
+	void printStats(const char *label = 0) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	double maxLateAllowed;
+	bool started;
+	Clock::time_point clockStart;	// Clock time of the first frame.
+	double ptsStart;				// Timestamp of the first frame.
+	double ptsLast;					// Timestamp given to the last schedule() call.
+
+	long nPresented;
+	long nDropped;
+	double sumLate;
+	double sumLateSquared;
+	double maxLate;
+};
+
+#endif	// PRESENT_SCHEDULER_H
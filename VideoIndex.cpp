@@ -0,0 +1,259 @@
+/**		VideoIndex.cpp:		Frame index sidecar files, for fast frame-accurate seeking in long video files.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "VideoIndex.h"
+
+
+using namespace std;
+
+
+static const char VIDEO_INDEX_MAGIC[4] = {'V','I','D','X'};
+static const int VIDEO_INDEX_VERSION = 1;
+
+
+// Get the size of a file in bytes, or -1 if it can't be opened.
+static int64 getFileSize(const char *filename)
+{
+	ifstream file(filename, ios::binary | ios::ate);
+	if (!file)
+		return -1;
+	return (int64)file.tellg();
+}
+
+
+VideoIndex::VideoIndex()
+	: videoFileSize(-1), videoFps(0.0), syncEvery(1)
+{
+}
+
+string VideoIndex::sidecarFilename(const char *videoFilename)
+{
+	return string(videoFilename) + ".vidx";
+}
+
+bool VideoIndex::build(const char *videoFilename, int syncInterval)
+{
+	cv::VideoCapture cap(videoFilename);
+	if (!cap.isOpened()) {
+		cerr << "ERROR in VideoIndex::build(): Couldn't open video '" << videoFilename << "'." << endl;
+		return false;
+	}
+
+	videoFileSize = getFileSize(videoFilename);
+	videoFps = cap.get(cv::CAP_PROP_FPS);
+	if (syncInterval <= 0)
+		syncInterval = (videoFps > 0.0 && videoFps < 200.0) ? cvRound(videoFps) : 25;	// About 1 second.
+	syncEvery = syncInterval;
+
+	pts.clear();
+	flags.clear();
+	int64 expected = (int64)cap.get(cv::CAP_PROP_FRAME_COUNT);
+	if (expected > 0) {
+		pts.reserve((size_t)expected);
+		flags.reserve((size_t)expected);
+	}
+
+	// Only grab() the frames, since the pixels aren't needed.
+	while (cap.grab()) {
+		int64 frame = (int64)pts.size();
+		pts.push_back(cap.get(cv::CAP_PROP_POS_MSEC));
+		flags.push_back((frame % syncEvery == 0) ? VIDEO_INDEX_SYNC : 0);
+	}
+	return !pts.empty();
+}
+
+bool VideoIndex::save(const char *indexFilename) const
+{
+	FILE *f = fopen(indexFilename, "wb");
+	if (!f) {
+		cerr << "ERROR in VideoIndex::save(): Couldn't create '" << indexFilename << "'." << endl;
+		return false;
+	}
+	int version = VIDEO_INDEX_VERSION;
+	int64 n = frameCount();
+	bool ok = fwrite(VIDEO_INDEX_MAGIC, 1, 4, f) == 4
+		&& fwrite(&version, sizeof(version), 1, f) == 1
+		&& fwrite(&videoFileSize, sizeof(videoFileSize), 1, f) == 1
+		&& fwrite(&videoFps, sizeof(videoFps), 1, f) == 1
+		&& fwrite(&syncEvery, sizeof(syncEvery), 1, f) == 1
+		&& fwrite(&n, sizeof(n), 1, f) == 1;
+	if (ok && n > 0) {
+		ok = fwrite(&pts[0], sizeof(double), (size_t)n, f) == (size_t)n
+			&& fwrite(&flags[0], sizeof(uchar), (size_t)n, f) == (size_t)n;
+	}
+	fclose(f);
+	return ok;
+}
+
+bool VideoIndex::load(const char *indexFilename, const char *videoFilename)
+{
+	FILE *f = fopen(indexFilename, "rb");
+	if (!f)
+		return false;
+
+	char magic[4];
+	int version = 0;
+	int64 n = 0;
+	bool ok = fread(magic, 1, 4, f) == 4 && memcmp(magic, VIDEO_INDEX_MAGIC, 4) == 0
+		&& fread(&version, sizeof(version), 1, f) == 1 && version == VIDEO_INDEX_VERSION
+		&& fread(&videoFileSize, sizeof(videoFileSize), 1, f) == 1
+		&& fread(&videoFps, sizeof(videoFps), 1, f) == 1
+		&& fread(&syncEvery, sizeof(syncEvery), 1, f) == 1
+		&& fread(&n, sizeof(n), 1, f) == 1
+		&& n > 0 && syncEvery > 0;
+	if (ok) {
+		pts.resize((size_t)n);
+		flags.resize((size_t)n);
+		ok = fread(&pts[0], sizeof(double), (size_t)n, f) == (size_t)n
+			&& fread(&flags[0], sizeof(uchar), (size_t)n, f) == (size_t)n;
+	}
+	fclose(f);
+
+	// Make sure the index still belongs to this video.
+	if (ok && videoFilename && getFileSize(videoFilename) != videoFileSize)
+		ok = false;
+	if (!ok) {
+		pts.clear();
+		flags.clear();
+	}
+	return ok;
+}
+
+bool VideoIndex::loadOrBuild(const char *videoFilename)
+{
+	string sidecar = sidecarFilename(videoFilename);
+	if (load(sidecar.c_str(), videoFilename))
+		return true;
+
+	// First time this video is used, so do the indexing pass now.
+	cout << "Indexing '" << videoFilename << "' ..." << endl;
+	if (!build(videoFilename))
+		return false;
+	if (!save(sidecar.c_str()))
+		cerr << "Warning: Couldn't store the video index, so it will be rebuilt next time." << endl;
+	return true;
+}
+
+int64 VideoIndex::syncPointBefore(int64 frame) const
+{
+	frame = min(max(frame, (int64)0), frameCount() - 1);
+	while (frame > 0 && !isSyncPoint(frame))
+		frame--;
+	return frame;
+}
+
+int64 VideoIndex::frameAtPts(double pts_ms) const
+{
+	// Timestamps are increasing, so do a binary search for the last frame at or before pts_ms.
+	// Allow a little rounding error in the timestamps reported by the backend.
+	vector<double>::const_iterator it = upper_bound(pts.begin(), pts.end(), pts_ms + 0.5);
+	if (it == pts.begin())
+		return 0;
+	return (int64)(it - pts.begin()) - 1;
+}
+
+
+IndexedCapture::IndexedCapture()
+	: grabbed(-1), pendingRetrieve(false)
+{
+}
+
+bool IndexedCapture::open(const char *videoFilename)
+{
+	release();
+	if (!videoIndex.loadOrBuild(videoFilename))
+		return false;
+	return cap.open(videoFilename);
+}
+
+bool IndexedCapture::open(const char *videoFilename, const VideoIndex &index)
+{
+	release();
+	videoIndex = index;
+	return cap.open(videoFilename);
+}
+
+void IndexedCapture::release(void)
+{
+	cap.release();
+	grabbed = -1;
+	pendingRetrieve = false;
+}
+
+// Decode forward (without color conversion) until the given frame has been grabbed.
+bool IndexedCapture::grabUntil(int64 frame)
+{
+	while (grabbed < frame) {
+		if (!cap.grab())
+			return false;
+		grabbed++;
+	}
+	return true;
+}
+
+bool IndexedCapture::seek(int64 frame)
+{
+	if (!cap.isOpened() || frame < 0 || frame >= videoIndex.frameCount())
+		return false;
+	if (frame == position())
+		return true;	// Already there.
+
+	// If the frame is a little ahead, decoding through is cheaper than seeking.
+	if (frame > grabbed && frame - grabbed <= videoIndex.syncInterval()) {
+		pendingRetrieve = false;
+		if (!grabUntil(frame))
+			return false;
+		pendingRetrieve = true;
+		return true;
+	}
+
+	// Seek to a sync point, then check exactly where the backend landed using the timestamps.
+	// If it landed past the desired frame, try the sync point before that.
+	int64 sync = videoIndex.syncPointBefore(frame);
+	grabbed = -1;
+	for (int tries=0; tries<4; tries++) {
+		cap.set(cv::CAP_PROP_POS_MSEC, videoIndex.framePts(sync));
+		if (!cap.grab())
+			break;
+		int64 landed = videoIndex.frameAtPts(cap.get(cv::CAP_PROP_POS_MSEC));
+		if (landed <= frame) {
+			grabbed = landed;
+			break;
+		}
+		if (sync == 0)
+			break;
+		sync = videoIndex.syncPointBefore(sync - 1);
+	}
+	if (grabbed < 0) {
+		// The backend couldn't seek accurately, so go back to the start of the video.
+		cap.set(cv::CAP_PROP_POS_FRAMES, 0);
+	}
+
+	pendingRetrieve = false;
+	if (!grabUntil(frame))
+		return false;
+	pendingRetrieve = true;
+	return true;
+}
+
+bool IndexedCapture::read(cv::Mat &frame)
+{
+	if (!pendingRetrieve) {
+		if (!cap.grab())
+			return false;
+		grabbed++;
+	}
+	pendingRetrieve = false;
+	return cap.retrieve(frame) && !frame.empty();
+}
+
+bool IndexedCapture::readFrame(int64 frameNumber, cv::Mat &frame)
+{
+	return seek(frameNumber) && read(frame);
+}
@@ -0,0 +1,96 @@
+/**		VideoIndex.h:		Frame index sidecar files, for fast frame-accurate seeking in long video files.
+ **/
+
+#ifndef VIDEO_INDEX_H
+#define VIDEO_INDEX_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+
+// Flags stored for each frame of the index.
+enum {
+	VIDEO_INDEX_SYNC = 1	// A seek target: seeking to this frame's timestamp then decoding forward reaches any later frame.
+};
+
+// Timestamp of every frame in a video, plus regularly spaced sync points, stored in a small binary sidecar file.
+// OpenCV's VideoCapture doesn't report packet byte offsets or keyframe flags, so the sync points are placed every
+// 'syncInterval' frames instead of on the real keyframes, and seeks are done by timestamp.
+class VideoIndex
+{
+public:
+	VideoIndex();
+
+	// Decode the whole video once (grab only, no color conversion) and record the timestamp of every frame.
+	// If syncInterval is 0, a sync point is placed about once per second of video.
+	bool build(const char *videoFilename, int syncInterval = 0);
+
+	// Store or load the index as a binary sidecar file. load() fails if the video file has changed size since.
+	bool save(const char *indexFilename) const;
+	bool load(const char *indexFilename, const char *videoFilename);
+
+	// Load the video's sidecar index, or build it and store the sidecar if it doesn't exist yet.
+	bool loadOrBuild(const char *videoFilename);
+
+	// Get the default sidecar filename for a video, ie: "<video>.vidx".
+	static std::string sidecarFilename(const char *videoFilename);
+
+	int64 frameCount(void) const { return (int64)pts.size(); }
+	double fps(void) const { return videoFps; }
+	int syncInterval(void) const { return syncEvery; }
+	// Timestamp of the given frame in milliseconds.
+	double framePts(int64 frame) const { return pts[(size_t)frame]; }
+	bool isSyncPoint(int64 frame) const { return (flags[(size_t)frame] & VIDEO_INDEX_SYNC) != 0; }
+	// Last sync point at or before the given frame.
+	int64 syncPointBefore(int64 frame) const;
+	// Frame whose timestamp is closest to (at or before) the given time.
+	int64 frameAtPts(double pts_ms) const;
+
+private:
+	std::vector<double> pts;	// Timestamp of each frame, in milliseconds.
+	std::vector<uchar> flags;	// VIDEO_INDEX_* flags of each frame.
+	int64 videoFileSize;		// Used to detect a stale sidecar.
+	double videoFps;
+	int syncEvery;
+};
+
+// A VideoCapture that uses a VideoIndex to seek directly to any frame number.
+// Short jumps forward are decoded through, and longer jumps seek to the nearest sync point and decode forward,
+// so the frame that is read is always exactly the requested one.
+class IndexedCapture
+{
+public:
+	IndexedCapture();
+
+	// Open the video, loading its sidecar index or creating one if it doesn't exist yet.
+	bool open(const char *videoFilename);
+	// Open the video using an index that was already loaded or built.
+	bool open(const char *videoFilename, const VideoIndex &index);
+	bool isOpened(void) const { return cap.isOpened(); }
+	void release(void);
+
+	// Move to the given frame number, so that the next read() returns exactly that frame.
+	bool seek(int64 frame);
+	// Read the next frame.
+	bool read(cv::Mat &frame);
+	// Seek to the given frame and read it, eg: for thumbnails.
+	bool readFrame(int64 frameNumber, cv::Mat &frame);
+
+	// Frame number that the next read() will return.
+	int64 position(void) const { return pendingRetrieve ? grabbed : grabbed + 1; }
+	const VideoIndex& index(void) const { return videoIndex; }
+	cv::VideoCapture& capture(void) { return cap; }
+
+private:
+	bool grabUntil(int64 frame);
+
+	cv::VideoCapture cap;
+	VideoIndex videoIndex;
+	int64 grabbed;			// Frame number of the last grabbed frame, or -1 at the start of the video.
+	bool pendingRetrieve;	// The grabbed frame hasn't been read yet (after a seek).
+};
+
+#endif	// VIDEO_INDEX_H
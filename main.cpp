@@ -1,40 +1,177 @@
 #include "opencv2/opencv.hpp"
 #include <iostream>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CaptureBench.h"
+#include "FramePool.h"
+#include "FrameQueue.h"
+#include "ParallelReader.h"
+#include "PresentScheduler.h"
 
 using namespace std;
 using namespace cv;
 
-int main(){
+// Print how many frame buffers had to be allocated, which should stay constant once the video is running.
+static void printPoolStats(const FramePool &pool, int64 frames)
+{
+    cout << "Allocated " << pool.allocations() << " frame buffers for " << frames << " frames ("
+         << (frames > 0 ? (double)pool.allocations() / frames : 0.0) << " allocations per frame)." << endl;
+}
 
-    // Create a VideoCapture object and open the input file
-    // If the input is the web camera, pass 0 instead of the video file name
-    VideoCapture cap("chaplin.mp4");
+static Size getFrameSize(VideoCapture &cap)
+{
+    return Size((int)cap.get(CAP_PROP_FRAME_WIDTH), (int)cap.get(CAP_PROP_FRAME_HEIGHT));
+}
 
-    // Check if camera opened successfully
-    if(!cap.isOpened()){
-        cout << "Error opening video stream or file" << endl;
-        return -1;
-    }
+// Show the frame when its timestamp is due, or skip it if it is already too late.
+// Returns false if the user pressed ESC.
+static bool presentFrame(PresentScheduler &scheduler, const Mat &frame, double pts_ms)
+{
+    double wait_ms;
+    if (scheduler.schedule(pts_ms, &wait_ms) == DROP_FRAME)
+        return true;
+
+    // Wait until the frame is due, while still handling key presses
+    char c = 0;
+    if (wait_ms >= 1.0)
+        c=(char)waitKey(cvFloor(wait_ms));
+    if(c==27)
+        return false;
+
+    // Display the resulting frame
+    imshow( "Frame", frame );
+    scheduler.presented();
+
+    // Press  ESC on keyboard to exit
+    c=(char)waitKey(1);
+    return c!=27;
+}
+
+// Show the frames as they are decoded, on this same thread.
+static void playSerial(VideoCapture &cap)
+{
+    // Reuse the same pooled buffer for every frame, instead of a new Mat per iteration
+    FramePool pool(2, getFrameSize(cap));
+    Mat frame;
+    pool.attach(frame);
+    int64 frames = 0;
+    PresentScheduler scheduler;
 
     while(1){
 
-        Mat frame;
         // Capture frame-by-frame
         cap >> frame;
 
         // If the frame is empty, break immediately
         if (frame.empty())
             break;
+        frames++;
+
+        if (!presentFrame(scheduler, frame, cap.get(CAP_PROP_POS_MSEC)))
+            break;
+    }
 
-        // Display the resulting frame
-        imshow( "Frame", frame );
+    scheduler.printStats();
+    printPoolStats(pool, frames);
+}
 
-        // Press  ESC on keyboard to exit
-        char c=(char)waitKey(25);
-        if(c==27)
+// Decode on a separate thread into a ring of 'depth' frames, and only display frames here.
+static void playThreaded(VideoCapture &cap, int depth, FrameQueuePolicy policy)
+{
+    // The ring holds 'depth' frames, plus the one being displayed
+    Size frameSize = getFrameSize(cap);
+    FramePool pool(depth + 1, frameSize);
+    FrameRingBuffer queue(depth, policy, frameSize, CV_8UC3, &pool);
+    thread decoder = startDecodeThread(cap, queue);
+
+    Mat frame;
+    pool.attach(frame);
+    double pts_ms;
+    PresentScheduler scheduler;
+    while(queue.pop(frame, 0, &pts_ms)){
+        if (!presentFrame(scheduler, frame, pts_ms))
             break;
     }
 
+    // Stop the decoder, in case we quit before the end of the video
+    queue.close();
+    decoder.join();
+
+    cout << "Decoded " << queue.framesPushed() << " frames, dropped " << queue.framesDropped() << "." << endl;
+    scheduler.printStats();
+    printPoolStats(pool, queue.framesPushed());
+}
+
+int main(int argc, char **argv){
+
+    const char *filename = "chaplin.mp4";
+    bool threaded = false;
+    bool headless = false;
+    int parallelThreads = -1;
+    int depth = 8;
+    FrameQueuePolicy policy = FRAME_QUEUE_BLOCK;
+
+    cout << "usage:  OpenCV_Example [<input_video>] [--headless [--parallel <threads>]] [--threaded] [--depth <frames>] [--drop-oldest]" << endl;
+
+    // Check the flags on the command line.
+    for (int i=1; i<argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--parallel") == 0 && i+1 < argc)
+            parallelThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threaded") == 0)
+            threaded = true;
+        else if (strcmp(argv[i], "--depth") == 0 && i+1 < argc)
+            depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--drop-oldest") == 0)
+            policy = FRAME_QUEUE_DROP_OLDEST;
+        else
+            filename = argv[i];
+    }
+
+    // Parallel decoding splits the file into chunks that finish out of order, so it can only be benchmarked, not played.
+    if (parallelThreads >= 0 && !headless) {
+        cout << "Error: --parallel only works together with --headless." << endl;
+        return -1;
+    }
+
+    if (headless && parallelThreads >= 0) {
+        // Decode chunks of the file on several threads at once (0 threads = one per core)
+        ParallelReader reader;
+        if (!reader.open(filename, parallelThreads)) {
+            cout << "Error opening video file" << endl;
+            return -1;
+        }
+        cout << "Decoding with " << reader.threadCount() << " threads." << endl;
+        CaptureBenchResult result = runCaptureBenchmark(reader);
+        printCaptureBenchResult(result, filename);
+        return 0;
+    }
+
+    // Create a VideoCapture object and open the input file
+    // If the input is the web camera, pass 0 instead of the video file name
+    VideoCapture cap(filename);
+
+    // Check if camera opened successfully
+    if(!cap.isOpened()){
+        cout << "Error opening video stream or file" << endl;
+        return -1;
+    }
+
+    if (headless) {
+        // Decode as fast as possible without opening any windows, to measure the decoder alone
+        CaptureBenchResult result = runCaptureBenchmark(cap);
+        printCaptureBenchResult(result, filename);
+        cap.release();
+        return 0;
+    }
+
+    if (threaded)
+        playThreaded(cap, depth, policy);
+    else
+        playSerial(cap);
+
     // When everything done, release the video capture object
     cap.release();
 
@@ -42,4 +179,4 @@ int main(){
     destroyAllWindows();
 
     return 0;
-}
\ No newline at end of file
+}